@@ -0,0 +1,430 @@
+#include "account.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "account_index.h"
+#include "base32.h"
+#include "counter_log.h"
+#include "crc32.h"
+#include "totp.h"
+#include "vault_crypt.h"
+
+// Encode buffer; the vault is only used from one core.
+static uint8_t record_buf[VAULT_MAX_VALUE];
+
+#define NONCE_FIELD_SIZE (2 + CHACHA20_NONCE_SIZE)
+
+// Base32 secrets being decoded by account_store(): the text, decrypted if
+// need be, and the seed it decodes to. Both are wiped after use.
+static char secret_text[256];
+static uint8_t seed_buf[ACCOUNT_SEED_MAX];
+
+//--------------------------------------------------------------------+
+// TLV encoding
+//--------------------------------------------------------------------+
+
+static bool put_field(uint8_t *out, size_t out_max, size_t *pos, uint8_t tag,
+                      const void *value, size_t len) {
+    size_t header = (len < 0x80) ? 2 : 3;
+    if (len > ACCOUNT_FIELD_MAX || *pos + header + len > out_max) return false;
+
+    out[(*pos)++] = tag;
+    if (len < 0x80) {
+        out[(*pos)++] = (uint8_t)len;
+    } else {
+        out[(*pos)++] = (uint8_t)(0x80 | (len >> 8));
+        out[(*pos)++] = (uint8_t)len;
+    }
+    memcpy(out + *pos, value, len);
+    *pos += len;
+    return true;
+}
+
+int account_encode(const account *acc, uint8_t *out, size_t out_max) {
+    size_t pos = 0;
+    if (out_max < 1) return -1;
+    out[pos++] = ACCOUNT_FORMAT_VERSION;
+
+    const struct {
+        uint8_t tag;
+        const char *value;
+        size_t len;
+    } strings[] = {
+        { ACCOUNT_TAG_NAME, acc->name, acc->name_len },
+        { ACCOUNT_TAG_USERNAME, acc->username, acc->username_len },
+        { ACCOUNT_TAG_PASSWORD, acc->password, acc->password_len },
+        { ACCOUNT_TAG_TOTP_SECRET, acc->totp_secret, acc->totp_secret_len },
+        { ACCOUNT_TAG_TOTP_SEED, (const char *)acc->totp_seed, acc->totp_seed_len },
+    };
+    for (size_t i = 0; i < sizeof(strings) / sizeof(strings[0]); i++) {
+        if (strings[i].len == 0) continue;
+        if (!put_field(out, out_max, &pos, strings[i].tag, strings[i].value, strings[i].len)) {
+            return -1;
+        }
+    }
+
+    if (acc->totp_digits != 0) {
+        uint8_t period[2] = { (uint8_t)(acc->totp_period >> 8), (uint8_t)acc->totp_period };
+        if (!put_field(out, out_max, &pos, ACCOUNT_TAG_TOTP_DIGITS, &acc->totp_digits, 1) ||
+            !put_field(out, out_max, &pos, ACCOUNT_TAG_TOTP_PERIOD, period, 2)) {
+            return -1;
+        }
+        if (acc->totp_hash != 0 &&
+            !put_field(out, out_max, &pos, ACCOUNT_TAG_TOTP_HASH, &acc->totp_hash, 1)) {
+            return -1;
+        }
+        if (acc->hotp) {
+            uint8_t counter[8];
+            for (int i = 0; i < 8; i++) {
+                counter[i] = (uint8_t)(acc->hotp_counter >> (56 - 8 * i));
+            }
+            if (!put_field(out, out_max, &pos, ACCOUNT_TAG_HOTP, counter, 8)) return -1;
+        }
+    }
+    return (int)pos;
+}
+
+// Reads the field header at '*pos', leaving '*pos' at its value.
+static bool next_field(const uint8_t *data, size_t len, size_t *pos, uint8_t *tag,
+                       size_t *field_len) {
+    if (len - *pos < 2) return false;
+    *tag = data[(*pos)++];
+    *field_len = data[(*pos)++];
+    if (*field_len & 0x80) {
+        if (*pos >= len) return false;
+        *field_len = ((*field_len & 0x7F) << 8) | data[(*pos)++];
+    }
+    return *field_len <= len - *pos;
+}
+
+static bool is_secret(uint8_t tag) {
+    return tag == ACCOUNT_TAG_USERNAME || tag == ACCOUNT_TAG_PASSWORD ||
+           tag == ACCOUNT_TAG_TOTP_SECRET || tag == ACCOUNT_TAG_TOTP_SEED;
+}
+
+int account_decode(const uint8_t *data, size_t len, account *acc) {
+    memset(acc, 0, sizeof(*acc));
+    if (len < 1 || data[0] != ACCOUNT_FORMAT_VERSION) return -1;
+    acc->record = data;
+    acc->record_len = len;
+
+    size_t pos = 1;
+    while (pos < len) {
+        uint8_t tag;
+        size_t field_len;
+        if (!next_field(data, len, &pos, &tag, &field_len)) return -1;
+
+        const uint8_t *value = data + pos;
+        switch (tag) {
+            case ACCOUNT_TAG_NAME:
+                acc->name = (const char *)value;
+                acc->name_len = field_len;
+                break;
+            case ACCOUNT_TAG_USERNAME:
+                acc->username = (const char *)value;
+                acc->username_len = field_len;
+                break;
+            case ACCOUNT_TAG_PASSWORD:
+                acc->password = (const char *)value;
+                acc->password_len = field_len;
+                break;
+            case ACCOUNT_TAG_TOTP_SECRET:
+                acc->totp_secret = (const char *)value;
+                acc->totp_secret_len = field_len;
+                break;
+            case ACCOUNT_TAG_TOTP_SEED:
+                acc->totp_seed = value;
+                acc->totp_seed_len = field_len;
+                break;
+            case ACCOUNT_TAG_TOTP_DIGITS:
+                if (field_len == 1) acc->totp_digits = value[0];
+                break;
+            case ACCOUNT_TAG_TOTP_PERIOD:
+                if (field_len == 2) acc->totp_period = (uint16_t)((value[0] << 8) | value[1]);
+                break;
+            case ACCOUNT_TAG_TOTP_HASH:
+                if (field_len == 1) acc->totp_hash = value[0];
+                break;
+            case ACCOUNT_TAG_HOTP:
+                if (field_len != 8) break;
+                acc->hotp = true;
+                for (int i = 0; i < 8; i++) {
+                    acc->hotp_counter = (acc->hotp_counter << 8) | value[i];
+                }
+                break;
+            case ACCOUNT_TAG_NONCE:
+                if (field_len != CHACHA20_NONCE_SIZE) return -1;
+                acc->nonce = value;
+                break;
+            default:
+                break;
+        }
+        pos += field_len;
+    }
+    return 0;
+}
+
+//--------------------------------------------------------------------+
+// Encryption
+//--------------------------------------------------------------------+
+
+static bool in_record(const account *acc, const char *field, size_t len) {
+    const uint8_t *p = (const uint8_t *)field;
+    return acc->record != NULL && p >= acc->record && p + len <= acc->record + acc->record_len;
+}
+
+// Appends a fresh nonce to the record just encoded from 'acc' into 'buf' and
+// encrypts its secrets in place. Values that were copied from acc's own
+// encrypted record are decrypted with the old nonce on the way.
+static size_t seal(const account *acc, uint8_t *buf, size_t len) {
+    const uint8_t *nonce = buf + len + 2;
+    buf[len] = ACCOUNT_TAG_NONCE;
+    buf[len + 1] = CHACHA20_NONCE_SIZE;
+    vault_crypt_new_nonce(buf + len + 2);
+    len += NONCE_FIELD_SIZE;
+
+    account out;
+    account_decode(buf, len, &out);
+    const char *src[] = { acc->username, acc->password, acc->totp_secret,
+                          (const char *)acc->totp_seed };
+    const char *dst[] = { out.username, out.password, out.totp_secret,
+                          (const char *)out.totp_seed };
+    size_t n[] = { out.username_len, out.password_len, out.totp_secret_len, out.totp_seed_len };
+
+    for (size_t i = 0; i < sizeof(n) / sizeof(n[0]); i++) {
+        if (n[i] == 0) continue;
+        uint8_t *value = buf + ((const uint8_t *)dst[i] - buf);
+        if (acc->nonce != NULL && in_record(acc, src[i], n[i])) {
+            vault_crypt_xor(acc->nonce, (uint32_t)((const uint8_t *)src[i] - acc->record),
+                            value, value, n[i]);
+        }
+        vault_crypt_xor(nonce, (uint32_t)(value - buf), value, value, n[i]);
+    }
+    return len;
+}
+
+int account_read(const account *acc, const char *field, size_t pos, size_t len, char *out) {
+    const uint8_t *src = (const uint8_t *)field + pos;
+    if (acc->nonce == NULL || field == acc->name) {
+        memcpy(out, src, len);
+        return 0;
+    }
+    if (!vault_crypt_unlocked()) return -1;
+    vault_crypt_xor(acc->nonce, (uint32_t)(src - acc->record), src, (uint8_t *)out, len);
+    return 0;
+}
+
+uint32_t account_plain_crc(const uint8_t *data, size_t len) {
+    account acc;
+    if (account_decode(data, len, &acc) != 0 || acc.nonce == NULL || !vault_crypt_unlocked()) {
+        return crc32_update(0, data, len);
+    }
+
+    uint32_t crc = crc32_update(0, data, 1);
+    size_t pos = 1;
+    uint8_t tag;
+    size_t field_len;
+    while (pos < len && next_field(data, len, &pos, &tag, &field_len)) {
+        if (tag != ACCOUNT_TAG_NONCE) {
+            // The header as it was read, then the value.
+            size_t header = field_len < 0x80 ? 2 : 3;
+            crc = crc32_update(crc, data + pos - header, header);
+            if (!is_secret(tag)) {
+                crc = crc32_update(crc, data + pos, field_len);
+            } else {
+                uint8_t chunk[CHACHA20_BLOCK_SIZE];
+                for (size_t done = 0; done < field_len; done += sizeof(chunk)) {
+                    size_t n = field_len - done < sizeof(chunk) ? field_len - done : sizeof(chunk);
+                    vault_crypt_xor(acc.nonce, (uint32_t)(pos + done), data + pos + done, chunk, n);
+                    crc = crc32_update(crc, chunk, n);
+                }
+                memset(chunk, 0, sizeof(chunk));
+            }
+        }
+        pos += field_len;
+    }
+    return crc;
+}
+
+int account_export(const uint8_t *data, size_t len, uint8_t *out, size_t out_max) {
+    account acc;
+    if (account_decode(data, len, &acc) != 0 || len > out_max) return -1;
+    if (acc.nonce != NULL && !vault_crypt_unlocked()) return -1;
+
+    size_t n = 1;
+    size_t pos = 1;
+    uint8_t tag;
+    size_t field_len;
+    out[0] = data[0];
+    while (pos < len && next_field(data, len, &pos, &tag, &field_len)) {
+        size_t header = field_len < 0x80 ? 2 : 3;
+        if (tag != ACCOUNT_TAG_NONCE) {
+            memcpy(out + n, data + pos - header, header + field_len);
+            if (acc.nonce != NULL && is_secret(tag)) {
+                vault_crypt_xor(acc.nonce, (uint32_t)pos, out + n + header, out + n + header,
+                                field_len);
+            }
+            n += header + field_len;
+        }
+        pos += field_len;
+    }
+    return (int)n;
+}
+
+//--------------------------------------------------------------------+
+// Vault access
+//--------------------------------------------------------------------+
+
+int account_load(uint16_t id, account *acc) {
+    size_t len;
+    if (id >= ACCOUNT_MAX) return -1;
+    const uint8_t *data = vault_get(ACCOUNT_KEY_BASE + id, &len);
+    if (data == NULL) return -1;
+    return account_decode(data, len, acc);
+}
+
+// Copies 'acc' to 'out' with a Base32 totp_secret replaced by its seed in
+// seed_buf. Text that does not decode is refused, unless it comes from the
+// record already stored, which is then carried over as it is.
+// Returns 0, or -1 if the secret was refused.
+static int decode_secret(const account *acc, account *out) {
+    *out = *acc;
+    size_t len = acc->totp_secret_len;
+    if (len == 0) return 0;
+    if (len > sizeof(secret_text)) return -1;
+
+    if (acc->nonce != NULL && in_record(acc, acc->totp_secret, len)) {
+        if (account_read(acc, acc->totp_secret, 0, len, secret_text) != 0) return -1;
+    } else {
+        memcpy(secret_text, acc->totp_secret, len);
+    }
+    int n = base32_decode_len(secret_text, len, seed_buf, sizeof(seed_buf));
+    memset(secret_text, 0, len);
+    if (n <= 0) return in_record(acc, acc->totp_secret, len) ? 0 : -1;
+
+    out->totp_secret = NULL;
+    out->totp_secret_len = 0;
+    out->totp_seed = seed_buf;
+    out->totp_seed_len = (size_t)n;
+    return 0;
+}
+
+int account_store(uint16_t id, const account *acc) {
+    if (id >= ACCOUNT_MAX) return -1;
+    // 0 means no OTP; anything else must be a code length totp.c can produce.
+    if (acc->totp_digits > TOTP_MAX_DIGITS) return -1;
+    bool encrypt = vault_crypt_unlocked();
+    if (!encrypt && acc->nonce != NULL) return -1;
+
+    account plain;
+    if (decode_secret(acc, &plain) != 0) return -1;
+
+    // Encode before writing: the fields may point at the record being replaced.
+    int len = account_encode(&plain, record_buf, sizeof(record_buf) - (encrypt ? NONCE_FIELD_SIZE : 0));
+    memset(seed_buf, 0, sizeof(seed_buf));
+    if (len < 0) return -1;
+    if (encrypt) {
+        len = (int)seal(&plain, record_buf, (size_t)len);
+    }
+
+    account cur;
+    if (account_load(id, &cur) == 0) {
+        account_index_remove(id, cur.name, cur.name_len);
+    }
+    int ret = vault_put(ACCOUNT_KEY_BASE + id, record_buf, (size_t)len);
+    // Index whichever record is current now; garbage collection during the
+    // put may have moved or erased the old one.
+    if (account_load(id, &cur) == 0) {
+        account_index_insert(id, cur.name, cur.name_len);
+    }
+    return ret;
+}
+
+int account_remove(uint16_t id) {
+    if (id >= ACCOUNT_MAX) return -1;
+    account cur;
+    if (account_load(id, &cur) != 0) return 0;
+    account_index_remove(id, cur.name, cur.name_len);
+    int ret = vault_delete(ACCOUNT_KEY_BASE + id);
+    if (ret != 0 && account_load(id, &cur) == 0) {
+        account_index_insert(id, cur.name, cur.name_len);
+    } else if (ret == 0) {
+        counter_log_remove(id);
+    }
+    return ret;
+}
+
+int account_migrate_legacy(void) {
+    int created = 0;
+
+    for (uint16_t user = 1; user < 64; user++) {
+        uint16_t user_key = 2 * (user - 1);
+        uint16_t pass_key = user_key + 1;
+        size_t user_len = 0, pass_len = 0;
+        const uint8_t *username = vault_get(user_key, &user_len);
+        const uint8_t *password = vault_get(pass_key, &pass_len);
+        if (username == NULL && password == NULL) continue;
+
+        // An existing account is newer, or the result of an interrupted run.
+        account acc;
+        if (account_load(user - 1, &acc) != 0) {
+            char name[12];
+            memset(&acc, 0, sizeof(acc));
+            acc.name = name;
+            acc.name_len = (size_t)snprintf(name, sizeof(name), "user%u", user);
+            acc.username = (const char *)username;
+            acc.username_len = username ? user_len : 0;
+            acc.password = (const char *)password;
+            acc.password_len = password ? pass_len : 0;
+            if (account_store(user - 1, &acc) != 0) return created;
+            created++;
+        }
+        vault_delete(user_key);
+        vault_delete(pass_key);
+    }
+    return created;
+}
+
+int account_encrypt_all(void) {
+    if (!vault_crypt_unlocked()) return -1;
+
+    int encrypted = 0;
+    vault_batch_begin();
+    for (uint16_t id = 0; id < ACCOUNT_MAX; id++) {
+        account acc;
+        if (account_load(id, &acc) != 0 || acc.nonce != NULL) continue;
+        if (account_store(id, &acc) != 0) {
+            encrypted = -1;
+            break;
+        }
+        encrypted++;
+    }
+    vault_batch_end();
+
+    // The plaintext records are superseded but still in flash until their
+    // sectors are erased.
+    if (encrypted > 0 && vault_compact() < 0) return -1;
+    return encrypted;
+}
+
+int account_migrate_seeds(void) {
+    int converted = 0;
+    vault_batch_begin();
+    for (uint16_t id = 0; id < ACCOUNT_MAX; id++) {
+        account acc, plain;
+        if (account_load(id, &acc) != 0 || acc.totp_secret_len == 0) continue;
+        if (acc.nonce != NULL && !vault_crypt_unlocked()) continue;
+        // Text that is not Base32 would only be rewritten unchanged.
+        bool decodes = decode_secret(&acc, &plain) == 0 && plain.totp_secret_len == 0;
+        memset(seed_buf, 0, sizeof(seed_buf));
+        if (!decodes) continue;
+        if (account_store(id, &acc) != 0) {
+            converted = -1;
+            break;
+        }
+        converted++;
+    }
+    vault_batch_end();
+    return converted;
+}
@@ -0,0 +1,136 @@
+#ifndef ACCOUNT_H
+#define ACCOUNT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "vault.h"
+
+// Accounts: one vault record per account holding its name, username,
+// password and TOTP parameters as packed TLV fields:
+//
+//   version(1) { tag(1) length(1-2) value(length) }*
+//
+// Lengths below 0x80 take one byte; longer ones take two, big-endian with
+// the top bit set. Unknown tags are skipped so fields can be added later.
+//
+// The TOTP secret is stored decoded, as a TOTP_SEED field: account_store()
+// decodes Base32 text on the way in, so generating a code never parses
+// Base32. TOTP_SECRET text is only found in records written before that.
+//
+// Records written while the vault is unlocked end with a NONCE field, and
+// their username, password and TOTP secret values are encrypted (see
+// vault_crypt.h): each value byte is XORed with the ChaCha20 keystream for
+// that nonce at the byte's offset in the record. The name stays readable for
+// the index. Apart from the NONCE field an encrypted record decrypts to
+// exactly what account_encode() produces.
+
+#define ACCOUNT_FORMAT_VERSION 1
+
+#define ACCOUNT_TAG_NAME        0x01
+#define ACCOUNT_TAG_USERNAME    0x02
+#define ACCOUNT_TAG_PASSWORD    0x03
+#define ACCOUNT_TAG_TOTP_SECRET 0x04   // Base32 text (older records)
+#define ACCOUNT_TAG_TOTP_DIGITS 0x05   // 1 byte
+#define ACCOUNT_TAG_TOTP_PERIOD 0x06   // seconds, 2 bytes big-endian
+#define ACCOUNT_TAG_NONCE       0x07   // CHACHA20_NONCE_SIZE bytes
+#define ACCOUNT_TAG_TOTP_HASH   0x08   // 1 byte, a totp_hash; SHA-1 if absent
+#define ACCOUNT_TAG_HOTP        0x09   // initial counter, 8 bytes big-endian
+#define ACCOUNT_TAG_TOTP_SEED   0x0A   // the decoded TOTP secret
+
+// Longest TOTP seed: the SHA-512 block size, past which HMAC hashes the key.
+#define ACCOUNT_SEED_MAX 128
+
+// Account n is stored under vault key ACCOUNT_KEY_BASE + n, clear of the
+// keys holding values imported from the old layout.
+#define ACCOUNT_KEY_BASE VAULT_LEGACY_KEYS
+#define ACCOUNT_MAX (VAULT_MAX_KEYS - ACCOUNT_KEY_BASE)
+
+// Longest field value the length encoding allows.
+#define ACCOUNT_FIELD_MAX 0x7FFF
+
+// Decoded account. The strings point into the encoded record (usually
+// memory-mapped flash) and are not NUL-terminated. If 'nonce' is set, the
+// username, password and TOTP secret or seed are still encrypted; read them
+// with account_read().
+typedef struct {
+    const char *name;
+    size_t name_len;
+    const char *username;
+    size_t username_len;
+    const char *password;
+    size_t password_len;
+    const char *totp_secret;    // Base32; decoded into totp_seed when stored
+    size_t totp_secret_len;
+    const uint8_t *totp_seed;
+    size_t totp_seed_len;
+    uint8_t totp_digits;        // 0 if the account has no TOTP
+    uint16_t totp_period;
+    uint8_t totp_hash;          // totp_hash (totp.h)
+    bool hotp;                  // the TOTP fields describe an HOTP account
+    uint64_t hotp_counter;      // first counter value; the moving counter
+                                // lives in the counter log (counter_log.h)
+    const uint8_t *record;      // the encoded record, set by account_decode()
+    size_t record_len;
+    const uint8_t *nonce;       // NULL if the secrets are plaintext
+} account;
+
+// Encodes 'acc' into 'out'. Empty fields are left out. Values are copied as
+// they are and no NONCE field is written.
+// Returns the encoded length, or -1 if it doesn't fit in 'out_max'.
+int account_encode(const account *acc, uint8_t *out, size_t out_max);
+
+// Decodes 'len' bytes of 'data' into 'acc'. Returns 0 on success, or -1 if
+// the record is malformed or has an unknown version.
+int account_decode(const uint8_t *data, size_t len, account *acc);
+
+// Reads account 'id' straight from the vault. Returns 0 on success, or -1 if
+// there is no such account. The strings are valid until the next vault write.
+int account_load(uint16_t id, account *acc);
+
+// Stores 'acc' as account 'id' and updates the name index. The fields may
+// point into flash, including into an encrypted record. While the vault is
+// unlocked the secrets are encrypted under a fresh nonce; while it is locked,
+// only plaintext accounts can be stored. A Base32 totp_secret is stored as
+// its seed. Returns 0 on success, or -1 on error, including a new TOTP
+// secret that is not Base32 or decodes to more than ACCOUNT_SEED_MAX bytes.
+int account_store(uint16_t id, const account *acc);
+
+// Copies 'len' bytes of 'field' (one of acc's string fields) from position
+// 'pos' to 'out', decrypting them if the record is encrypted. Decrypting a
+// piece that ends on a multiple of CHACHA20_BLOCK_SIZE in the record costs
+// one cipher block. Returns 0, or -1 if the vault is locked.
+int account_read(const account *acc, const char *field, size_t pos, size_t len, char *out);
+
+// CRC-32 of the record as account_encode() would produce it: without the
+// NONCE field and with the secrets decrypted. Lets a host compare records
+// without seeing them. Needs the vault unlocked for encrypted records.
+uint32_t account_plain_crc(const uint8_t *data, size_t len);
+
+// Writes the record as account_encode() would produce it (see
+// account_plain_crc()) to 'out'. Returns its length, or -1 if it does not
+// fit or is encrypted while the vault is locked.
+int account_export(const uint8_t *data, size_t len, uint8_t *out, size_t out_max);
+
+// Re-stores every plaintext account encrypted, then compacts the vault so no
+// plaintext copy is left in flash. Call after unlocking. Returns the number
+// of accounts encrypted, or -1 on error.
+int account_encrypt_all(void);
+
+// Re-stores every account that still holds its TOTP secret as Base32 text
+// with the decoded seed instead. Encrypted accounts are only converted while
+// the vault is unlocked. Returns the number of accounts converted, or -1 on
+// error.
+int account_migrate_seeds(void);
+
+// Removes account 'id' from the vault and the name index.
+// Returns 0 on success, or -1 on error.
+int account_remove(uint16_t id);
+
+// Converts the per-field strings imported from the old layout into accounts:
+// user u (button mask 1-63) becomes account u-1, named "user<u>". Safe to
+// rerun after a power loss. Returns the number of accounts created.
+int account_migrate_legacy(void);
+
+#endif // ACCOUNT_H
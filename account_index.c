@@ -0,0 +1,123 @@
+#include "account_index.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+// Parallel arrays keep each entry at 6 bytes.
+static uint32_t head[ACCOUNT_MAX];   // first four name bytes, big-endian
+static uint16_t ids[ACCOUNT_MAX];
+static size_t count;
+
+static uint32_t name_head(const char *name, size_t len) {
+    uint32_t h = 0;
+    for (size_t i = 0; i < 4; i++) {
+        h = (h << 8) | (i < len ? (uint8_t)name[i] : 0);
+    }
+    return h;
+}
+
+// Compares 'name' with the name of the entry at 'pos', like memcmp() with
+// shorter names first. With 'prefix' set, an entry that starts with 'name'
+// compares equal.
+static int compare(const char *name, size_t len, uint32_t h, size_t pos, bool prefix) {
+    // Heads of names shorter than four bytes are zero-padded, which still
+    // orders them correctly as long as names contain no NULs.
+    uint32_t other = head[pos];
+    if (prefix && len < 4) {
+        other &= len ? ~0u << (8 * (4 - len)) : 0;
+    }
+    if (h != other) return h < other ? -1 : 1;
+    if (prefix && len <= 4) return 0;
+
+    account acc;
+    if (account_load(ids[pos], &acc) != 0) return 1;
+    size_t n = len < acc.name_len ? len : acc.name_len;
+    int c = memcmp(name, acc.name, n);
+    if (c != 0) return c;
+    if (prefix && len <= acc.name_len) return 0;
+    return (len > acc.name_len) - (len < acc.name_len);
+}
+
+// First position whose entry does not compare below 'name'.
+static size_t lower_bound(const char *name, size_t len, bool prefix) {
+    uint32_t h = name_head(name, len);
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (compare(name, len, h, mid, prefix) > 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// First position whose entry compares above 'name'.
+static size_t upper_bound(const char *name, size_t len, bool prefix) {
+    uint32_t h = name_head(name, len);
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (compare(name, len, h, mid, prefix) >= 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+void account_index_build(void) {
+    count = 0;
+    for (uint16_t id = 0; id < ACCOUNT_MAX; id++) {
+        account acc;
+        if (account_load(id, &acc) == 0) {
+            account_index_insert(id, acc.name, acc.name_len);
+        }
+    }
+}
+
+void account_index_insert(uint16_t id, const char *name, size_t name_len) {
+    if (count >= ACCOUNT_MAX) return;
+    size_t pos = upper_bound(name, name_len, false);
+    memmove(&head[pos + 1], &head[pos], (count - pos) * sizeof(head[0]));
+    memmove(&ids[pos + 1], &ids[pos], (count - pos) * sizeof(ids[0]));
+    head[pos] = name_head(name, name_len);
+    ids[pos] = id;
+    count++;
+}
+
+void account_index_remove(uint16_t id, const char *name, size_t name_len) {
+    size_t pos = lower_bound(name, name_len, false);
+    size_t end = upper_bound(name, name_len, false);
+    for (; pos < end; pos++) {
+        if (ids[pos] == id) {
+            memmove(&head[pos], &head[pos + 1], (count - pos - 1) * sizeof(head[0]));
+            memmove(&ids[pos], &ids[pos + 1], (count - pos - 1) * sizeof(ids[0]));
+            count--;
+            return;
+        }
+    }
+}
+
+size_t account_index_count(void) {
+    return count;
+}
+
+uint16_t account_index_at(size_t pos) {
+    return ids[pos];
+}
+
+int account_index_find(const char *name, size_t name_len) {
+    size_t pos = lower_bound(name, name_len, false);
+    if (pos < count && compare(name, name_len, name_head(name, name_len), pos, false) == 0) {
+        return ids[pos];
+    }
+    return -1;
+}
+
+size_t account_index_prefix(const char *prefix, size_t prefix_len, size_t *first) {
+    *first = lower_bound(prefix, prefix_len, true);
+    return upper_bound(prefix, prefix_len, true) - *first;
+}
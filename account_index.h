@@ -0,0 +1,41 @@
+#ifndef ACCOUNT_INDEX_H
+#define ACCOUNT_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "account.h"
+
+// In-RAM index of accounts sorted by name (bytewise), for O(log n) exact and
+// prefix lookup. Each entry is the account id plus the first four name bytes
+// packed big-endian, so most comparisons never touch flash; ties fall back to
+// the full name in the record. 6 bytes per account.
+//
+// Built by scanning the vault at boot; account_store() and account_remove()
+// keep it up to date.
+
+// Rebuilds the index from every account in the vault.
+void account_index_build(void);
+
+// Adds account 'id' with the given name. Called by account_store().
+void account_index_insert(uint16_t id, const char *name, size_t name_len);
+
+// Removes account 'id', currently named 'name'. Called by account_store()
+// and account_remove() before the record changes.
+void account_index_remove(uint16_t id, const char *name, size_t name_len);
+
+// Number of indexed accounts.
+size_t account_index_count(void);
+
+// Account id at sorted position 'pos' (0 <= pos < account_index_count()).
+uint16_t account_index_at(size_t pos);
+
+// Returns the id of the account named exactly 'name', or -1 if none.
+int account_index_find(const char *name, size_t name_len);
+
+// Finds the accounts whose names start with 'prefix'. Returns how many there
+// are and sets '*first' to the sorted position of the first one; they are
+// contiguous from there.
+size_t account_index_prefix(const char *prefix, size_t prefix_len, size_t *first);
+
+#endif // ACCOUNT_INDEX_H
@@ -1,38 +1,109 @@
 #include "base32.h"
 #include <string.h>
 
+#define BAD 0xFF    // not Base32: the input is rejected
+#define SKP 0xFE    // padding or whitespace: skipped
+
+// 5-bit value of each character. Both markers have bits above the low five
+// set, so one test on the OR of a block finds any of them.
+static const uint8_t decode_table[256] = {
+    BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, SKP, SKP, BAD, BAD, SKP, BAD, BAD,
+    BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD,
+    SKP, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD,
+    BAD, BAD,  26,  27,  28,  29,  30,  31, BAD, BAD, BAD, BAD, BAD, SKP, BAD, BAD,
+    BAD,   0,   1,   2,   3,   4,   5,   6,   7,   8,   9,  10,  11,  12,  13,  14,
+     15,  16,  17,  18,  19,  20,  21,  22,  23,  24,  25, BAD, BAD, BAD, BAD, BAD,
+    BAD,   0,   1,   2,   3,   4,   5,   6,   7,   8,   9,  10,  11,  12,  13,  14,
+     15,  16,  17,  18,  19,  20,  21,  22,  23,  24,  25, BAD, BAD, BAD, BAD, BAD,
+    BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD,
+    BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD,
+    BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD,
+    BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD,
+    BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD,
+    BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD,
+    BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD,
+    BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD,
+};
+
+static const char encode_table[32] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+
 int base32_decode(const char *encoded, uint8_t *output, size_t out_max) {
-    size_t encoded_len = strlen(encoded);
+    return base32_decode_len(encoded, strlen(encoded), output, out_max);
+}
+
+int base32_decode_len(const char *encoded, size_t len, uint8_t *output, size_t out_max) {
+    const uint8_t *in = (const uint8_t *)encoded;
     size_t out_index = 0;
     int bits = 0;
     uint32_t bit_buffer = 0;
 
-    for (size_t i = 0; i < encoded_len; i++) {
-        char c = encoded[i];
-        // Skip padding and whitespace.
-        if (c == '=' || c == ' ' || c == '\t' || c == '\n' || c == '\r')
-            continue;
-
-        int val;
-        if (c >= 'A' && c <= 'Z') {
-            val = c - 'A';
-        } else if (c >= '2' && c <= '7') {
-            val = c - '2' + 26;
-        } else if (c >= 'a' && c <= 'z') {
-            val = c - 'a';
-        } else {
-            return -1;
+    size_t i = 0;
+    while (i < len) {
+        // Whole blocks of eight data characters, five bytes each.
+        if (bits == 0 && len - i >= 8 && out_max - out_index >= 5) {
+            uint8_t v0 = decode_table[in[i]], v1 = decode_table[in[i + 1]];
+            uint8_t v2 = decode_table[in[i + 2]], v3 = decode_table[in[i + 3]];
+            uint8_t v4 = decode_table[in[i + 4]], v5 = decode_table[in[i + 5]];
+            uint8_t v6 = decode_table[in[i + 6]], v7 = decode_table[in[i + 7]];
+            if (((v0 | v1 | v2 | v3 | v4 | v5 | v6 | v7) & 0xE0) == 0) {
+                uint8_t *out = output + out_index;
+                out[0] = (uint8_t)(v0 << 3 | v1 >> 2);
+                out[1] = (uint8_t)(v1 << 6 | v2 << 1 | v3 >> 4);
+                out[2] = (uint8_t)(v3 << 4 | v4 >> 1);
+                out[3] = (uint8_t)(v4 << 7 | v5 << 2 | v6 >> 3);
+                out[4] = (uint8_t)(v6 << 5 | v7);
+                out_index += 5;
+                i += 8;
+                continue;
+            }
         }
 
-        bit_buffer = (bit_buffer << 5) | (val & 0x1F);
+        uint8_t val = decode_table[in[i++]];
+        if (val == SKP) continue;
+        if (val == BAD) return -1;
+
+        bit_buffer = (bit_buffer << 5) | val;
         bits += 5;
         if (bits >= 8) {
             bits -= 8;
             if (out_index >= out_max)
                 return -1;
             output[out_index++] = (uint8_t)(bit_buffer >> bits);
-            bit_buffer &= ((1 << bits) - 1);
+            bit_buffer &= ((1u << bits) - 1);
         }
     }
-    return out_index;
+    return (int)out_index;
+}
+
+// Encodes one block; a short final block is zero-filled by the caller.
+static void encode_block(const uint8_t b[5], char *out) {
+    out[0] = encode_table[b[0] >> 3];
+    out[1] = encode_table[(b[0] << 2 | b[1] >> 6) & 0x1F];
+    out[2] = encode_table[(b[1] >> 1) & 0x1F];
+    out[3] = encode_table[(b[1] << 4 | b[2] >> 4) & 0x1F];
+    out[4] = encode_table[(b[2] << 1 | b[3] >> 7) & 0x1F];
+    out[5] = encode_table[(b[3] >> 2) & 0x1F];
+    out[6] = encode_table[(b[3] << 3 | b[4] >> 5) & 0x1F];
+    out[7] = encode_table[b[4] & 0x1F];
+}
+
+int base32_encode(const uint8_t *data, size_t len, char *out, size_t out_max) {
+    if (out_max < BASE32_ENCODED_SIZE(len)) return -1;
+
+    size_t n = 0;
+    size_t i = 0;
+    for (; len - i >= 5; i += 5, n += 8) {
+        encode_block(data + i, out + n);
+    }
+    if (i < len) {
+        // Characters that carry data for 1-4 trailing bytes.
+        static const uint8_t used[5] = { 0, 2, 4, 5, 7 };
+        uint8_t tail[5] = { 0 };
+        memcpy(tail, data + i, len - i);
+        encode_block(tail, out + n);
+        memset(out + n + used[len - i], '=', 8 - used[len - i]);
+        n += 8;
+    }
+    out[n] = '\0';
+    return (int)n;
 }
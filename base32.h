@@ -4,9 +4,26 @@
 #include <stddef.h>
 #include <stdint.h>
 
+// RFC 4648 Base32. Both directions work on blocks of 8 characters / 5
+// bytes through lookup tables; the decoder drops to one character at a time
+// only around padding, whitespace and the final partial block.
+
+// Characters base32_encode() writes for 'n' bytes, plus the terminating NUL.
+#define BASE32_ENCODED_SIZE(n) (((n) + 4) / 5 * 8 + 1)
+
 // Decodes a Base32-encoded string into bytes.
 // 'encoded' is the Base32 string, 'output' is the destination buffer with size 'out_max'.
+// Lower case is accepted; '=' padding and whitespace are skipped.
 // Returns the number of decoded bytes, or -1 on error.
 int base32_decode(const char *encoded, uint8_t *output, size_t out_max);
 
+// Same as base32_decode(), for the 'len' characters at 'encoded', which need
+// not be NUL-terminated.
+int base32_decode_len(const char *encoded, size_t len, uint8_t *output, size_t out_max);
+
+// Encodes 'len' bytes as upper-case Base32 with '=' padding and a
+// terminating NUL. Returns the number of characters written (without the
+// NUL), or -1 if 'out_max' is less than BASE32_ENCODED_SIZE(len).
+int base32_encode(const uint8_t *data, size_t len, char *out, size_t out_max);
+
 #endif // BASE32_H
@@ -0,0 +1,709 @@
+// Micro-benchmarks for the crypto core (sha1/sha256/sha512 and their HMACs,
+// pbkdf2_hmac_sha1, base32, totp, chacha20).
+//
+// Build on the host with the HOST_BUILD CMake path and run ./crypto_bench, or
+// flash crypto_bench_pico.uf2 and read the results from the USB serial port.
+// Every benchmark first checks a known-answer vector so that numbers are never
+// reported for a broken implementation. Output is one line per case:
+//   name  size  ns/op  cycles/op  allocs/op
+// Cycles are TSC ticks on x86 hosts and core clock cycles (SysTick) on the Pico;
+// Pico calls longer than one SysTick wrap are converted from microseconds.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(PICO_ON_DEVICE) && PICO_ON_DEVICE
+#include "pico/stdlib.h"
+#include "hardware/structs/systick.h"
+#include "hardware/clocks.h"
+#define BENCH_ON_PICO 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAVE_TSC 1
+#endif
+
+#include "sha1.h"
+#include "sha256.h"
+#include "sha512.h"
+#include "base32.h"
+#include "totp.h"
+#include "chacha20.h"
+#include "pbkdf2.h"
+
+// Minimum wall time spent on each case before a result is reported.
+#define BENCH_MIN_NS 100000000ull
+
+//--------------------------------------------------------------------+
+// Allocation counting
+//--------------------------------------------------------------------+
+static size_t alloc_count = 0;
+
+#ifdef BENCH_COUNT_ALLOCS
+// Linked with -Wl,--wrap=malloc etc., see CMakeLists.txt.
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    alloc_count++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+    alloc_count++;
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    alloc_count++;
+    return __real_realloc(ptr, size);
+}
+#endif
+
+//--------------------------------------------------------------------+
+// Timing
+//--------------------------------------------------------------------+
+#ifdef BENCH_ON_PICO
+static uint64_t bench_now_ns(void) {
+    return time_us_64() * 1000ull;
+}
+
+// Core clock cycles per microsecond, for calls too long for SysTick.
+static uint32_t bench_cycles_per_us;
+
+// SysTick is a 24-bit down-counter on the core clock.
+static void bench_cycles_init(void) {
+    bench_cycles_per_us = clock_get_hz(clk_sys) / 1000000u;
+    systick_hw->rvr = 0x00FFFFFF;
+    systick_hw->cvr = 0;
+    systick_hw->csr = 0x5; // enable, processor clock, no interrupt
+}
+#else
+static uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void bench_cycles_init(void) {
+}
+#endif
+
+typedef void (*bench_fn)(void *arg);
+
+// Keeps the optimizer from discarding benchmarked work.
+static volatile uint8_t bench_sink;
+
+// Runs 'iters' calls of 'fn' and returns the cycles spent, or 0 if the
+// platform has no cycle counter.
+static uint64_t bench_batch(bench_fn fn, void *arg, uint64_t iters) {
+    uint64_t cycles = 0;
+#if defined(BENCH_ON_PICO)
+    // The 24-bit counter wraps every ~130 ms, so time each call on its own.
+    // A call that may have spanned a wrap (pbkdf2 with many iterations) is
+    // counted from the microsecond timer instead, at 1 us resolution.
+    uint32_t wrap_us = 0x01000000u / bench_cycles_per_us;
+    for (uint64_t i = 0; i < iters; i++) {
+        uint64_t start_us = time_us_64();
+        uint32_t start = systick_hw->cvr;
+        fn(arg);
+        uint32_t end = systick_hw->cvr;
+        uint64_t took_us = time_us_64() - start_us;
+        if (took_us + 1 >= wrap_us) {
+            cycles += took_us * bench_cycles_per_us;
+        } else {
+            cycles += (start - end) & 0x00FFFFFF;
+        }
+    }
+#elif defined(BENCH_HAVE_TSC)
+    uint64_t start = __rdtsc();
+    for (uint64_t i = 0; i < iters; i++) {
+        fn(arg);
+    }
+    cycles = __rdtsc() - start;
+#else
+    for (uint64_t i = 0; i < iters; i++) {
+        fn(arg);
+    }
+#endif
+    return cycles;
+}
+
+static void bench_run(const char *name, size_t size, bench_fn fn, void *arg) {
+    fn(arg); // warm up caches
+
+    uint64_t iters = 1;
+    uint64_t elapsed = 0;
+    uint64_t cycles = 0;
+    size_t allocs = 0;
+    for (;;) {
+        alloc_count = 0;
+        uint64_t start = bench_now_ns();
+        cycles = bench_batch(fn, arg, iters);
+        elapsed = bench_now_ns() - start;
+        allocs = alloc_count;
+        if (elapsed >= BENCH_MIN_NS) break;
+        iters *= 2;
+    }
+
+    printf("%-20s %8u %12.1f", name, (unsigned)size, (double)elapsed / (double)iters);
+#if defined(BENCH_ON_PICO) || defined(BENCH_HAVE_TSC)
+    printf(" %12.1f", (double)cycles / (double)iters);
+#else
+    (void)cycles;
+    printf(" %12s", "n/a");
+#endif
+#ifdef BENCH_COUNT_ALLOCS
+    printf(" %10.2f\n", (double)allocs / (double)iters);
+#else
+    (void)allocs;
+    printf(" %10s\n", "n/a");
+#endif
+}
+
+static int check(const char *what, int ok) {
+    if (!ok) {
+        fprintf(stderr, "known-answer check failed: %s\n", what);
+    }
+    return ok;
+}
+
+static void to_hex(const uint8_t *in, size_t len, char *out) {
+    static const char hex[] = "0123456789abcdef";
+    for (size_t i = 0; i < len; i++) {
+        out[2*i] = hex[in[i] >> 4];
+        out[2*i+1] = hex[in[i] & 0x0F];
+    }
+    out[2*len] = '\0';
+}
+
+//--------------------------------------------------------------------+
+// Known-answer vectors (FIPS 180-1, FIPS 180-2, RFC 2202, RFC 4231, RFC 4648,
+// RFC 6070, RFC 6238, RFC 8439)
+//--------------------------------------------------------------------+
+// RFC 6238 appendix B seeds, Base32-encoded.
+static const char totp_seed_sha256[] = "GEZDGNBVGY3TQOJQGEZDGNBVGY3TQOJQGEZDGNBVGY3TQOJQGEZA====";
+static const char totp_seed_sha512[] = "GEZDGNBVGY3TQOJQGEZDGNBVGY3TQOJQGEZDGNBVGY3TQOJQGEZDGNBV"
+                                       "GY3TQOJQGEZDGNBVGY3TQOJQGEZDGNBVGY3TQOJQGEZDGNA=";
+
+static int self_test(void) {
+    uint8_t digest[20];
+    char hex[41];
+    int ok = 1;
+
+    sha1((const uint8_t *)"abc", 3, digest);
+    to_hex(digest, 20, hex);
+    ok &= check("sha1(abc)", strcmp(hex, "a9993e364706816aba3e25717850c26c9cd0d89d") == 0);
+
+    const char *two_block = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    sha1((const uint8_t *)two_block, strlen(two_block), digest);
+    to_hex(digest, 20, hex);
+    ok &= check("sha1(448 bits)", strcmp(hex, "84983e441c3bd26ebaae4aa1f95129e5e54670f1") == 0);
+
+    hmac_sha1((const uint8_t *)"Jefe", 4,
+              (const uint8_t *)"what do ya want for nothing?", 28, digest);
+    to_hex(digest, 20, hex);
+    ok &= check("hmac_sha1(rfc2202 #2)", strcmp(hex, "effcdf6ae5eb2fa2d27416d5f184df9c259a7c79") == 0);
+
+    uint8_t long_key[80];
+    memset(long_key, 0xAA, sizeof(long_key));
+    hmac_sha1(long_key, sizeof(long_key),
+              (const uint8_t *)"Test Using Larger Than Block-Size Key - Hash Key First", 54, digest);
+    to_hex(digest, 20, hex);
+    ok &= check("hmac_sha1(rfc2202 #6)", strcmp(hex, "aa4ae5e15272d00e95705637ce8a3b55ed402112") == 0);
+
+    uint8_t digest512[SHA512_DIGEST_SIZE];
+    char hex512[2 * SHA512_DIGEST_SIZE + 1];
+    sha256((const uint8_t *)"abc", 3, digest512);
+    to_hex(digest512, SHA256_DIGEST_SIZE, hex512);
+    ok &= check("sha256(abc)",
+                strcmp(hex512, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad") == 0);
+    sha256((const uint8_t *)two_block, strlen(two_block), digest512);
+    to_hex(digest512, 4, hex512);
+    ok &= check("sha256(448 bits)", strcmp(hex512, "248d6a61") == 0);
+    hmac_sha256((const uint8_t *)"Jefe", 4,
+                (const uint8_t *)"what do ya want for nothing?", 28, digest512);
+    to_hex(digest512, SHA256_DIGEST_SIZE, hex512);
+    ok &= check("hmac_sha256(rfc4231 #2)",
+                strcmp(hex512, "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843") == 0);
+
+    sha512((const uint8_t *)"abc", 3, digest512);
+    to_hex(digest512, SHA512_DIGEST_SIZE, hex512);
+    ok &= check("sha512(abc)",
+                strcmp(hex512, "ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a"
+                               "2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f") == 0);
+    // 112 bytes: the length no longer fits after the padding, so two blocks.
+    const char *two_block_512 = "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmn"
+                                "hijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu";
+    sha512((const uint8_t *)two_block_512, strlen(two_block_512), digest512);
+    to_hex(digest512, 8, hex512);
+    ok &= check("sha512(896 bits)", strcmp(hex512, "8e959b75dae313da") == 0);
+    hmac_sha512((const uint8_t *)"Jefe", 4,
+                (const uint8_t *)"what do ya want for nothing?", 28, digest512);
+    to_hex(digest512, 8, hex512);
+    ok &= check("hmac_sha512(rfc4231 #2)", strcmp(hex512, "164b7a7bfcf819e2") == 0);
+    uint8_t long_key_512[131];
+    memset(long_key_512, 0xAA, sizeof(long_key_512));
+    hmac_sha512(long_key_512, sizeof(long_key_512),
+                (const uint8_t *)"Test Using Larger Than Block-Size Key - Hash Key First", 54, digest512);
+    to_hex(digest512, 8, hex512);
+    ok &= check("hmac_sha512(rfc4231 #6)", strcmp(hex512, "80b24263c7c1a3eb") == 0);
+
+    pbkdf2_hmac_sha1((const uint8_t *)"password", 8, (const uint8_t *)"salt", 4, 1, digest, 20);
+    to_hex(digest, 20, hex);
+    ok &= check("pbkdf2_hmac_sha1(rfc6070 #1)", strcmp(hex, "0c60c80f961f0e71f3a9b524af6012062fe037a6") == 0);
+    pbkdf2_hmac_sha1((const uint8_t *)"password", 8, (const uint8_t *)"salt", 4, 4096, digest, 20);
+    to_hex(digest, 20, hex);
+    ok &= check("pbkdf2_hmac_sha1(rfc6070 #3)", strcmp(hex, "4b007901b765489abead49d926f721d065a429c1") == 0);
+
+    // Two output blocks, the second truncated, and a salt longer than one.
+    uint8_t derived[25];
+    char derived_hex[51];
+    pbkdf2_hmac_sha1((const uint8_t *)"passwordPASSWORDpassword", 24,
+                     (const uint8_t *)"saltSALTsaltSALTsaltSALTsaltSALTsalt", 36, 4096,
+                     derived, sizeof(derived));
+    to_hex(derived, sizeof(derived), derived_hex);
+    ok &= check("pbkdf2_hmac_sha1(rfc6070 #5)",
+                strcmp(derived_hex, "3d2eec4fe41c849b80c8d83662c0e44a8b291a964cf2f07038") == 0);
+
+    // RFC 4648 section 10, both ways.
+    static const char *const base32_vectors[][2] = {
+        { "", "" }, { "f", "MY======" }, { "fo", "MZXQ====" }, { "foo", "MZXW6===" },
+        { "foob", "MZXW6YQ=" }, { "fooba", "MZXW6YTB" }, { "foobar", "MZXW6YTBOI======" },
+    };
+    uint8_t decoded[80];
+    char encoded[BASE32_ENCODED_SIZE(80)];
+    for (size_t i = 0; i < sizeof(base32_vectors) / sizeof(base32_vectors[0]); i++) {
+        const char *plain = base32_vectors[i][0], *text = base32_vectors[i][1];
+        int n = base32_decode(text, decoded, sizeof(decoded));
+        ok &= check("base32_decode(rfc4648)",
+                    n == (int)strlen(plain) && memcmp(decoded, plain, strlen(plain)) == 0);
+        n = base32_encode((const uint8_t *)plain, strlen(plain), encoded, sizeof(encoded));
+        ok &= check("base32_encode(rfc4648)", n == (int)strlen(text) && strcmp(encoded, text) == 0);
+    }
+    // Every length and alignment of the block path, lower case and spacing.
+    uint8_t round[80];
+    for (size_t len = 0; len <= sizeof(round); len++) {
+        for (size_t i = 0; i < len; i++) {
+            round[i] = (uint8_t)(i * 167u + len);
+        }
+        int n = base32_encode(round, len, encoded, sizeof(encoded));
+        ok &= check("base32 round trip", n >= 0 &&
+                    base32_decode(encoded, decoded, sizeof(decoded)) == (int)len &&
+                    memcmp(decoded, round, len) == 0);
+    }
+    int n = base32_decode("mzxw 6ytb\noi======", decoded, sizeof(decoded));
+    ok &= check("base32_decode(spaced)", n == 6 && memcmp(decoded, "foobar", 6) == 0);
+    ok &= check("base32_decode(invalid)", base32_decode("MZXW6YT1", decoded, sizeof(decoded)) == -1);
+    ok &= check("base32_decode(overflow)", base32_decode("MZXW6YTBOI", decoded, 5) == -1);
+    ok &= check("base32_encode(overflow)",
+                base32_encode((const uint8_t *)"foobar", 6, encoded, 16) == -1);
+
+    char otp[10];
+    int remaining = 0;
+    int rc = totp(59, "GEZDGNBVGY3TQOJQGEZDGNBVGY3TQOJQ", TOTP_SHA1, 30, 8, otp, sizeof(otp),
+                  &remaining);
+    ok &= check("totp(rfc6238 t=59)", rc == 0 && strcmp(otp, "94287082") == 0 && remaining == 1);
+    rc = totp(1111111109, "GEZDGNBVGY3TQOJQGEZDGNBVGY3TQOJQ", TOTP_SHA1, 30, 8, otp, sizeof(otp),
+              &remaining);
+    ok &= check("totp(rfc6238 t=1111111109)", rc == 0 && strcmp(otp, "07081804") == 0);
+    rc = totp(59, totp_seed_sha256, TOTP_SHA256, 30, 8, otp, sizeof(otp), &remaining);
+    ok &= check("totp(rfc6238 sha256 t=59)", rc == 0 && strcmp(otp, "46119246") == 0);
+    rc = totp(1111111109, totp_seed_sha256, TOTP_SHA256, 30, 8, otp, sizeof(otp), &remaining);
+    ok &= check("totp(rfc6238 sha256 t=1111111109)", rc == 0 && strcmp(otp, "68084774") == 0);
+    rc = totp(59, totp_seed_sha512, TOTP_SHA512, 30, 8, otp, sizeof(otp), &remaining);
+    ok &= check("totp(rfc6238 sha512 t=59)", rc == 0 && strcmp(otp, "90693936") == 0);
+    rc = totp(1111111109, totp_seed_sha512, TOTP_SHA512, 30, 8, otp, sizeof(otp), &remaining);
+    ok &= check("totp(rfc6238 sha512 t=1111111109)", rc == 0 && strcmp(otp, "25091201") == 0);
+    totp_key key;
+    rc = totp_key_init(&key, "GEZDGNBVGY3TQOJQGEZDGNBVGY3TQOJQ", TOTP_SHA1);
+    if (rc == 0) {
+        rc = totp_with_key(&key, 20000000000ull, 30, 8, otp, sizeof(otp), &remaining);
+    }
+    ok &= check("totp_with_key(rfc6238 t=20000000000)", rc == 0 && strcmp(otp, "65353130") == 0);
+
+    // RFC 6238 steps 1111111109 and 1111111111 straddle one boundary.
+    char window[3][TOTP_CODE_SIZE];
+    rc = totp_window(&key, 1111111111, 30, 8, -1, 3, &window[0][0], TOTP_CODE_SIZE);
+    ok &= check("totp_window(rfc6238)", rc == 3 &&
+                strcmp(window[0], "07081804") == 0 && strcmp(window[1], "14050471") == 0);
+    rc = totp_with_key(&key, 1111111111 + 30, 30, 8, otp, sizeof(otp), &remaining);
+    ok &= check("totp_window(t+1)", rc == 0 && strcmp(window[2], otp) == 0);
+    ok &= check("totp_with_key(9 digits)",
+                totp_with_key(&key, 59, 30, 9, otp, sizeof(otp), &remaining) == 0 &&
+                strlen(otp) == 9);
+    ok &= check("totp digits out of range",
+                totp_with_key(&key, 59, 30, 0, otp, sizeof(otp), &remaining) == -1 &&
+                totp_with_key(&key, 59, 30, 10, otp, sizeof(otp), &remaining) == -1 &&
+                totp_with_key(&key, 59, 30, 40, otp, sizeof(otp), &remaining) == -1 &&
+                totp_window(&key, 59, 30, 40, 0, 1, &window[0][0], TOTP_CODE_SIZE) == -1 &&
+                hotp_with_key(&key, 0, 10, otp, sizeof(otp)) == -1);
+
+    uint8_t cc_key[CHACHA20_KEY_SIZE];
+    for (int i = 0; i < CHACHA20_KEY_SIZE; i++) {
+        cc_key[i] = (uint8_t)i;
+    }
+    static const uint8_t nonce_232[CHACHA20_NONCE_SIZE] = {0, 0, 0, 0x09, 0, 0, 0, 0x4a, 0, 0, 0, 0};
+    chacha20_ctx cc;
+    uint8_t block[CHACHA20_BLOCK_SIZE];
+    chacha20_init(&cc, cc_key, nonce_232);
+    chacha20_block(&cc, 1, block);
+    to_hex(block, 16, hex);
+    ok &= check("chacha20_block(rfc8439 2.3.2)", strcmp(hex, "10f1e7e4d13b5915500fdd1fa32071c4") == 0);
+
+    // RFC 8439 2.4.2 starts at block 1, i.e. keystream offset 64; done in
+    // odd-sized pieces to cover the offset handling.
+    static const uint8_t nonce_242[CHACHA20_NONCE_SIZE] = {0, 0, 0, 0, 0, 0, 0, 0x4a, 0, 0, 0, 0};
+    const char *sunscreen = "Ladies and Gentlemen of the class of '99: If I could offer you only "
+                            "one tip for the future, sunscreen would be it.";
+    uint8_t cipher[114];
+    chacha20_init(&cc, cc_key, nonce_242);
+    chacha20_xor(&cc, 64, (const uint8_t *)sunscreen, cipher, 5);
+    chacha20_xor(&cc, 69, (const uint8_t *)sunscreen + 5, cipher + 5, 70);
+    chacha20_xor(&cc, 139, (const uint8_t *)sunscreen + 75, cipher + 75, 39);
+    to_hex(cipher + 98, 16, hex);
+    ok &= check("chacha20_xor(rfc8439 2.4.2)", memcmp(cipher, "\x6e\x2e\x35\x9a", 4) == 0 &&
+                strcmp(hex, "0bbf74a35be6b40b8eedf2785e42874d") == 0);
+
+    return ok;
+}
+
+//--------------------------------------------------------------------+
+// Cases
+//--------------------------------------------------------------------+
+static uint8_t payload[4096];
+
+struct sized_arg {
+    size_t len;
+};
+
+static void run_sha1(void *arg) {
+    const struct sized_arg *a = arg;
+    uint8_t digest[20];
+    sha1(payload, a->len, digest);
+    bench_sink = digest[0];
+}
+
+static void run_sha256(void *arg) {
+    const struct sized_arg *a = arg;
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    sha256(payload, a->len, digest);
+    bench_sink = digest[0];
+}
+
+static void run_sha512(void *arg) {
+    const struct sized_arg *a = arg;
+    uint8_t digest[SHA512_DIGEST_SIZE];
+    sha512(payload, a->len, digest);
+    bench_sink = digest[0];
+}
+
+static void run_hmac_sha256(void *arg) {
+    const struct sized_arg *a = arg;
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    hmac_sha256(payload, 32, payload + 32, a->len, digest);
+    bench_sink = digest[0];
+}
+
+static void run_hmac_sha512(void *arg) {
+    const struct sized_arg *a = arg;
+    uint8_t digest[SHA512_DIGEST_SIZE];
+    hmac_sha512(payload, 64, payload + 64, a->len, digest);
+    bench_sink = digest[0];
+}
+
+static void run_hmac_sha1(void *arg) {
+    const struct sized_arg *a = arg;
+    uint8_t digest[20];
+    hmac_sha1(payload, 20, payload + 20, a->len, digest);
+    bench_sink = digest[0];
+}
+
+struct base32_arg {
+    char encoded[128];
+    size_t len;
+};
+
+static void run_base32_decode(void *arg) {
+    const struct base32_arg *a = arg;
+    uint8_t out[80];
+    bench_sink = (uint8_t)base32_decode(a->encoded, out, sizeof(out));
+}
+
+// The decoder base32.c had before its lookup table, for comparison.
+static int base32_decode_branchy(const char *encoded, uint8_t *output, size_t out_max) {
+    size_t encoded_len = strlen(encoded);
+    size_t out_index = 0;
+    int bits = 0;
+    uint32_t bit_buffer = 0;
+
+    for (size_t i = 0; i < encoded_len; i++) {
+        char c = encoded[i];
+        if (c == '=' || c == ' ' || c == '\t' || c == '\n' || c == '\r')
+            continue;
+
+        int val;
+        if (c >= 'A' && c <= 'Z') {
+            val = c - 'A';
+        } else if (c >= '2' && c <= '7') {
+            val = c - '2' + 26;
+        } else if (c >= 'a' && c <= 'z') {
+            val = c - 'a';
+        } else {
+            return -1;
+        }
+
+        bit_buffer = (bit_buffer << 5) | (val & 0x1F);
+        bits += 5;
+        if (bits >= 8) {
+            bits -= 8;
+            if (out_index >= out_max)
+                return -1;
+            output[out_index++] = (uint8_t)(bit_buffer >> bits);
+            bit_buffer &= ((1 << bits) - 1);
+        }
+    }
+    return (int)out_index;
+}
+
+static void run_base32_decode_branchy(void *arg) {
+    const struct base32_arg *a = arg;
+    uint8_t out[80];
+    bench_sink = (uint8_t)base32_decode_branchy(a->encoded, out, sizeof(out));
+}
+
+// Size is the number of input bytes.
+static void run_base32_encode(void *arg) {
+    const struct sized_arg *a = arg;
+    char out[BASE32_ENCODED_SIZE(80)];
+    bench_sink = (uint8_t)base32_encode(payload, a->len, out, sizeof(out));
+}
+
+struct totp_arg {
+    const char *secret;
+    uint64_t time;
+};
+
+static void run_totp(void *arg) {
+    struct totp_arg *a = arg;
+    char otp[10];
+    int remaining;
+    totp(a->time, a->secret, TOTP_SHA1, 30, 6, otp, sizeof(otp), &remaining);
+    a->time += 30;
+    bench_sink = (uint8_t)otp[0];
+}
+
+struct totp_key_arg {
+    totp_key key;
+    uint64_t time;
+};
+
+static void run_totp_cached(void *arg) {
+    struct totp_key_arg *a = arg;
+    char otp[10];
+    int remaining;
+    totp_with_key(&a->key, a->time, 30, 6, otp, sizeof(otp), &remaining);
+    a->time += 30;
+    bench_sink = (uint8_t)otp[0];
+}
+
+struct totp_seed_arg {
+    const char *secret;
+    uint8_t seed[64];
+    size_t seed_len;
+};
+
+// What preparing a key costs from the Base32 text and from the stored seed.
+static void run_totp_key_init(void *arg) {
+    const struct totp_seed_arg *a = arg;
+    totp_key key;
+    totp_key_init(&key, a->secret, TOTP_SHA1);
+    bench_sink = (uint8_t)key.hmac.sha1.inner.h[0];
+}
+
+static void run_totp_key_set(void *arg) {
+    const struct totp_seed_arg *a = arg;
+    totp_key key;
+    totp_key_set(&key, a->seed, a->seed_len, TOTP_SHA1);
+    bench_sink = (uint8_t)key.hmac.sha1.inner.h[0];
+}
+
+struct totp_window_arg {
+    totp_key key;
+    uint64_t time;
+    size_t count;
+};
+
+// Size is the iteration count; the output is one 20-byte block.
+static void run_pbkdf2(void *arg) {
+    const struct sized_arg *a = arg;
+    uint8_t out[20];
+    pbkdf2_hmac_sha1(payload, 4, payload + 4, 16, (uint32_t)a->len, out, sizeof(out));
+    bench_sink = out[0];
+}
+
+static uint64_t bench_now_us(void) {
+    return bench_now_ns() / 1000u;
+}
+
+static void run_chacha20(void *arg) {
+    const struct sized_arg *a = arg;
+    static uint8_t out[sizeof(payload)];
+    static chacha20_ctx ctx;
+    if (ctx.input[0] == 0) {
+        chacha20_init(&ctx, payload, payload + 32);
+    }
+    chacha20_xor(&ctx, 0, payload, out, a->len);
+    bench_sink = out[0];
+}
+
+static void run_totp_window(void *arg) {
+    struct totp_window_arg *a = arg;
+    char codes[16][TOTP_CODE_SIZE];
+    totp_window(&a->key, a->time, 30, 6, -1, a->count, &codes[0][0], TOTP_CODE_SIZE);
+    a->time += 30;
+    bench_sink = (uint8_t)codes[0][0];
+}
+
+int main(void) {
+#ifdef BENCH_ON_PICO
+    stdio_init_all();
+    sleep_ms(3000); // give the host time to open the serial port
+#endif
+    bench_cycles_init();
+
+    if (!self_test()) {
+        return 1;
+    }
+
+    for (size_t i = 0; i < sizeof(payload); i++) {
+        payload[i] = (uint8_t)(i * 131u + 7u);
+    }
+
+    printf("%-20s %8s %12s %12s %10s\n", "benchmark", "size", "ns/op", "cycles/op", "allocs/op");
+
+    static const size_t sha1_sizes[] = {0, 8, 55, 64, 256, 1024, 4096};
+    for (size_t i = 0; i < sizeof(sha1_sizes) / sizeof(sha1_sizes[0]); i++) {
+        struct sized_arg a = {sha1_sizes[i]};
+        bench_run("sha1", a.len, run_sha1, &a);
+    }
+
+    for (size_t i = 0; i < sizeof(sha1_sizes) / sizeof(sha1_sizes[0]); i++) {
+        struct sized_arg a = {sha1_sizes[i]};
+        bench_run("sha256", a.len, run_sha256, &a);
+    }
+    for (size_t i = 0; i < sizeof(sha1_sizes) / sizeof(sha1_sizes[0]); i++) {
+        struct sized_arg a = {sha1_sizes[i]};
+        bench_run("sha512", a.len, run_sha512, &a);
+    }
+
+    static const size_t hmac_sizes[] = {8, 64, 256, 1024};
+    for (size_t i = 0; i < sizeof(hmac_sizes) / sizeof(hmac_sizes[0]); i++) {
+        struct sized_arg a = {hmac_sizes[i]};
+        bench_run("hmac_sha1", a.len, run_hmac_sha1, &a);
+    }
+    for (size_t i = 0; i < sizeof(hmac_sizes) / sizeof(hmac_sizes[0]); i++) {
+        struct sized_arg a = {hmac_sizes[i]};
+        bench_run("hmac_sha256", a.len, run_hmac_sha256, &a);
+    }
+    for (size_t i = 0; i < sizeof(hmac_sizes) / sizeof(hmac_sizes[0]); i++) {
+        struct sized_arg a = {hmac_sizes[i]};
+        bench_run("hmac_sha512", a.len, run_hmac_sha512, &a);
+    }
+
+    static const size_t pbkdf2_iterations[] = {1, 1000, 10000};
+    for (size_t i = 0; i < sizeof(pbkdf2_iterations) / sizeof(pbkdf2_iterations[0]); i++) {
+        struct sized_arg a = {pbkdf2_iterations[i]};
+        bench_run("pbkdf2_hmac_sha1", a.len, run_pbkdf2, &a);
+    }
+
+    // 64 bytes is one block: the cost of decrypting a secret's first chunk.
+    static const size_t chacha_sizes[] = {16, 64, 256, 1024, 4096};
+    for (size_t i = 0; i < sizeof(chacha_sizes) / sizeof(chacha_sizes[0]); i++) {
+        struct sized_arg a = {chacha_sizes[i]};
+        bench_run("chacha20", a.len, run_chacha20, &a);
+    }
+
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+    static const size_t base32_sizes[] = {16, 32, 64, 128 - 1};
+    for (size_t i = 0; i < sizeof(base32_sizes) / sizeof(base32_sizes[0]); i++) {
+        struct base32_arg a;
+        a.len = base32_sizes[i];
+        for (size_t j = 0; j < a.len; j++) {
+            a.encoded[j] = alphabet[(j * 7) % 32];
+        }
+        a.encoded[a.len] = '\0';
+        bench_run("base32_decode", a.len, run_base32_decode, &a);
+        bench_run("base32_decode_old", a.len, run_base32_decode_branchy, &a);
+    }
+    static const size_t base32_encode_sizes[] = {10, 20, 40, 80};
+    for (size_t i = 0; i < sizeof(base32_encode_sizes) / sizeof(base32_encode_sizes[0]); i++) {
+        struct sized_arg a = {base32_encode_sizes[i]};
+        bench_run("base32_encode", a.len, run_base32_encode, &a);
+    }
+
+    static const char *totp_secrets[] = {
+        "JBSWY3DPEHPK3PXP",
+        "GEZDGNBVGY3TQOJQGEZDGNBVGY3TQOJQ",
+    };
+    for (size_t i = 0; i < sizeof(totp_secrets) / sizeof(totp_secrets[0]); i++) {
+        struct totp_arg a = {totp_secrets[i], 1700000000u};
+        bench_run("totp", strlen(a.secret), run_totp, &a);
+    }
+    for (size_t i = 0; i < sizeof(totp_secrets) / sizeof(totp_secrets[0]); i++) {
+        struct totp_key_arg a;
+        totp_key_init(&a.key, totp_secrets[i], TOTP_SHA1);
+        a.time = 1700000000u;
+        bench_run("totp_with_key", strlen(totp_secrets[i]), run_totp_cached, &a);
+    }
+    for (size_t i = 0; i < sizeof(totp_secrets) / sizeof(totp_secrets[0]); i++) {
+        struct totp_seed_arg a;
+        a.secret = totp_secrets[i];
+        a.seed_len = (size_t)base32_decode(a.secret, a.seed, sizeof(a.seed));
+        bench_run("totp_key_init", strlen(a.secret), run_totp_key_init, &a);
+        bench_run("totp_key_set", a.seed_len, run_totp_key_set, &a);
+    }
+
+    // One code per hash, for the RFC 6238 seed each is specified with.
+    static const struct {
+        const char *name;
+        const char *secret;
+        totp_hash hash;
+    } totp_hashes[] = {
+        { "totp_sha1", "GEZDGNBVGY3TQOJQGEZDGNBVGY3TQOJQ", TOTP_SHA1 },
+        { "totp_sha256", totp_seed_sha256, TOTP_SHA256 },
+        { "totp_sha512", totp_seed_sha512, TOTP_SHA512 },
+    };
+    for (size_t i = 0; i < sizeof(totp_hashes) / sizeof(totp_hashes[0]); i++) {
+        struct totp_key_arg a;
+        totp_key_init(&a.key, totp_hashes[i].secret, totp_hashes[i].hash);
+        a.time = 1700000000u;
+        bench_run(totp_hashes[i].name, strlen(totp_hashes[i].secret), run_totp_cached, &a);
+    }
+
+    // Size column is the number of codes per call.
+    static const size_t window_sizes[] = {1, 3, 16};
+    for (size_t i = 0; i < sizeof(window_sizes) / sizeof(window_sizes[0]); i++) {
+        struct totp_window_arg a;
+        totp_key_init(&a.key, totp_secrets[0], TOTP_SHA1);
+        a.time = 1700000000u;
+        a.count = window_sizes[i];
+        bench_run("totp_window", a.count, run_totp_window, &a);
+    }
+
+    // The cost factor to pick for this board: a 32-byte vault key at 300 ms.
+    uint32_t rate = pbkdf2_rate(bench_now_us, 200);
+    printf("\npbkdf2_hmac_sha1: %lu iterations/s, %lu iterations for a 32-byte key in 300 ms\n",
+           (unsigned long)rate, (unsigned long)pbkdf2_iterations_for(rate, 300, 32));
+
+#ifdef BENCH_ON_PICO
+    printf("done\n");
+    while (1) {
+        tight_loop_contents();
+    }
+#endif
+    return 0;
+}
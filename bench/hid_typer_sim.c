@@ -0,0 +1,164 @@
+// USB frame simulator for the HID typing engine.
+//
+// Models a full-speed interrupt IN endpoint polled once per bInterval: the
+// host takes at most one queued report per poll and the device completion
+// callback then queues the next one. The host side decodes newly pressed keys
+// back into characters to check that what arrives matches what was sent.
+// Reports chars/s at a 1 ms bInterval and reports per character, for full
+// 6-key packing and for the one-new-key-per-report fallback. The old
+// press/release-per-character engine needed 2 reports per character.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "hid_typer.h"
+#include "keymap.h"
+
+#define BINTERVAL_MS 1
+
+//--------------------------------------------------------------------+
+// Host-side decoding
+//--------------------------------------------------------------------+
+static keymap_layout host_layout;
+
+// Reverse lookup through the same table the firmware uses.
+static char sim_unmap(uint8_t keycode, uint8_t modifier) {
+    const keymap_entry *table = keymap_table(host_layout);
+    for (int c = 0; c < 128; c++) {
+        if (table[c].keycode == keycode && table[c].modifier == modifier) {
+            return (char)c;
+        }
+    }
+    return '?';
+}
+
+//--------------------------------------------------------------------+
+// Endpoint and host model
+//--------------------------------------------------------------------+
+static struct {
+    bool pending;
+    uint8_t modifier;
+    uint8_t keycode[6];
+} endpoint;
+
+static struct {
+    uint8_t keycode[6];   // keys held after the previous report
+    char typed[512];
+    size_t typed_len;
+    size_t reports;
+} host;
+
+static bool sim_send(uint8_t modifier, const uint8_t keycode[6]) {
+    if (endpoint.pending) return false;
+    endpoint.pending = true;
+    endpoint.modifier = modifier;
+    memcpy(endpoint.keycode, keycode, 6);
+    return true;
+}
+
+// The host sees a character for each key that was not already held.
+static void host_receive(uint8_t modifier, const uint8_t keycode[6]) {
+    host.reports++;
+    for (int i = 0; i < 6; i++) {
+        if (keycode[i] == 0) continue;
+        bool held = false;
+        for (int j = 0; j < 6; j++) {
+            held |= (host.keycode[j] == keycode[i]);
+        }
+        if (!held && host.typed_len < sizeof(host.typed) - 1) {
+            host.typed[host.typed_len++] = sim_unmap(keycode[i], modifier);
+        }
+    }
+    memcpy(host.keycode, keycode, 6);
+}
+
+//--------------------------------------------------------------------+
+// Simulation
+//--------------------------------------------------------------------+
+static bool simulate(const char *text, uint8_t max_new_keys) {
+    hid_typer_t typer;
+    memset(&endpoint, 0, sizeof(endpoint));
+    memset(&host, 0, sizeof(host));
+    hid_typer_init(&typer, sim_send, keymap_lookup);
+    typer.max_new_keys = max_new_keys;
+    hid_typer_start(&typer, text, strlen(text));
+
+    uint32_t frames = 0;
+    while (hid_typer_busy(&typer)) {
+        // One host poll per bInterval.
+        frames++;
+        if (endpoint.pending) {
+            endpoint.pending = false;
+            host_receive(endpoint.modifier, endpoint.keycode);
+            hid_typer_report_complete(&typer);
+        }
+        // Main loop iterations between polls.
+        hid_typer_task(&typer);
+    }
+
+    // Characters the layout can't type are skipped by the engine.
+    char expected[512];
+    size_t expected_len = 0;
+    for (const char *c = text; *c; c++) {
+        uint8_t k, m;
+        if (keymap_lookup(*c, &k, &m)) expected[expected_len++] = *c;
+    }
+    expected[expected_len] = '\0';
+
+    size_t len = strlen(text);
+    host.typed[host.typed_len] = '\0';
+    bool ok = (strcmp(host.typed, expected) == 0);
+    double ms = (double)frames * BINTERVAL_MS;
+    printf("%-24.24s %4u %6zu %8zu %13.2f %8u %10.0f %s\n", text, max_new_keys, len, host.reports,
+           (double)host.reports / (double)len, frames, 1000.0 * (double)len / ms,
+           ok ? "ok" : "MISMATCH");
+    return ok;
+}
+
+int main(void) {
+    static const char *passwords[] = {
+        "hunter2",
+        "correcthorsebatterystaple",
+        "Tr0ub4dor3",
+        "aaaaaaaaaaaaaaaa",
+        "q7WmX2pLk9RzT4vNb8YcH3sJd6FgA1eU",
+        "Zx81kQpWm3nB5vC7rT9yU2iO4pL6kJ8hG0fD1sA3zX5cV7bN9mQ2wE4rT6yU8iO0",
+        "mississippi",
+        "PASSWORDpassword1234",
+        "p@ss#W0rd!{~}|\\;:'\"<>?/",
+        "Yz_-+=*&^%$()[]",
+    };
+    static const char *layout_names[] = {"US", "UK", "DE"};
+
+    static const uint8_t modes[] = {HID_TYPER_MAX_NEW_KEYS, 1};
+
+    printf("%-24s %4s %6s %8s %13s %8s %10s\n", "text", "pack", "chars", "reports",
+           "reports/char", "frames", "chars/s");
+    bool ok = true;
+    for (int layout = 0; layout < KEYMAP_LAYOUT_COUNT; layout++) {
+        // Typing and decoding with the same layout must round-trip every
+        // character the layout supports.
+        keymap_set_layout((keymap_layout)layout);
+        host_layout = (keymap_layout)layout;
+        printf("layout %s\n", layout_names[layout]);
+        ok &= simulate(passwords[sizeof(passwords) / sizeof(passwords[0]) - 2], HID_TYPER_MAX_NEW_KEYS);
+        ok &= simulate(passwords[sizeof(passwords) / sizeof(passwords[0]) - 1], HID_TYPER_MAX_NEW_KEYS);
+    }
+    keymap_set_layout(KEYMAP_LAYOUT_US);
+    host_layout = KEYMAP_LAYOUT_US;
+    printf("\n");
+
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        size_t chars = 0, reports = 0;
+        for (size_t i = 0; i < sizeof(passwords) / sizeof(passwords[0]); i++) {
+            ok &= simulate(passwords[i], modes[m]);
+            chars += strlen(passwords[i]);
+            reports += host.reports;
+        }
+        printf("%-24s %4u %6zu %8zu %13.2f\n\n", "total", modes[m], chars, reports,
+               (double)reports / (double)chars);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,283 @@
+// HOTP code latency and flash wear of the counter log, on the host flash
+// model.
+//
+// Checks the RFC 4226 test vectors, then times taking a counter and
+// computing a code, for one busy account and for COUNTER_LOG_MAX accounts
+// used in turn. Reports page programs per code and increments per sector
+// erase, against keeping the counter as a vault record, and the device
+// time this costs at W25Q timings. A random workload then remounts after
+// every step and checks that no counter value is ever handed out twice,
+// including when a sector swap is cut short by power loss.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "counter_log.h"
+#include "flash_hal.h"
+#include "flash_hal_host.h"
+#include "totp.h"
+#include "vault.h"
+
+#define CODES 200000
+#define RANDOM_STEPS 20000
+
+// Typical W25Q16JV timings (datasheet): 0.4 ms page program, 45 ms sector erase.
+#define PAGE_PROGRAM_MS 0.4
+#define SECTOR_ERASE_MS 45.0
+
+// RFC 4226 appendix D: the ASCII secret "12345678901234567890".
+static const char rfc_secret[] = "GEZDGNBVGY3TQOJQGEZDGNBVGY3TQOJQ";
+static const char *const rfc_codes[] = {
+    "755224", "287082", "359152", "969429", "338314",
+    "254676", "287922", "162583", "399871", "520489",
+};
+
+static uint32_t rng_state = 0x9E3779B9u;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static bool test_vectors(const totp_key *key) {
+    bool ok = true;
+    char otp[TOTP_CODE_SIZE];
+    for (int i = 0; i < 10; i++) {
+        ok &= (hotp_with_key(key, (uint64_t)i, 6, otp, sizeof(otp)) == 0 &&
+               strcmp(otp, rfc_codes[i]) == 0);
+    }
+    printf("RFC 4226 test vectors: %s\n", ok ? "ok" : "FAIL");
+    return ok;
+}
+
+//--------------------------------------------------------------------+
+// Wear and latency
+//--------------------------------------------------------------------+
+typedef struct {
+    double ns;
+    double programs;        // page programs per code
+    double per_erase;       // codes per sector erase
+} wear;
+
+static void print_wear(const char *what, const wear *w) {
+    double device_ms = w->programs * PAGE_PROGRAM_MS + SECTOR_ERASE_MS / w->per_erase;
+    printf("%-26s %10.0f %12.3f %14.0f %12.3f\n", what, w->ns, w->programs, w->per_erase,
+           device_ms);
+}
+
+// Takes CODES codes from 'accounts' counters in turn; the values handed
+// out must count up from 0 for each of them.
+static bool run_log(const totp_key *key, uint16_t accounts, wear *w) {
+    flash_hal_host_reset();
+    bool ok = (counter_log_mount() == 0);
+    flash_hal_host_counters before = flash_hal_host_get_counters();
+
+    char otp[TOTP_CODE_SIZE];
+    double start = now_ns();
+    for (uint32_t i = 0; i < CODES; i++) {
+        uint64_t value;
+        uint16_t id = (uint16_t)(i % accounts);
+        if (counter_log_next(id, 0, &value) != 0 || value != i / accounts) {
+            printf("FAIL counter %u: expected %u\n", id, i / accounts);
+            return false;
+        }
+        hotp_with_key(key, value, 6, otp, sizeof(otp));
+    }
+    w->ns = (now_ns() - start) / CODES;
+
+    flash_hal_host_counters after = flash_hal_host_get_counters();
+    uint32_t erases = after.sector_erases - before.sector_erases;
+    w->programs = (double)(after.page_programs - before.page_programs) / CODES;
+    w->per_erase = erases ? (double)CODES / erases : (double)CODES;
+
+    ok &= (counter_log_mount() == 0);
+    for (uint16_t id = 0; id < accounts; id++) {
+        ok &= (counter_log_get(id) == (uint64_t)((CODES - id + accounts - 1) / accounts));
+    }
+    return ok;
+}
+
+// The same, keeping each counter as an 8-byte vault record.
+static bool run_vault(const totp_key *key, uint16_t accounts, wear *w) {
+    flash_hal_host_reset();
+    bool ok = (vault_mount() == 0);
+    flash_hal_host_counters before = flash_hal_host_get_counters();
+
+    char otp[TOTP_CODE_SIZE];
+    double start = now_ns();
+    for (uint32_t i = 0; i < CODES; i++) {
+        uint16_t id = (uint16_t)(i % accounts);
+        uint64_t value = 0;
+        size_t len;
+        const uint8_t *stored = vault_get(id, &len);
+        if (stored && len == sizeof(value)) memcpy(&value, stored, sizeof(value));
+        uint64_t next = value + 1;
+        ok &= (vault_put(id, &next, sizeof(next)) == 0);
+        hotp_with_key(key, value, 6, otp, sizeof(otp));
+    }
+    w->ns = (now_ns() - start) / CODES;
+
+    flash_hal_host_counters after = flash_hal_host_get_counters();
+    uint32_t erases = after.sector_erases - before.sector_erases;
+    w->programs = (double)(after.page_programs - before.page_programs) / CODES;
+    w->per_erase = erases ? (double)CODES / erases : (double)CODES;
+    return ok;
+}
+
+//--------------------------------------------------------------------+
+// Consistency
+//--------------------------------------------------------------------+
+
+// Random takes, floor jumps and removals over as many ids as the log holds,
+// remounting after every step: each counter must read back exactly and
+// never hand out a value below one it already gave.
+static bool test_random(void) {
+    enum { IDS = COUNTER_LOG_MAX };
+    static uint64_t model[IDS];
+    static bool present[IDS];
+    memset(model, 0, sizeof(model));
+    memset(present, 0, sizeof(present));
+
+    flash_hal_host_reset();
+    bool ok = (counter_log_mount() == 0);
+    for (uint32_t step = 0; step < RANDOM_STEPS && ok; step++) {
+        uint16_t id = (uint16_t)(rng() % IDS);
+        uint32_t op = rng() % 100;
+        if (op < 3) {
+            ok &= (counter_log_remove(id) == 0);
+            model[id] = 0;
+            present[id] = false;
+        } else {
+            uint64_t floor = op < 8 ? model[id] + rng() % 5000 : 0;
+            uint64_t expect = model[id] > floor ? model[id] : floor;
+            uint64_t value;
+            ok &= (counter_log_next(id, floor, &value) == 0 && value == expect);
+            model[id] = value + 1;
+            present[id] = true;
+        }
+
+        ok &= (counter_log_mount() == 0);
+        for (uint16_t k = 0; k < IDS; k++) {
+            if (counter_log_get(k) != (present[k] ? model[k] : 0)) {
+                printf("FAIL random step %u: counter %u\n", step, k);
+                ok = false;
+                break;
+            }
+        }
+    }
+
+    counter_log_stats stats;
+    counter_log_get_stats(&stats);
+    printf("random workload with remounts: %s (%u counters, %u sector swaps)\n",
+           ok ? "ok" : "FAIL", stats.counters, stats.generation - 1);
+    return ok;
+}
+
+// Takes codes until the next one swaps sectors, then rebuilds the flash
+// states a power cut during that swap can leave: the copy without its
+// header (the old sector must win), and both sectors complete (the new
+// one must win).
+static bool test_cut_swap(void) {
+    static uint8_t before[COUNTER_FLASH_SIZE], after[COUNTER_FLASH_SIZE];
+    uint8_t *image = flash_hal_host_counter_image();
+
+    flash_hal_host_reset();
+    bool ok = (counter_log_mount() == 0);
+    counter_log_stats stats;
+    counter_log_get_stats(&stats);
+    uint32_t gen = stats.generation;
+    uint64_t value = 0;
+    while (ok) {
+        memcpy(before, image, sizeof(before));
+        ok &= (counter_log_next(1, 0, &value) == 0);
+        ok &= (counter_log_next(2, value / 2, &value) == 0);
+        counter_log_get_stats(&stats);
+        if (stats.generation != gen) break;
+    }
+    memcpy(after, image, sizeof(after));
+    memcpy(image, before, sizeof(before));
+    ok &= (counter_log_mount() == 0);
+    uint64_t old1 = counter_log_get(1), old2 = counter_log_get(2);
+    memcpy(image, after, sizeof(after));
+    ok &= (counter_log_mount() == 0);
+    uint64_t new1 = counter_log_get(1), new2 = counter_log_get(2);
+
+    // The sector the swap wrote is the one 'before' has blank.
+    int target = before[0] == 0xFF ? 0 : 1;
+    uint8_t *new_sector = image + target * VAULT_SECTOR_SIZE;
+
+    // Cut before the header: the copied slots are there, the header is not.
+    memcpy(image, before, sizeof(before));
+    memcpy(new_sector, after + target * VAULT_SECTOR_SIZE, VAULT_SECTOR_SIZE);
+    memset(new_sector, 0xFF, 64);
+    ok &= (counter_log_mount() == 0);
+    ok &= (counter_log_get(1) == old1 && counter_log_get(2) == old2);
+    ok &= (counter_log_next(1, 0, &value) == 0 && value == old1);
+
+    // Cut before the old sector was erased: both headers are valid.
+    memcpy(image, before, sizeof(before));
+    memcpy(new_sector, after + target * VAULT_SECTOR_SIZE, VAULT_SECTOR_SIZE);
+    ok &= (counter_log_mount() == 0);
+    ok &= (counter_log_get(1) == new1 && counter_log_get(2) == new2);
+    ok &= (counter_log_next(2, 0, &value) == 0 && value == new2);
+
+    printf("power cut during a sector swap: %s\n", ok ? "ok" : "FAIL");
+    return ok;
+}
+
+// A counter follows a floor above it, ignores one below it, and starts over
+// after removal; a full log refuses new ids.
+static bool test_floor_and_remove(void) {
+    flash_hal_host_reset();
+    bool ok = (counter_log_mount() == 0);
+    uint64_t value;
+    ok &= (counter_log_next(7, 1000, &value) == 0 && value == 1000);
+    ok &= (counter_log_next(7, 5, &value) == 0 && value == 1001);
+    ok &= (counter_log_remove(7) == 0 && counter_log_get(7) == 0);
+    ok &= (counter_log_mount() == 0 && counter_log_get(7) == 0);
+    ok &= (counter_log_next(7, 0, &value) == 0 && value == 0);
+
+    for (uint16_t id = 100; id < 100 + COUNTER_LOG_MAX - 1; id++) {
+        ok &= (counter_log_next(id, 0, &value) == 0);
+    }
+    ok &= (counter_log_next(999, 0, &value) != 0);
+    ok &= (counter_log_remove(100) == 0 && counter_log_next(999, 0, &value) == 0);
+
+    printf("floor jumps, removal and a full log: %s\n", ok ? "ok" : "FAIL");
+    return ok;
+}
+
+int main(void) {
+    totp_key key;
+    bool ok = (totp_key_init(&key, rfc_secret, TOTP_SHA1) == 0);
+    ok &= test_vectors(&key);
+
+    printf("\n%-26s %10s %12s %14s %12s\n", "", "ns/code", "programs", "codes/erase",
+           "device ms");
+    wear w;
+    ok &= run_log(&key, 1, &w);
+    print_wear("counter log, 1 account", &w);
+    ok &= run_log(&key, COUNTER_LOG_MAX, &w);
+    print_wear("counter log, 32 accounts", &w);
+    ok &= run_vault(&key, 1, &w);
+    print_wear("vault record, 1 account", &w);
+    ok &= run_vault(&key, COUNTER_LOG_MAX, &w);
+    print_wear("vault record, 32 accounts", &w);
+    printf("\n");
+
+    ok &= test_random();
+    ok &= test_cut_swap();
+    ok &= test_floor_and_remove();
+    return ok ? 0 : 1;
+}
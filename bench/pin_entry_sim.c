@@ -0,0 +1,121 @@
+// Simulated button presses through the PIN entry state machine, checked
+// against the vault key as the firmware does.
+//
+// Each complete PIN is passed to vault_crypt_unlock() on the host flash
+// model, so the first PIN entered on a blank vault becomes its PIN and later
+// ones are accepted or rejected by the PBKDF2-derived check value alone.
+// Checks that a PIN is taken as fast as it is typed, that each rejected PIN
+// doubles the lockout up to PIN_ENTRY_LOCKOUT_MAX_MS, that presses during a
+// check or a lockout are dropped without starting an attempt, and that the
+// right PIN clears the backoff, including across the 32-bit millisecond
+// wrap.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "flash_hal_host.h"
+#include "pin_entry.h"
+#include "vault.h"
+#include "vault_crypt.h"
+
+static const uint8_t pin[] = {0, 6, 7, 3};
+static const uint8_t wrong[] = {0, 6, 7, 4};
+
+// What core 1 does with WORKER_CMD_UNLOCK.
+static bool check(const pin_entry_t *p) {
+    size_t len;
+    const uint8_t *digits = pin_entry_digits(p, &len);
+    bool right = digits != NULL && vault_crypt_unlock(digits, len) == 0;
+    vault_crypt_lock();
+    return right;
+}
+
+// Presses 'len' digits one millisecond apart from '*now'; a complete PIN is
+// checked and the outcome recorded. Returns the result of the last press.
+static pin_entry_result type(pin_entry_t *p, const uint8_t *digits, size_t len, uint32_t *now) {
+    pin_entry_result r = PIN_ENTRY_LOCKED;
+    for (size_t i = 0; i < len; i++) {
+        r = pin_entry_press(p, digits[i], (*now)++);
+        if (r == PIN_ENTRY_COMPLETE) {
+            // Nothing is taken while the key is being derived.
+            bool ok = (pin_entry_press(p, digits[0], *now) == PIN_ENTRY_LOCKED);
+            pin_entry_checked(p, ok && check(p), *now);
+        }
+    }
+    return r;
+}
+
+static bool test_first_pin(void) {
+    flash_hal_host_reset();
+    bool ok = (vault_mount() == 0 && !vault_crypt_configured());
+    pin_entry_t p;
+    pin_entry_init(&p, sizeof(pin));
+    uint32_t now = 0;
+    ok &= (type(&p, pin, 3, &now) == PIN_ENTRY_DIGIT);
+    ok &= (type(&p, pin + 3, 1, &now) == PIN_ENTRY_COMPLETE && pin_entry_accepted(&p));
+    ok &= (vault_crypt_configured() && pin_entry_press(&p, 1, now) == PIN_ENTRY_LOCKED);
+    printf("first PIN on a blank vault, one press per ms: %s\n", ok ? "ok" : "FAIL");
+    return ok;
+}
+
+// Needs the vault from test_first_pin().
+static bool test_backoff(uint32_t start) {
+    pin_entry_t p;
+    pin_entry_init(&p, sizeof(pin));
+    uint32_t now = start;
+    uint32_t expect = PIN_ENTRY_LOCKOUT_BASE_MS;
+    bool ok = true;
+
+    printf("lockouts from t=%u:", start);
+    for (int attempt = 0; attempt < 14 && ok; attempt++) {
+        type(&p, wrong, sizeof(wrong), &now);
+        ok &= !pin_entry_accepted(&p);
+        uint32_t left = pin_entry_lockout_left(&p, now);
+        ok &= (left == expect);
+        printf(" %u", expect / 1000);
+
+        // Presses until the last millisecond of the lockout are dropped.
+        ok &= (type(&p, pin, sizeof(pin), &now) == PIN_ENTRY_LOCKED);
+        now += left - sizeof(pin) - 1;
+        ok &= (pin_entry_press(&p, pin[0], now) == PIN_ENTRY_LOCKED);
+        now++;
+        ok &= (pin_entry_lockout_left(&p, now) == 0);
+
+        expect = expect * 2 < PIN_ENTRY_LOCKOUT_MAX_MS ? expect * 2 : PIN_ENTRY_LOCKOUT_MAX_MS;
+    }
+    printf(" s\n");
+
+    // Nothing typed during the lockouts counts towards this attempt.
+    ok &= (type(&p, pin, sizeof(pin), &now) == PIN_ENTRY_COMPLETE && pin_entry_accepted(&p) &&
+           p.failures == 0);
+    printf("exponential backoff, drops during lockout, reset on success: %s\n",
+           ok ? "ok" : "FAIL");
+    return ok;
+}
+
+// A PIN that could not be checked (no vault) is wiped without a lockout.
+static bool test_discard(void) {
+    pin_entry_t p;
+    pin_entry_init(&p, sizeof(pin));
+    uint32_t now = 0;
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(pin); i++) {
+        ok &= (pin_entry_press(&p, wrong[i], now++) != PIN_ENTRY_LOCKED);
+    }
+    size_t len;
+    pin_entry_discard(&p);
+    ok &= (pin_entry_digits(&p, &len) == NULL && p.input[3] == 0 &&
+           pin_entry_lockout_left(&p, now) == 0 && p.failures == 0);
+    ok &= (type(&p, pin, sizeof(pin), &now) == PIN_ENTRY_COMPLETE && pin_entry_accepted(&p));
+    printf("unchecked PIN discarded without a lockout: %s\n", ok ? "ok" : "FAIL");
+    return ok;
+}
+
+int main(void) {
+    bool ok = test_first_pin();
+    ok &= test_backoff(0);
+    ok &= test_backoff(UINT32_MAX - 5000);
+    ok &= test_discard();
+    return ok ? 0 : 1;
+}
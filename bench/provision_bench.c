@@ -0,0 +1,371 @@
+// Bulk-provisioning benchmark for the framed CDC protocol, on the host flash
+// model.
+//
+// A simulated host uploads a vault's worth of accounts with a sliding window
+// of PROVISION_WINDOW frames over a lossy link: some request frames are
+// corrupted and some replies dropped, so the go-back-N recovery paths run.
+// Afterwards the vault is remounted and checked record by record, then read
+// back through LIST and FIND. Reports link bytes, flash operations and an
+// estimated session time, against committing (flushing) after every record.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "account.h"
+#include "account_index.h"
+#include "crc32.h"
+#include "flash_hal.h"
+#include "flash_hal_host.h"
+#include "provision.h"
+#include "vault.h"
+#include "vault_crypt.h"
+
+#define BENCH_ACCOUNTS 1000
+
+static const uint8_t pin[] = {0, 6, 7, 3};
+
+// Sustained CDC throughput on a full-speed link, and typical W25Q16JV
+// timings (datasheet): 0.4 ms page program, 45 ms sector erase.
+#define LINK_BYTES_PER_S 500000.0
+#define PAGE_PROGRAM_MS 0.4
+#define SECTOR_ERASE_MS 45.0
+
+static uint32_t rng_state = 0x9E3779B9u;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+//--------------------------------------------------------------------+
+// Link model
+//--------------------------------------------------------------------+
+static provision_t device;
+static uint32_t corrupt_per_mille;
+static uint32_t drop_per_mille;
+static uint32_t now_ms;
+
+static uint8_t replies[64 * 1024];
+static size_t replies_len;
+static size_t bytes_to_device, bytes_to_host;
+
+static void device_write(const uint8_t *data, size_t len) {
+    bytes_to_host += len;
+    if (rng() % 1000 < drop_per_mille) return;
+    if (replies_len + len <= sizeof(replies)) {
+        memcpy(replies + replies_len, data, len);
+        replies_len += len;
+    }
+}
+
+static void transmit(const uint8_t *frame, size_t len) {
+    static uint8_t copy[PROVISION_MAX_PAYLOAD + PROVISION_FRAME_OVERHEAD];
+    memcpy(copy, frame, len);
+    if (rng() % 1000 < corrupt_per_mille) {
+        copy[2 + rng() % (len - 2)] ^= 0x10;
+    }
+    bytes_to_device += len;
+    // Delivered in USB-packet-sized pieces.
+    for (size_t off = 0; off < len; off += 64) {
+        size_t n = len - off < 64 ? len - off : 64;
+        provision_input(&device, copy + off, n, now_ms);
+    }
+}
+
+//--------------------------------------------------------------------+
+// Host side
+//--------------------------------------------------------------------+
+typedef struct {
+    uint8_t type;
+    uint8_t seq;
+    size_t len;
+    const uint8_t *payload;
+} reply;
+
+// Takes the next well-formed reply out of 'replies'.
+static bool next_reply(size_t *pos, reply *r) {
+    while (*pos + PROVISION_FRAME_OVERHEAD <= replies_len) {
+        const uint8_t *f = replies + *pos;
+        size_t len = (size_t)(f[4] | (f[5] << 8));
+        if (f[0] != PROVISION_SYNC0 || f[1] != PROVISION_SYNC1 ||
+            *pos + len + PROVISION_FRAME_OVERHEAD > replies_len) {
+            (*pos)++;
+            continue;
+        }
+        const uint8_t *c = f + 6 + len;
+        uint32_t crc = (uint32_t)c[0] | ((uint32_t)c[1] << 8) | ((uint32_t)c[2] << 16) | ((uint32_t)c[3] << 24);
+        *pos += len + PROVISION_FRAME_OVERHEAD;
+        if (crc != crc32_update(0, f + 2, 4 + len)) continue;
+        r->type = f[2];
+        r->seq = f[3];
+        r->len = len;
+        r->payload = f + 6;
+        return true;
+    }
+    return false;
+}
+
+// One request/reply exchange, resent until it gets through.
+static bool request(uint8_t type, uint8_t seq, const uint8_t *payload, size_t len, reply *r,
+                    uint8_t *reply_copy) {
+    static uint8_t frame[PROVISION_MAX_PAYLOAD + PROVISION_FRAME_OVERHEAD];
+    size_t n = provision_frame(frame, type, seq, payload, len);
+    for (int attempt = 0; attempt < 50; attempt++) {
+        replies_len = 0;
+        transmit(frame, n);
+        size_t pos = 0;
+        while (next_reply(&pos, r)) {
+            if (r->seq == seq && (r->type == PROVISION_ACK || r->type == PROVISION_DATA)) {
+                memcpy(reply_copy, r->payload, r->len);
+                r->payload = reply_copy;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static void make_account(uint16_t id, uint8_t *out, size_t *len, char *name, char *user) {
+    char pass[24];
+    account acc = {0};
+    acc.name_len = (size_t)sprintf(name, "acct-%04u", id);
+    acc.username_len = (size_t)sprintf(user, "user%04u@example.com", id);
+    acc.password_len = (size_t)sprintf(pass, "pw-%04u-%08x", id, 0xC0FFEEu * id);
+    acc.name = name;
+    acc.username = user;
+    acc.password = pass;
+    if (id % 3 == 0) {
+        // JBSWY3DPEHPK3PXP, decoded as vaultctl sends it.
+        acc.totp_seed = (const uint8_t *)"Hello!\xDE\xAD\xBE\xEF";
+        acc.totp_seed_len = 10;
+        acc.totp_digits = 6;
+        acc.totp_period = 30;
+    }
+    out[0] = (uint8_t)id;
+    out[1] = (uint8_t)(id >> 8);
+    *len = 2 + (size_t)account_encode(&acc, out + 2, PROVISION_MAX_PAYLOAD - 2);
+}
+
+typedef struct {
+    double seconds;
+    uint32_t programs;
+    uint32_t erases;
+    uint32_t frames;
+    bool ok;
+} session_result;
+
+// Uploads BENCH_ACCOUNTS accounts. With 'commit_each', every PUT is
+// followed by a COMMIT, as if each record were written on its own.
+static session_result upload(bool commit_each) {
+    static uint8_t frames[256][PROVISION_MAX_PAYLOAD + PROVISION_FRAME_OVERHEAD];
+    static size_t frame_len[256];
+    uint8_t payload[PROVISION_MAX_PAYLOAD];
+    uint8_t reply_buf[PROVISION_MAX_PAYLOAD];
+    char name[32], user[48];
+    session_result res = { .ok = true };
+
+    flash_hal_host_reset();
+    vault_mount();
+    vault_crypt_unlock(pin, sizeof(pin));
+    account_index_build();
+    provision_io io = { .write = device_write, .set_time = NULL };
+    provision_init(&device, &io);
+    bytes_to_device = bytes_to_host = 0;
+    flash_hal_host_counters before = flash_hal_host_get_counters();
+
+    reply r;
+    res.ok &= request(PROVISION_HELLO, 0, NULL, 0, &r, reply_buf);
+    res.ok &= (r.len == 8 && r.payload[1] == PROVISION_WINDOW);
+
+    // Frame n carries seq n + 1; with commit_each, odd frames are COMMITs.
+    uint32_t total = commit_each ? 2 * BENCH_ACCOUNTS : BENCH_ACCOUNTS;
+    uint32_t base = 0, next = 0;
+    while (base < total && res.ok) {
+        while (next < total && next - base < PROVISION_WINDOW) {
+            uint8_t seq = (uint8_t)(next + 1);
+            uint8_t *f = frames[seq];
+            if (commit_each && (next & 1)) {
+                frame_len[seq] = provision_frame(f, PROVISION_COMMIT, seq, NULL, 0);
+            } else {
+                size_t len;
+                make_account((uint16_t)(commit_each ? next / 2 : next), payload, &len, name, user);
+                frame_len[seq] = provision_frame(f, PROVISION_PUT, seq, payload, len);
+            }
+            replies_len = 0;
+            transmit(f, frame_len[seq]);
+            res.frames++;
+            next++;
+
+            size_t pos = 0;
+            while (next_reply(&pos, &r)) {
+                uint32_t s = base + (uint8_t)(r.seq - (uint8_t)(base + 1));
+                if (r.type == PROVISION_ACK && s < next) {
+                    res.ok &= (r.payload[0] == PROVISION_OK);
+                    base = s + 1;          // in-order handling makes ACKs cumulative
+                } else if (r.type == PROVISION_NAK) {
+                    uint32_t e = base + (uint8_t)(r.seq - (uint8_t)(base + 1));
+                    if (e <= next) next = e;   // go back and resend from the expected frame
+                }
+            }
+        }
+        if (next == total || next - base == PROVISION_WINDOW) {
+            // Replies lost: time out and resend the window.
+            next = base;
+            now_ms += 50;
+        }
+    }
+
+    if (!commit_each) {
+        res.ok &= request(PROVISION_COMMIT, (uint8_t)(total + 1), NULL, 0, &r, reply_buf);
+        res.ok &= (r.payload[0] == PROVISION_OK);
+    }
+
+    flash_hal_host_counters after = flash_hal_host_get_counters();
+    res.programs = after.page_programs - before.page_programs;
+    res.erases = after.sector_erases - before.sector_erases;
+    res.seconds = (double)(bytes_to_device + bytes_to_host) / LINK_BYTES_PER_S +
+                  (res.programs * PAGE_PROGRAM_MS + res.erases * SECTOR_ERASE_MS) / 1000.0;
+    return res;
+}
+
+// Everything uploaded must survive a reboot and read back over the link.
+static bool verify(void) {
+    bool ok = (vault_mount() == 0);
+    vault_crypt_lock();
+    ok &= (vault_crypt_unlock(pin, sizeof(pin)) == 0);
+    account_index_build();
+    ok &= (account_index_count() == BENCH_ACCOUNTS);
+
+    // Records are stored encrypted; decrypted, they must be what was sent.
+    uint8_t payload[PROVISION_MAX_PAYLOAD], plain[PROVISION_MAX_PAYLOAD];
+    char name[32], user[48];
+    for (uint16_t id = 0; id < BENCH_ACCOUNTS && ok; id++) {
+        size_t len, stored_len;
+        make_account(id, payload, &len, name, user);
+        const uint8_t *stored = vault_get(ACCOUNT_KEY_BASE + id, &stored_len);
+        int n = stored ? account_export(stored, stored_len, plain, sizeof(plain)) : -1;
+        ok &= (n == (int)len - 2 && memcmp(plain, payload + 2, (size_t)n) == 0 &&
+               memcmp(stored, payload + 2, (size_t)n) != 0);
+    }
+
+    provision_io io = { .write = device_write, .set_time = NULL };
+    provision_init(&device, &io);
+    uint8_t reply_buf[PROVISION_MAX_PAYLOAD];
+    reply r;
+    ok &= request(PROVISION_HELLO, 100, NULL, 0, &r, reply_buf);
+    ok &= ((r.payload[4] | (r.payload[5] << 8)) == BENCH_ACCOUNTS);
+
+    // Walk the whole index with LIST.
+    uint8_t seq = 101;
+    uint16_t pos = 0, listed = 0;
+    while (ok && pos < BENCH_ACCOUNTS) {
+        uint8_t req[2] = { (uint8_t)pos, (uint8_t)(pos >> 8) };
+        ok &= request(PROVISION_LIST, seq++, req, 2, &r, reply_buf);
+        size_t off = 4;
+        uint16_t got = 0;
+        while (ok && off < r.len) {
+            uint16_t id = (uint16_t)(r.payload[off] | (r.payload[off + 1] << 8));
+            size_t rec_len;
+            const uint8_t *rec = vault_get(ACCOUNT_KEY_BASE + id, &rec_len);
+            uint32_t crc = (uint32_t)r.payload[off + 2] | ((uint32_t)r.payload[off + 3] << 8) |
+                           ((uint32_t)r.payload[off + 4] << 16) | ((uint32_t)r.payload[off + 5] << 24);
+            ok &= (rec && crc == account_plain_crc(rec, rec_len));
+            off += 7 + r.payload[off + 6];
+            got++;
+        }
+        ok &= (got > 0);
+        pos += got;
+        listed += got;
+    }
+    ok &= (listed == BENCH_ACCOUNTS);
+
+    ok &= request(PROVISION_FIND, seq++, (const uint8_t *)"acct-01", 7, &r, reply_buf);
+    ok &= ((r.payload[0] | (r.payload[1] << 8)) == 100);
+
+    uint8_t get[2] = { 42, 0 };
+    ok &= request(PROVISION_GET, seq++, get, 2, &r, reply_buf);
+    account acc;
+    ok &= (account_decode(r.payload, r.len, &acc) == 0 && acc.name_len == 9 &&
+           memcmp(acc.name, "acct-0042", 9) == 0);
+    return ok;
+}
+
+// Sends a request whose ACK is lost, then resends it: the repeat must be
+// ACKed with the status the request first got.
+static bool replay_status(uint8_t seq, const uint8_t *payload, size_t len, uint8_t expect) {
+    uint8_t reply_buf[PROVISION_MAX_PAYLOAD];
+    uint8_t frame[PROVISION_MAX_PAYLOAD + PROVISION_FRAME_OVERHEAD];
+    reply r;
+    drop_per_mille = 1000;
+    transmit(frame, provision_frame(frame, PROVISION_PUT, seq, payload, len));
+    drop_per_mille = 0;
+    return request(PROVISION_PUT, seq, payload, len, &r, reply_buf) &&
+           r.type == PROVISION_ACK && r.len == 1 && r.payload[0] == expect;
+}
+
+static bool test_lost_acks(void) {
+    provision_io io = { .write = device_write, .set_time = NULL };
+    provision_init(&device, &io);
+    uint8_t reply_buf[PROVISION_MAX_PAYLOAD];
+    reply r;
+    bool ok = request(PROVISION_HELLO, 200, NULL, 0, &r, reply_buf);
+
+    uint8_t payload[PROVISION_MAX_PAYLOAD];
+    char name[32], user[48];
+    size_t len;
+    make_account(7, payload, &len, name, user);
+    ok &= replay_status(201, payload, len, PROVISION_OK);
+    ok &= replay_status(202, payload, 1, PROVISION_ERR_ARG);
+    vault_crypt_lock();
+    ok &= replay_status(203, payload, len, PROVISION_ERR_LOCKED);
+    ok &= (vault_crypt_unlock(pin, sizeof(pin)) == 0);
+
+    // A new session does not inherit the old one's statuses.
+    ok &= request(PROVISION_HELLO, 210, NULL, 0, &r, reply_buf);
+    ok &= request(PROVISION_PUT, 205, payload, len, &r, reply_buf) &&
+          r.payload[0] == PROVISION_ERR_SEQ;
+    return ok;
+}
+
+static void print_result(const char *what, const session_result *res) {
+    printf("%-22s %7u %9.2f %9.3f %7u %9.2f\n", what, res->frames,
+           (double)res->programs / BENCH_ACCOUNTS, (double)res->erases / BENCH_ACCOUNTS,
+           res->erases, res->seconds);
+}
+
+int main(void) {
+    bool ok = true;
+    printf("%u accounts, window %u, link %.0f KB/s\n\n", BENCH_ACCOUNTS, PROVISION_WINDOW,
+           LINK_BYTES_PER_S / 1000);
+    printf("%-22s %7s %9s %9s %7s %9s\n", "session", "frames", "prog/rec", "erase/rec",
+           "erases", "est. s");
+
+    corrupt_per_mille = 0;
+    drop_per_mille = 0;
+    session_result clean = upload(false);
+    print_result("batched", &clean);
+    ok &= clean.ok && verify();
+
+    corrupt_per_mille = 10;
+    drop_per_mille = 10;
+    session_result lossy = upload(false);
+    print_result("batched, 1% loss", &lossy);
+    corrupt_per_mille = 0;
+    drop_per_mille = 0;
+    ok &= lossy.ok && verify();
+
+    session_result each = upload(true);
+    print_result("commit every record", &each);
+    ok &= each.ok && verify();
+
+    bool lost_acks = test_lost_acks();
+    printf("\nlost ACKs replay status: %s\n", lost_acks ? "ok" : "FAIL");
+    ok &= lost_acks;
+
+    printf("\nprovisioning: %s\n", ok ? "ok" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,234 @@
+// Time to first keystroke for encrypted secrets, against the plaintext path.
+//
+// Runs core 1's TYPE_SECRET handling on the host: load the account, then
+// either hand the field in flash to the typer (plaintext) or decrypt its
+// first keystream block and start the typer on the partly filled buffer
+// (encrypted). 'first' is the time until the first HID report is queued;
+// 'decrypt' is the time to decrypt the whole field, which on the device
+// overlaps with typing. The typing itself is then simulated one report per
+// 1 ms frame, with one block decrypted per worker loop pass between frames,
+// and the report stream must match the plaintext one exactly.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "account.h"
+#include "account_index.h"
+#include "flash_hal_host.h"
+#include "hid_typer.h"
+#include "keymap.h"
+#include "vault.h"
+#include "vault_crypt.h"
+
+#define ITERATIONS 20000
+
+static const uint8_t pin[] = {0, 6, 7, 3};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+//--------------------------------------------------------------------+
+// Report capture
+//--------------------------------------------------------------------+
+static struct {
+    bool pending;
+    size_t count;
+    uint32_t hash;      // FNV-1a over every report sent
+} reports;
+
+static bool capture_send(uint8_t modifier, const uint8_t keycode[6]) {
+    if (reports.pending) return false;
+    reports.pending = true;
+    reports.count++;
+    reports.hash = (reports.hash ^ modifier) * 16777619u;
+    for (int i = 0; i < 6; i++) {
+        reports.hash = (reports.hash ^ keycode[i]) * 16777619u;
+    }
+    return true;
+}
+
+static void capture_reset(void) {
+    reports.pending = false;
+    reports.count = 0;
+    reports.hash = 2166136261u;
+}
+
+//--------------------------------------------------------------------+
+// Core 1 model (see type_secret() and reveal_step() in worker.c)
+//--------------------------------------------------------------------+
+static struct {
+    account acc;
+    const char *field;
+    size_t len;
+    volatile size_t ready;
+    char text[VAULT_MAX_VALUE];
+} reveal;
+
+static bool reveal_step(void) {
+    size_t pos = reveal.ready;
+    if (pos >= reveal.len) return false;
+
+    size_t offset = (size_t)((const uint8_t *)reveal.field - reveal.acc.record) + pos;
+    size_t n = CHACHA20_BLOCK_SIZE - offset % CHACHA20_BLOCK_SIZE;
+    if (n > reveal.len - pos) n = reveal.len - pos;
+    account_read(&reveal.acc, reveal.field, pos, n, reveal.text + pos);
+    reveal.ready = pos + n;
+    return reveal.ready < reveal.len;
+}
+
+// Returns true if typing started.
+static bool type_secret(hid_typer_t *typer, uint16_t id) {
+    if (account_load(id, &reveal.acc) != 0 || reveal.acc.password_len == 0) return false;
+    if (reveal.acc.nonce == NULL) {
+        return hid_typer_start(typer, reveal.acc.password, reveal.acc.password_len);
+    }
+    reveal.field = reveal.acc.password;
+    reveal.len = reveal.acc.password_len;
+    reveal.ready = 0;
+    reveal_step();
+    return hid_typer_start_stream(typer, reveal.text, reveal.len, &reveal.ready);
+}
+
+//--------------------------------------------------------------------+
+// Measurements
+//--------------------------------------------------------------------+
+static double time_first_key(uint16_t id) {
+    hid_typer_t typer;
+    hid_typer_init(&typer, capture_send, keymap_lookup);
+    uint64_t start = now_ns();
+    for (int i = 0; i < ITERATIONS; i++) {
+        capture_reset();
+        hid_typer_reset(&typer);
+        type_secret(&typer, id);
+    }
+    return (double)(now_ns() - start) / ITERATIONS;
+}
+
+static double time_decrypt_all(uint16_t id) {
+    uint64_t start = now_ns();
+    for (int i = 0; i < ITERATIONS; i++) {
+        account_load(id, &reveal.acc);
+        reveal.field = reveal.acc.password;
+        reveal.len = reveal.acc.password_len;
+        reveal.ready = 0;
+        while (reveal_step()) {
+        }
+    }
+    return (double)(now_ns() - start) / ITERATIONS;
+}
+
+// Types the whole secret; returns the number of 1 ms frames it took.
+static uint32_t simulate_typing(uint16_t id) {
+    hid_typer_t typer;
+    hid_typer_init(&typer, capture_send, keymap_lookup);
+    capture_reset();
+    memset(reveal.text, 0, sizeof(reveal.text));
+    type_secret(&typer, id);
+
+    uint32_t frames = 0;
+    while (hid_typer_busy(&typer)) {
+        frames++;
+        if (reports.pending) {
+            reports.pending = false;
+            hid_typer_report_complete(&typer);
+        }
+        // Core 1 gets one pass of its loop per core 0 pass.
+        reveal_step();
+        hid_typer_task(&typer);
+    }
+    return frames;
+}
+
+int main(void) {
+    static const size_t sizes[] = {12, 32, 64, 200, 1000, 4000};
+    char password[4001];
+    char name[16];
+    bool ok = true;
+
+    flash_hal_host_reset();
+    vault_mount();
+    account_index_build();
+
+    // Account 2n holds a plaintext password (stored while locked), 2n+1 the
+    // same password encrypted.
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        for (size_t j = 0; j < sizes[i]; j++) {
+            password[j] = (char)('a' + (j * 7 + i) % 26);
+        }
+        for (int enc = 0; enc < 2; enc++) {
+            if (enc) {
+                ok &= (vault_crypt_unlock(pin, sizeof(pin)) == 0);
+            } else {
+                vault_crypt_lock();
+            }
+            account acc = {0};
+            acc.name_len = (size_t)sprintf(name, "acct%zu%c", i, enc ? 'e' : 'p');
+            acc.name = name;
+            acc.password = password;
+            acc.password_len = sizes[i];
+            ok &= (account_store((uint16_t)(2 * i + enc), &acc) == 0);
+        }
+    }
+
+    // Only the unlocked copies carry a nonce.
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        account acc;
+        ok &= (account_load((uint16_t)(2 * i + 1), &acc) == 0 && acc.nonce != NULL);
+    }
+
+    printf("%6s %12s %12s %12s %10s %10s %8s\n", "length", "plain first", "enc first",
+           "enc decrypt", "reports", "frames", "typing");
+    printf("%6s %12s %12s %12s %10s %10s %8s\n", "", "ns", "ns", "ns", "", "", "");
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        uint16_t plain_id = (uint16_t)(2 * i), enc_id = (uint16_t)(2 * i + 1);
+        double plain_first = time_first_key(plain_id);
+        double enc_first = time_first_key(enc_id);
+        double enc_all = time_decrypt_all(enc_id);
+
+        uint32_t plain_frames = simulate_typing(plain_id);
+        size_t plain_reports = reports.count;
+        uint32_t plain_hash = reports.hash;
+        uint32_t enc_frames = simulate_typing(enc_id);
+        bool same = reports.count == plain_reports && reports.hash == plain_hash &&
+                    enc_frames == plain_frames;
+        ok &= same;
+
+        printf("%6zu %12.0f %12.0f %12.0f %10zu %10u %8s\n", sizes[i], plain_first, enc_first,
+               enc_all, plain_reports, enc_frames, same ? "same" : "DIFFERS");
+    }
+
+    // Encrypting existing plaintext accounts leaves no plaintext behind.
+    ok &= (vault_crypt_unlock(pin, sizeof(pin)) == 0);
+    int encrypted = account_encrypt_all();
+    ok &= (encrypted == (int)(sizeof(sizes) / sizeof(sizes[0])));
+    const uint8_t *image = flash_hal_host_image();
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        for (size_t j = 0; j < sizes[i]; j++) {
+            password[j] = (char)('a' + (j * 7 + i) % 26);
+        }
+        size_t probe = sizes[i] < 32 ? sizes[i] : 32;
+        for (size_t off = 0; off + probe <= VAULT_FLASH_SIZE; off++) {
+            if (memcmp(image + off, password, probe) == 0) {
+                printf("plaintext of account %zu found at flash offset %zu\n", 2 * i, off);
+                ok = false;
+                break;
+            }
+        }
+    }
+
+    // A wrong PIN is refused; the right one still opens the vault.
+    vault_crypt_lock();
+    static const uint8_t wrong[] = {0, 6, 7, 4};
+    ok &= (vault_crypt_unlock(wrong, sizeof(wrong)) != 0 && !vault_crypt_unlocked());
+    ok &= (vault_crypt_unlock(pin, sizeof(pin)) == 0);
+
+    printf("\nencryption at rest: %s (%d accounts encrypted in place)\n", ok ? "ok" : "FAIL",
+           encrypted);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,414 @@
+// Endurance benchmark for the log-structured vault, on the host flash model.
+//
+// Checks migration from the old one-sector-per-slot layout into accounts,
+// recovery from a torn record and from a torn sector erase, how many
+// accounts fit in the region, name lookups through the account index
+// against a linear scan, and that
+// a long random update/delete workload always reads back what was written,
+// including across remounts. Reports flash operations per update and the
+// per-sector erase spread. The old layout erased one
+// sector per update, always the same one for a given slot.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "account.h"
+#include "account_index.h"
+#include "flash_hal.h"
+#include "flash_hal_host.h"
+#include "vault.h"
+
+#define BENCH_KEYS 16
+#define BENCH_UPDATES 200000
+#define BENCH_VALUE_MAX 128
+
+// Typical W25Q16JV timings (datasheet): 0.4 ms page program, 45 ms sector erase.
+#define PAGE_PROGRAM_MS 0.4
+#define SECTOR_ERASE_MS 45.0
+
+static uint32_t rng_state = 0x12345678u;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static struct {
+    bool present;
+    size_t len;
+    uint8_t data[BENCH_VALUE_MAX];
+} model[BENCH_KEYS];
+
+static bool check(const char *what, uint16_t key, const void *expect, size_t expect_len) {
+    size_t len = 0;
+    const uint8_t *value = vault_get(key, &len);
+    bool ok = expect ? (value && len == expect_len && memcmp(value, expect, len) == 0)
+                     : (value == NULL);
+    if (!ok) {
+        printf("FAIL %s: key %u\n", what, key);
+    }
+    return ok;
+}
+
+static bool check_model(const char *what) {
+    bool ok = true;
+    for (uint16_t k = 0; k < BENCH_KEYS; k++) {
+        ok &= check(what, k, model[k].present ? model[k].data : NULL, model[k].len);
+    }
+    return ok;
+}
+
+// Old layout: the string for user u, field p lives at sector 2*(u-1)+p.
+static bool test_migration(void) {
+    flash_hal_host_reset();
+    uint8_t *image = flash_hal_host_image();
+    strcpy((char *)image + 0 * VAULT_SECTOR_SIZE, "alice");
+    strcpy((char *)image + 1 * VAULT_SECTOR_SIZE, "hunter2");
+    image[3 * VAULT_SECTOR_SIZE] = 'x';   // the old 1-byte program
+
+    bool ok = (vault_mount() == 0);
+    vault_stats st;
+    vault_get_stats(&st);
+    ok &= (st.migrated == 3);
+    ok &= check("migration", 0, "alice", 5);
+    ok &= check("migration", 1, "hunter2", 7);
+    ok &= check("migration", 2, NULL, 0);
+    ok &= check("migration", 3, "x", 1);
+
+    // Users 1 and 2 become accounts 0 and 1.
+    ok &= (account_migrate_legacy() == 2);
+    account acc;
+    ok &= (account_load(0, &acc) == 0);
+    ok &= (acc.username_len == 5 && memcmp(acc.username, "alice", 5) == 0);
+    ok &= (acc.password_len == 7 && memcmp(acc.password, "hunter2", 7) == 0);
+    ok &= (account_load(1, &acc) == 0);
+    ok &= (acc.username_len == 0 && acc.password_len == 1 && acc.password[0] == 'x');
+    ok &= check("migration", 0, NULL, 0);
+
+    // Nothing left to import on the next boot.
+    ok &= (vault_mount() == 0);
+    vault_get_stats(&st);
+    ok &= (st.migrated == 0 && st.keys == 2);
+    ok &= (account_migrate_legacy() == 0);
+    ok &= (account_load(0, &acc) == 0 && acc.password_len == 7);
+    printf("migration: %s\n", ok ? "ok" : "FAIL");
+    return ok;
+}
+
+// A sector below the old layout's slots that was never opened (its header
+// sequence number, the third word, is still erased).
+static int free_legacy_slot(void) {
+    const uint8_t *image = flash_hal_host_image();
+    static const uint8_t unopened[4] = {0xFF, 0xFF, 0xFF, 0xFF};
+    for (int s = 0; s < 100; s++) {
+        if (memcmp(image + s * VAULT_SECTOR_SIZE + 8, unopened, 4) == 0) return s;
+    }
+    return -1;
+}
+
+// Once the vault has stored anything, a sector that is neither formatted nor
+// erased is one whose erase was cut short and must not be imported; an
+// import cut short by power loss must still resume.
+static bool test_torn_erase(void) {
+    flash_hal_host_reset();
+    uint8_t *image = flash_hal_host_image();
+    bool ok = (vault_mount() == 0);
+    ok &= (vault_put(200, "kept", 4) == 0);
+    int s = free_legacy_slot();
+    ok &= (s >= 0);
+
+    // Half erased: some bytes still programmed, no valid header.
+    memset(image + s * VAULT_SECTOR_SIZE, 0xFF, VAULT_SECTOR_SIZE);
+    memcpy(image + s * VAULT_SECTOR_SIZE, "\x12\x34garbage", 9);
+    ok &= (vault_mount() == 0);
+    vault_stats st;
+    vault_get_stats(&st);
+    ok &= (st.migrated == 0 && st.keys == 1);
+    ok &= check("torn erase", (uint16_t)s, NULL, 0);
+    ok &= check("torn erase", 200, "kept", 4);
+    ok &= (account_migrate_legacy() == 0);
+    ok &= (image[s * VAULT_SECTOR_SIZE] != 0x12);
+
+    // An import the marker says is unfinished picks up the rest.
+    flash_hal_host_reset();
+    ok &= (vault_mount() == 0);
+    ok &= (vault_put(VAULT_LEGACY_KEYS - 2, "\x01", 1) == 0);
+    s = free_legacy_slot();
+    memset(image + s * VAULT_SECTOR_SIZE, 0xFF, VAULT_SECTOR_SIZE);
+    strcpy((char *)image + s * VAULT_SECTOR_SIZE, "carol");
+    ok &= (vault_mount() == 0);
+    vault_get_stats(&st);
+    ok &= (st.migrated == 1);
+    ok &= check("resumed import", (uint16_t)s, "carol", 5);
+    ok &= check("resumed import", VAULT_LEGACY_KEYS - 2, NULL, 0);
+    ok &= (vault_mount() == 0);
+    vault_get_stats(&st);
+    ok &= (st.migrated == 0);
+    printf("torn erase, resumed import: %s\n", ok ? "ok" : "FAIL");
+    return ok;
+}
+
+// A record torn by power loss must be ignored, exposing the previous value.
+static bool test_torn_record(void) {
+    flash_hal_host_reset();
+    bool ok = (vault_mount() == 0);
+    ok &= (vault_put(5, "old", 3) == 0);
+    ok &= (vault_put(5, "new", 3) == 0);
+
+    size_t len;
+    const uint8_t *value = vault_get(5, &len);
+    uint8_t *image = flash_hal_host_image();
+    image[value - flash_hal_base()] &= 0x0F;   // bits that never got programmed
+
+    ok &= (vault_mount() == 0);
+    ok &= check("torn", 5, "old", 3);
+    ok &= (vault_put(5, "newer", 5) == 0);
+    ok &= (vault_mount() == 0);
+    ok &= check("torn", 5, "newer", 5);
+    printf("torn record: %s\n", ok ? "ok" : "FAIL");
+    return ok;
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+// Linear scan for comparison with the index.
+static int find_linear(const char *name, size_t len) {
+    for (uint16_t id = 0; id < ACCOUNT_MAX; id++) {
+        account acc;
+        if (account_load(id, &acc) == 0 && acc.name_len == len &&
+            memcmp(acc.name, name, len) == 0) {
+            return id;
+        }
+    }
+    return -1;
+}
+
+static bool test_index(uint16_t stored) {
+    bool ok = true;
+    account_index_build();
+    ok &= (account_index_count() == stored);
+
+    // Sorted by name.
+    account prev = {0}, cur;
+    for (size_t pos = 0; pos < account_index_count() && ok; pos++) {
+        ok &= (account_load(account_index_at(pos), &cur) == 0);
+        if (pos > 0) {
+            size_t n = prev.name_len < cur.name_len ? prev.name_len : cur.name_len;
+            int c = memcmp(prev.name, cur.name, n);
+            ok &= (c < 0 || (c == 0 && prev.name_len <= cur.name_len));
+        }
+        prev = cur;
+    }
+
+    size_t first;
+    ok &= (account_index_find("site-0042.example", 17) == 42);
+    ok &= (account_index_find("site-0042", 9) == -1);
+    ok &= (account_index_find("zzz", 3) == -1);
+    ok &= (account_index_prefix("site-01", 7, &first) == 100);
+    ok &= (account_index_at(first) == 100);
+    ok &= (account_index_prefix("site-0042", 9, &first) == 1);
+    ok &= (account_index_prefix("s", 1, &first) == stored && first == 0);
+    ok &= (account_index_prefix("", 0, &first) == stored);
+    ok &= (account_index_prefix("x", 1, &first) == 0);
+
+    // Incremental updates: rename, then remove.
+    ok &= (account_load(7, &cur) == 0);
+    cur.name = "aaa";
+    cur.name_len = 3;
+    ok &= (account_store(7, &cur) == 0);
+    ok &= (account_index_find("aaa", 3) == 7 && account_index_at(0) == 7);
+    ok &= (account_index_find("site-0007.example", 17) == -1);
+    ok &= (account_index_count() == stored);
+    ok &= (account_remove(7) == 0);
+    ok &= (account_index_find("aaa", 3) == -1);
+    ok &= (account_index_count() == stored - 1u);
+
+    const int lookups = 2000;
+    char name[32];
+    int found = 0;
+    double t0 = now_ns();
+    for (int i = 0; i < lookups; i++) {
+        size_t len = (size_t)snprintf(name, sizeof(name), "site-%04u.example", (unsigned)(rng() % stored));
+        found += account_index_find(name, len) >= 0;
+    }
+    double index_ns = (now_ns() - t0) / lookups;
+    t0 = now_ns();
+    for (int i = 0; i < lookups / 20; i++) {
+        size_t len = (size_t)snprintf(name, sizeof(name), "site-%04u.example", (unsigned)(rng() % stored));
+        found += find_linear(name, len) >= 0;
+    }
+    double linear_ns = (now_ns() - t0) / (lookups / 20);
+    ok &= (found > 0);
+
+    printf("%-28s %12.0f\n", "index lookup ns", index_ns);
+    printf("%-28s %12.0f\n", "linear scan ns", linear_ns);
+    printf("%-28s %12zu\n", "index RAM bytes",
+           (size_t)ACCOUNT_MAX * (sizeof(uint32_t) + sizeof(uint16_t)));
+    printf("index: %s\n", ok ? "ok" : "FAIL");
+    return ok;
+}
+
+// Records holding Base32 TOTP text are re-stored with the decoded seed, once;
+// text that is not Base32 is left alone, and refused as new input.
+static bool test_seed_migration(void) {
+    flash_hal_host_reset();
+    bool ok = (vault_mount() == 0);
+
+    static const char *const secrets[] = { "JBSWY3DPEHPK3PXP", "not base32!" };
+    uint8_t record[64];
+    for (uint16_t id = 0; id < 2; id++) {
+        account acc = {0};
+        acc.name = id ? "bad" : "good";
+        acc.name_len = strlen(acc.name);
+        acc.totp_secret = secrets[id];
+        acc.totp_secret_len = strlen(secrets[id]);
+        acc.totp_digits = 6;
+        int len = account_encode(&acc, record, sizeof(record));
+        ok &= (len > 0 && vault_put(ACCOUNT_KEY_BASE + id, record, (size_t)len) == 0);
+    }
+    account_index_build();
+
+    ok &= (account_migrate_seeds() == 1);
+    ok &= (account_migrate_seeds() == 0);
+    account acc;
+    ok &= (account_load(0, &acc) == 0 && acc.totp_secret_len == 0 && acc.totp_seed_len == 10 &&
+           memcmp(acc.totp_seed, "Hello!\xDE\xAD\xBE\xEF", 10) == 0 && acc.totp_digits == 6);
+    ok &= (account_load(1, &acc) == 0 && acc.totp_secret_len == strlen(secrets[1]));
+
+    acc.totp_secret = "0189";
+    acc.totp_secret_len = 4;
+    ok &= (account_store(2, &acc) != 0);
+    printf("TOTP seed migration: %s\n", ok ? "ok" : "FAIL");
+    return ok;
+}
+
+// Fills the vault with realistic accounts and reads them back.
+static bool test_capacity(void) {
+    flash_hal_host_reset();
+    bool ok = (vault_mount() == 0);
+
+    char name[32], user[48], pass[24];
+    uint16_t stored = 0;
+    for (uint16_t id = 0; id < ACCOUNT_MAX && ok; id++) {
+        account acc = {0};
+        acc.name_len = (size_t)snprintf(name, sizeof(name), "site-%04u.example", id);
+        acc.username_len = (size_t)snprintf(user, sizeof(user), "user%04u@example.com", id);
+        acc.password_len = (size_t)snprintf(pass, sizeof(pass), "pw-%08x%04u", rng(), id);
+        acc.name = name;
+        acc.username = user;
+        acc.password = pass;
+        if (id % 4 == 0) {
+            acc.totp_secret = "JBSWY3DPEHPK3PXPJBSWY3DPEHPK3PXP";
+            acc.totp_secret_len = 32;
+            acc.totp_digits = 6;
+            acc.totp_period = 30;
+        }
+        ok &= (account_store(id, &acc) == 0);
+        stored += ok;
+    }
+
+    ok &= (vault_mount() == 0);
+    for (uint16_t id = 0; id < stored && ok; id += 97) {
+        account acc;
+        snprintf(user, sizeof(user), "user%04u@example.com", id);
+        ok &= (account_load(id, &acc) == 0);
+        ok &= (acc.username_len == strlen(user) && memcmp(acc.username, user, acc.username_len) == 0);
+        ok &= (acc.totp_digits == (id % 4 == 0 ? 6 : 0));
+        ok &= (acc.totp_secret_len == 0 && acc.totp_seed_len == (id % 4 == 0 ? 20u : 0u));
+    }
+
+    vault_stats st;
+    vault_get_stats(&st);
+    uint32_t sectors_used = st.sectors - st.free_sectors;
+    printf("\n%-28s %12u\n", "accounts", stored);
+    printf("%-28s %12.1f\n", "bytes/account", (double)st.live_bytes / stored);
+    printf("%-28s %12u of %u\n", "sectors used", sectors_used, st.sectors);
+    printf("%-28s %12.1f\n", "accounts/sector", (double)stored / sectors_used);
+    printf("%-28s %12.0f\n", "region capacity (accounts)",
+           (double)st.sectors * VAULT_SECTOR_SIZE * stored / st.live_bytes);
+    printf("capacity: %s\n", ok ? "ok" : "FAIL");
+    return test_index(stored) && ok;
+}
+
+static bool test_endurance(void) {
+    flash_hal_host_reset();
+    memset(model, 0, sizeof(model));
+    bool ok = (vault_mount() == 0);
+
+    // A few values that are written once and never change, so static wear
+    // leveling has something to move.
+    for (uint16_t k = BENCH_KEYS; k < BENCH_KEYS + 4; k++) {
+        ok &= (vault_put(k, "static", 6) == 0);
+    }
+
+    flash_hal_host_counters before = flash_hal_host_get_counters();
+    double t0 = now_ns();
+    for (uint32_t i = 1; i <= BENCH_UPDATES && ok; i++) {
+        uint16_t key = (uint16_t)(rng() % BENCH_KEYS);
+        if (rng() % 8 == 0) {
+            ok &= (vault_delete(key) == 0);
+            model[key].present = false;
+            model[key].len = 0;
+        } else {
+            size_t len = 8 + rng() % (BENCH_VALUE_MAX - 8);
+            for (size_t j = 0; j < len; j++) {
+                model[key].data[j] = (uint8_t)rng();
+            }
+            model[key].len = len;
+            model[key].present = true;
+            ok &= (vault_put(key, model[key].data, len) == 0);
+        }
+        if (i % 20000 == 0) {
+            ok &= check_model("endurance");
+        }
+    }
+    double ns = now_ns() - t0;
+    flash_hal_host_counters after = flash_hal_host_get_counters();
+
+    ok &= (vault_mount() == 0);
+    ok &= check_model("endurance remount");
+    for (uint16_t k = BENCH_KEYS; k < BENCH_KEYS + 4; k++) {
+        ok &= check("static", k, "static", 6);
+    }
+
+    vault_stats st;
+    vault_get_stats(&st);
+    double programs = (double)(after.page_programs - before.page_programs) / BENCH_UPDATES;
+    double erases = (double)(after.sector_erases - before.sector_erases) / BENCH_UPDATES;
+
+    printf("\n%-28s %12s %12s\n", "", "vault", "old layout");
+    printf("%-28s %12u %12u\n", "updates", BENCH_UPDATES, BENCH_UPDATES);
+    printf("%-28s %12.3f %12.3f\n", "page programs/update", programs, 1.0);
+    printf("%-28s %12.4f %12.4f\n", "sector erases/update", erases, 1.0);
+    printf("%-28s %12.2f %12.2f\n", "est. flash ms/update",
+           programs * PAGE_PROGRAM_MS + erases * SECTOR_ERASE_MS,
+           PAGE_PROGRAM_MS + SECTOR_ERASE_MS);
+    printf("%-28s %12u %12u\n", "max erases of one sector", st.erase_max,
+           BENCH_UPDATES / BENCH_KEYS);
+    printf("%-28s %12u\n", "min erases of one sector", st.erase_min);
+    printf("%-28s %12u\n", "sectors", st.sectors);
+    printf("%-28s %12u\n", "gc runs (since remount)", st.gc_runs);
+    printf("%-28s %12.0f\n", "host ns/update", ns / BENCH_UPDATES);
+    printf("endurance: %s\n", ok ? "ok" : "FAIL");
+    return ok;
+}
+
+int main(void) {
+    bool ok = true;
+    ok &= test_migration();
+    ok &= test_torn_record();
+    ok &= test_torn_erase();
+    ok &= test_seed_migration();
+    ok &= test_capacity();
+    ok &= test_endurance();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,68 @@
+#include "buttons.h"
+
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+#include "hardware/sync.h"
+#include "spsc_queue.h"
+#include "buttons.pio.h"
+
+// States read from the PIO, oldest first. The interrupt handler pushes and
+// buttons_poll() pops, so no locking is needed.
+#define BUTTONS_QUEUE_LEN 16
+
+typedef struct {
+  uint32_t state;
+  uint32_t edge_us;
+} button_state;
+
+// The scanner takes one state machine and 16 instructions of PIO 0.
+#define BUTTONS_PIO pio0
+#define BUTTONS_PIO_IRQ PIO0_IRQ_0
+
+static uint sm;
+static spsc_queue_t queue;
+static button_state queue_storage[BUTTONS_QUEUE_LEN];
+
+static uint32_t reported;   // last state handed out
+static uint32_t chord;      // buttons held since none were
+
+static void buttons_irq(void) {
+  while (!pio_sm_is_rx_fifo_empty(BUTTONS_PIO, sm)) {
+    // The state was stable for the settle time before the PIO pushed it.
+    button_state s = { .state = pio_sm_get(BUTTONS_PIO, sm) & ((1u << BUTTONS_COUNT) - 1),
+                       .edge_us = time_us_32() - BUTTONS_SETTLE_US };
+    spsc_queue_try_push(&queue, &s);   // a full queue drops the newest
+  }
+  __sev();
+}
+
+void buttons_init(uint first_pin) {
+  spsc_queue_init(&queue, queue_storage, sizeof(button_state), BUTTONS_QUEUE_LEN);
+  reported = (gpio_get_all() >> first_pin) & ((1u << BUTTONS_COUNT) - 1);
+  chord = reported;
+
+  sm = (uint)pio_claim_unused_sm(BUTTONS_PIO, true);
+  uint offset = pio_add_program(BUTTONS_PIO, &buttons_program);
+  buttons_pio_init(BUTTONS_PIO, sm, offset, first_pin, BUTTONS_SETTLE_US);
+
+  pio_set_irq0_source_enabled(BUTTONS_PIO,
+                              (enum pio_interrupt_source)(pis_sm0_rx_fifo_not_empty + sm), true);
+  irq_set_exclusive_handler(BUTTONS_PIO_IRQ, buttons_irq);
+  irq_set_enabled(BUTTONS_PIO_IRQ, true);
+}
+
+bool buttons_poll(buttons_event *evt) {
+  button_state s;
+  while (spsc_queue_try_pop(&queue, &s)) {
+    if (s.state == reported) continue;   // bounced back
+    reported = s.state;
+    chord |= s.state;
+
+    evt->pressed = s.state;
+    evt->chord = s.state == 0 ? chord : 0;
+    evt->edge_us = s.edge_us;
+    if (s.state == 0) chord = 0;
+    return true;
+  }
+  return false;
+}
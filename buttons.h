@@ -0,0 +1,40 @@
+#ifndef BUTTONS_H
+#define BUTTONS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pico/stdlib.h"
+
+// Debounced input from eight buttons on consecutive GPIOs. A PIO state
+// machine (buttons.pio) samples the pins and pushes each state that has been
+// stable for BUTTONS_SETTLE_US; its FIFO interrupt timestamps the states into
+// a queue and wakes the core with __sev(). The CPU never polls the pins, so
+// the main loop can sleep in __wfe() until something happens.
+//
+// Buttons are active high. Only the core that called buttons_init() may use
+// the rest of the API.
+
+#define BUTTONS_COUNT 8
+
+// How long the pins must be stable before a change is reported.
+#ifndef BUTTONS_SETTLE_US
+#define BUTTONS_SETTLE_US 5000
+#endif
+
+// A change to the set of pressed buttons.
+typedef struct {
+  uint32_t pressed;   // buttons now held, bit 0 for the first pin
+  uint32_t chord;     // when the last one is released: every button held
+                      // since none were, otherwise 0
+  uint32_t edge_us;   // time_us_32() of the last edge before the change
+} buttons_event;
+
+// Starts scanning the BUTTONS_COUNT pins from 'first_pin', which must
+// already be inputs, and enables the FIFO interrupt on the calling core.
+void buttons_init(uint first_pin);
+
+// Returns true and fills 'evt' with the oldest change not yet handed out.
+bool buttons_poll(buttons_event *evt);
+
+#endif // BUTTONS_H
@@ -0,0 +1,93 @@
+#include "chacha20.h"
+
+#include <string.h>
+
+#if defined(PICO_ON_DEVICE) && PICO_ON_DEVICE
+#include "pico.h"
+#define CHACHA20_KERNEL_ATTR(name) __not_in_flash_func(name)
+#else
+#define CHACHA20_KERNEL_ATTR(name) name
+#endif
+
+static inline uint32_t rotl32(uint32_t v, unsigned int n) {
+    return (v << n) | (v >> (32 - n));
+}
+
+static inline uint32_t load_le32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void store_le32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+#define QUARTER_ROUND(a, b, c, d)                         \
+    do {                                                  \
+        x[a] += x[b]; x[d] = rotl32(x[d] ^ x[a], 16);     \
+        x[c] += x[d]; x[b] = rotl32(x[b] ^ x[c], 12);     \
+        x[a] += x[b]; x[d] = rotl32(x[d] ^ x[a], 8);      \
+        x[c] += x[d]; x[b] = rotl32(x[b] ^ x[c], 7);      \
+    } while (0)
+
+void chacha20_init(chacha20_ctx *ctx, const uint8_t key[CHACHA20_KEY_SIZE],
+                   const uint8_t nonce[CHACHA20_NONCE_SIZE]) {
+    // "expand 32-byte k"
+    ctx->input[0] = 0x61707865;
+    ctx->input[1] = 0x3320646e;
+    ctx->input[2] = 0x79622d32;
+    ctx->input[3] = 0x6b206574;
+    for (int i = 0; i < 8; i++) {
+        ctx->input[4 + i] = load_le32(key + 4 * i);
+    }
+    ctx->input[12] = 0;
+    for (int i = 0; i < 3; i++) {
+        ctx->input[13 + i] = load_le32(nonce + 4 * i);
+    }
+}
+
+void CHACHA20_KERNEL_ATTR(chacha20_block)(const chacha20_ctx *ctx, uint32_t counter,
+                                          uint8_t out[CHACHA20_BLOCK_SIZE]) {
+    uint32_t x[16];
+    memcpy(x, ctx->input, sizeof(x));
+    x[12] = counter;
+
+    for (int i = 0; i < 10; i++) {
+        QUARTER_ROUND(0, 4, 8, 12);
+        QUARTER_ROUND(1, 5, 9, 13);
+        QUARTER_ROUND(2, 6, 10, 14);
+        QUARTER_ROUND(3, 7, 11, 15);
+        QUARTER_ROUND(0, 5, 10, 15);
+        QUARTER_ROUND(1, 6, 11, 12);
+        QUARTER_ROUND(2, 7, 8, 13);
+        QUARTER_ROUND(3, 4, 9, 14);
+    }
+
+    for (int i = 0; i < 16; i++) {
+        uint32_t in = (i == 12) ? counter : ctx->input[i];
+        store_le32(out + 4 * i, x[i] + in);
+    }
+}
+
+void chacha20_xor(const chacha20_ctx *ctx, uint32_t offset, const uint8_t *in, uint8_t *out,
+                  size_t len) {
+    uint8_t ks[CHACHA20_BLOCK_SIZE];
+
+    while (len > 0) {
+        uint32_t skip = offset % CHACHA20_BLOCK_SIZE;
+        size_t n = CHACHA20_BLOCK_SIZE - skip;
+        if (n > len) n = len;
+
+        chacha20_block(ctx, offset / CHACHA20_BLOCK_SIZE, ks);
+        for (size_t i = 0; i < n; i++) {
+            out[i] = in[i] ^ ks[skip + i];
+        }
+        in += n;
+        out += n;
+        offset += (uint32_t)n;
+        len -= n;
+    }
+    memset(ks, 0, sizeof(ks));
+}
@@ -0,0 +1,32 @@
+#ifndef CHACHA20_H
+#define CHACHA20_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ChaCha20 stream cipher (RFC 8439): 256-bit key, 96-bit nonce, 32-bit block
+// counter. Encryption and decryption are the same XOR with the keystream.
+
+#define CHACHA20_KEY_SIZE 32
+#define CHACHA20_NONCE_SIZE 12
+#define CHACHA20_BLOCK_SIZE 64
+
+// Key and nonce loaded into the cipher's input words.
+typedef struct {
+    uint32_t input[16];
+} chacha20_ctx;
+
+void chacha20_init(chacha20_ctx *ctx, const uint8_t key[CHACHA20_KEY_SIZE],
+                   const uint8_t nonce[CHACHA20_NONCE_SIZE]);
+
+// Writes keystream block 'counter' to 'out'.
+void chacha20_block(const chacha20_ctx *ctx, uint32_t counter, uint8_t out[CHACHA20_BLOCK_SIZE]);
+
+// XORs 'len' bytes of 'in' with the keystream starting at byte 'offset' of
+// block 0 and writes them to 'out' (which may equal 'in'). Any offset works,
+// so a stream can be processed in pieces of any size; pieces that end on a
+// block boundary cost one block each.
+void chacha20_xor(const chacha20_ctx *ctx, uint32_t offset, const uint8_t *in, uint8_t *out,
+                  size_t len);
+
+#endif // CHACHA20_H
@@ -0,0 +1,307 @@
+#include "counter_log.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "crc32.h"
+
+#define COUNTER_SECTOR_MAGIC 0x52544E43u  // "CNTR"
+
+#define SLOT_SIZE 64u
+#define SLOTS_PER_SECTOR (VAULT_SECTOR_SIZE / SLOT_SIZE)
+#define TALLY_SIZE (COUNTER_LOG_TALLY_BITS / 8)
+
+#define SLOT_SET    0x01
+#define SLOT_REMOVE 0x02
+#define SLOT_FREE   0xFF
+
+// Slot 0 of each sector. The header is programmed after the slots copied
+// into the sector, so a valid header means the copy finished.
+typedef struct {
+    uint32_t magic;
+    uint32_t generation;    // the higher of two valid sectors is the live one
+    uint32_t crc;           // CRC-32 of the fields above
+} sector_header;
+
+// Slots 1 and up, appended in order; a free slot marks the end.
+typedef struct {
+    uint8_t type;           // SLOT_SET or SLOT_REMOVE
+    uint8_t reserved;
+    uint16_t id;
+    uint32_t crc;           // CRC-32 of type, reserved, id and base
+    uint64_t base;          // counter before the first tally bit
+    uint8_t tally[TALLY_SIZE];  // cleared LSB first, byte by byte
+} slot;
+
+_Static_assert(sizeof(slot) == SLOT_SIZE, "slot layout");
+
+// Where each counter's current slot is and how far its tally has got.
+static struct {
+    uint16_t id;
+    uint16_t slot;
+    uint16_t used;          // tally bits cleared
+    uint64_t base;
+} table[COUNTER_LOG_MAX];
+
+static uint32_t count;
+static int active = -1;
+static uint32_t generation;
+static uint32_t next_slot;
+
+static uint8_t page_buf[VAULT_PAGE_SIZE];
+
+//--------------------------------------------------------------------+
+// Flash access
+//--------------------------------------------------------------------+
+
+static const uint8_t *slot_addr(int sector, uint32_t index) {
+    return flash_hal_counter_base() + (uint32_t)sector * VAULT_SECTOR_SIZE + index * SLOT_SIZE;
+}
+
+// Programs 'len' bytes at 'offset' within 'sector', leaving the rest of
+// the page as it is.
+static void program(int sector, uint32_t offset, const void *data, size_t len) {
+    uint32_t page = offset & ~(VAULT_PAGE_SIZE - 1);
+    memset(page_buf, 0xFF, sizeof(page_buf));
+    memcpy(page_buf + (offset - page), data, len);
+    flash_hal_counter_program_page((uint32_t)sector * VAULT_SECTOR_SIZE + page, page_buf);
+}
+
+static bool sector_blank(int sector) {
+    const uint8_t *p = slot_addr(sector, 0);
+    for (uint32_t i = 0; i < VAULT_SECTOR_SIZE; i++) {
+        if (p[i] != 0xFF) return false;
+    }
+    return true;
+}
+
+static uint32_t slot_crc(const slot *s) {
+    uint32_t crc = crc32_update(0, s, 4);
+    return crc32_update(crc, &s->base, sizeof(s->base));
+}
+
+static bool read_header(int sector, uint32_t *gen) {
+    sector_header h;
+    memcpy(&h, slot_addr(sector, 0), sizeof(h));
+    if (h.magic != COUNTER_SECTOR_MAGIC || h.crc != crc32_update(0, &h, 8)) return false;
+    *gen = h.generation;
+    return true;
+}
+
+static void write_header(int sector, uint32_t gen) {
+    sector_header h = { COUNTER_SECTOR_MAGIC, gen, 0 };
+    h.crc = crc32_update(0, &h, 8);
+    program(sector, 0, &h, sizeof(h));
+}
+
+// Counts the cleared bits at the start of a tally.
+static uint16_t tally_count(const uint8_t *tally) {
+    uint16_t n = 0;
+    for (uint32_t i = 0; i < TALLY_SIZE; i++) {
+        uint8_t b = tally[i];
+        if (b == 0) {
+            n += 8;
+            continue;
+        }
+        while (!(b & 1)) {
+            b >>= 1;
+            n++;
+        }
+        break;
+    }
+    return n;
+}
+
+//--------------------------------------------------------------------+
+// Table
+//--------------------------------------------------------------------+
+
+static int find(uint16_t id) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (table[i].id == id) return (int)i;
+    }
+    return -1;
+}
+
+static void forget(int i) {
+    table[i] = table[--count];
+}
+
+//--------------------------------------------------------------------+
+// Slots
+//--------------------------------------------------------------------+
+
+// Copies every counter into the other sector as a fresh slot, then erases
+// the old one. Slot pages are assembled in RAM and programmed once each.
+static void swap_sectors(void) {
+    int target = 1 - active;
+    if (!sector_blank(target)) {
+        flash_hal_counter_erase_sector((uint32_t)target * VAULT_SECTOR_SIZE);
+    }
+
+    memset(page_buf, 0xFF, sizeof(page_buf));
+    uint32_t page = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t offset = (i + 1) * SLOT_SIZE;
+        if (offset / VAULT_PAGE_SIZE != page) {
+            flash_hal_counter_program_page((uint32_t)target * VAULT_SECTOR_SIZE + page * VAULT_PAGE_SIZE,
+                                           page_buf);
+            memset(page_buf, 0xFF, sizeof(page_buf));
+            page = offset / VAULT_PAGE_SIZE;
+        }
+        slot s;
+        memset(&s, 0xFF, sizeof(s));
+        s.type = SLOT_SET;
+        s.id = table[i].id;
+        s.base = table[i].base + table[i].used;
+        s.crc = slot_crc(&s);
+        memcpy(page_buf + offset % VAULT_PAGE_SIZE, &s, sizeof(s));
+        table[i].slot = (uint16_t)(i + 1);
+        table[i].base = s.base;
+        table[i].used = 0;
+    }
+    if (count > 0) {
+        flash_hal_counter_program_page((uint32_t)target * VAULT_SECTOR_SIZE + page * VAULT_PAGE_SIZE,
+                                       page_buf);
+    }
+
+    write_header(target, ++generation);
+    flash_hal_counter_erase_sector((uint32_t)active * VAULT_SECTOR_SIZE);
+    active = target;
+    next_slot = count + 1;
+}
+
+// Appends a slot to the active sector, swapping sectors first if it is
+// full. Returns the slot index, or 0 if the write did not take.
+static uint32_t append_slot(uint8_t type, uint16_t id, uint64_t base) {
+    if (next_slot >= SLOTS_PER_SECTOR) {
+        swap_sectors();
+    }
+    slot s;
+    memset(&s, 0xFF, sizeof(s));
+    s.type = type;
+    s.id = id;
+    s.base = base;
+    s.crc = slot_crc(&s);
+
+    uint32_t index = next_slot++;
+    program(active, index * SLOT_SIZE, &s, sizeof(s));
+    return memcmp(slot_addr(active, index), &s, sizeof(s)) == 0 ? index : 0;
+}
+
+//--------------------------------------------------------------------+
+// API
+//--------------------------------------------------------------------+
+
+int counter_log_mount(void) {
+    uint32_t gen[2];
+    bool valid[2];
+    for (int s = 0; s < 2; s++) {
+        valid[s] = read_header(s, &gen[s]);
+    }
+
+    count = 0;
+    if (!valid[0] && !valid[1]) {
+        // Nothing usable: start afresh in sector 0.
+        if (!sector_blank(0)) {
+            flash_hal_counter_erase_sector(0);
+        }
+        write_header(0, 1);
+        if (!read_header(0, &generation)) return -1;
+        active = 0;
+        next_slot = 1;
+        return 0;
+    }
+
+    // A swap cut short leaves the new sector without a header, so the old
+    // one still wins.
+    active = (valid[0] && (!valid[1] || gen[0] > gen[1])) ? 0 : 1;
+    generation = gen[active];
+
+    next_slot = SLOTS_PER_SECTOR;
+    for (uint32_t i = 1; i < SLOTS_PER_SECTOR; i++) {
+        slot s;
+        memcpy(&s, slot_addr(active, i), sizeof(s));
+        if (s.type == SLOT_FREE) {
+            next_slot = i;
+            break;
+        }
+        if (s.crc != slot_crc(&s)) continue;  // torn append
+
+        int e = find(s.id);
+        if (s.type == SLOT_REMOVE) {
+            if (e >= 0) forget(e);
+            continue;
+        }
+        if (s.type != SLOT_SET) continue;
+        if (e < 0) {
+            if (count == COUNTER_LOG_MAX) continue;
+            e = (int)count++;
+            table[e].id = s.id;
+        }
+        table[e].slot = (uint16_t)i;
+        table[e].base = s.base;
+        table[e].used = tally_count(s.tally);
+    }
+    return 0;
+}
+
+uint64_t counter_log_get(uint16_t id) {
+    int e = find(id);
+    return e < 0 ? 0 : table[e].base + table[e].used;
+}
+
+int counter_log_next(uint16_t id, uint64_t floor, uint64_t *value) {
+    if (active < 0) return -1;
+    int e = find(id);
+    uint64_t stored = e < 0 ? 0 : table[e].base + table[e].used;
+    uint64_t v = stored > floor ? stored : floor;
+
+    if (e >= 0 && v == stored && table[e].used < COUNTER_LOG_TALLY_BITS) {
+        // The common case: clear one more tally bit.
+        uint16_t bit = table[e].used;
+        uint32_t offset = table[e].slot * SLOT_SIZE + offsetof(slot, tally) + bit / 8;
+        uint8_t mask = (uint8_t)~(1u << (bit % 8));
+        program(active, offset, &mask, 1);
+        if (slot_addr(active, 0)[offset] & (1u << (bit % 8))) return -1;
+        table[e].used++;
+    } else {
+        bool created = e < 0;
+        if (created) {
+            if (count == COUNTER_LOG_MAX) return -1;
+            e = (int)count++;
+            table[e].id = id;
+            table[e].base = v;
+            table[e].used = 0;
+            table[e].slot = 0;
+        }
+        uint32_t index = append_slot(SLOT_SET, id, v + 1);
+        e = find(id);
+        if (index == 0) {
+            if (created) forget(e);
+            return -1;
+        }
+        table[e].slot = (uint16_t)index;
+        table[e].base = v + 1;
+        table[e].used = 0;
+    }
+    *value = v;
+    return 0;
+}
+
+int counter_log_remove(uint16_t id) {
+    if (active < 0) return -1;
+    if (find(id) < 0) return 0;
+    if (append_slot(SLOT_REMOVE, id, 0) == 0) return -1;
+    // The swap inside append_slot() may have moved the table around.
+    int e = find(id);
+    if (e >= 0) forget(e);
+    return 0;
+}
+
+void counter_log_get_stats(counter_log_stats *stats) {
+    stats->counters = count;
+    stats->slots_used = next_slot - 1;
+    stats->slots = SLOTS_PER_SECTOR - 1;
+    stats->generation = generation;
+}
@@ -0,0 +1,58 @@
+#ifndef COUNTER_LOG_H
+#define COUNTER_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "flash_hal.h"
+
+// Moving counters for HOTP (RFC 4226) accounts, kept in the two flash
+// sectors at COUNTER_FLASH_OFFSET so that counting needs no erase.
+//
+// Each counter is a 64-byte slot: a header with the account id and a base
+// value, then a 384-bit unary tally that starts erased (all ones). An
+// increment programs the next tally bit to 0, which NOR flash allows in
+// place, so it costs one page program. When a tally is full, or the
+// counter jumps, a fresh slot is appended. When the sector runs out of
+// slots, the current value of every counter is copied into the other
+// sector and the old one is erased: with one busy account that is one
+// erase per 63 * 384 = 24192 increments.
+//
+// Only one core may use the log (the worker on core 1).
+
+// Counters tracked at once. The live set must fit in one sector with room
+// to spare, or the sectors would be swapped on every increment.
+#define COUNTER_LOG_MAX 32
+
+// Increments per slot.
+#define COUNTER_LOG_TALLY_BITS 384
+
+typedef struct {
+    uint32_t counters;       // ids with a counter
+    uint32_t slots_used;     // slots taken in the active sector
+    uint32_t slots;          // slots per sector
+    uint32_t generation;     // sector swaps since the log was created
+} counter_log_stats;
+
+// Finds the active sector and rebuilds the in-RAM table, formatting the
+// region if it is blank. Must be called before anything else.
+// Returns 0 on success, or -1 if the region is unusable.
+int counter_log_mount(void);
+
+// Returns the stored counter for 'id', or 0 if it has none.
+uint64_t counter_log_get(uint16_t id);
+
+// Takes the next counter value for 'id': the larger of its stored counter
+// and 'floor'. The value after it is stored before this returns, so a
+// value is never handed out twice, even across a power cut.
+// Returns 0 and sets '*value' on success, or -1 if the log is full or the
+// write failed.
+int counter_log_next(uint16_t id, uint64_t floor, uint64_t *value);
+
+// Forgets the counter for 'id'. Returns 0 on success (including when there
+// was none), or -1 if the write failed.
+int counter_log_remove(uint16_t id);
+
+void counter_log_get_stats(counter_log_stats *stats);
+
+#endif // COUNTER_LOG_H
@@ -0,0 +1,11 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC-32 (IEEE 802.3, reflected, as used by zlib/PNG).
+// Pass 0 as 'crc' for the first chunk and the previous result to continue.
+uint32_t crc32_update(uint32_t crc, const void *data, size_t len);
+
+#endif // CRC32_H
@@ -0,0 +1,11 @@
+#ifndef ENTROPY_H
+#define ENTROPY_H
+
+#include <stddef.h>
+
+// Random bytes for salts and nonces. entropy_pico.c uses the RP2040's
+// pico_rand generator (ring oscillator, bus counters and time mixed
+// together); entropy_host.c reads the operating system's generator.
+void entropy_fill(void *buf, size_t len);
+
+#endif // ENTROPY_H
@@ -0,0 +1,17 @@
+#include "entropy.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "pico/rand.h"
+
+void entropy_fill(void *buf, size_t len) {
+    uint8_t *out = buf;
+    while (len > 0) {
+        uint64_t r = get_rand_64();
+        size_t n = len < sizeof(r) ? len : sizeof(r);
+        memcpy(out, &r, n);
+        out += n;
+        len -= n;
+    }
+}
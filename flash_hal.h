@@ -0,0 +1,46 @@
+#ifndef FLASH_HAL_H
+#define FLASH_HAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Flash region holding the vault, and the operations the vault needs on it.
+// flash_hal_pico.c drives the RP2040 QSPI flash; flash_hal_host.c is a RAM
+// image with the same NOR semantics for host builds.
+//
+// The two sectors just below the vault hold the HOTP counter log
+// (counter_log.h), which programs single bits in place and so cannot live
+// in the vault's append-only log. They have their own set of the same
+// operations, with offsets relative to COUNTER_FLASH_OFFSET.
+
+#define FLASH_TARGET_OFFSET (512 * 1024) // choosing to start at 512K
+#define VAULT_FLASH_SIZE (1536 * 1024)   // everything above it on a 2 MB part
+
+#define VAULT_SECTOR_SIZE 4096   // erase unit
+#define VAULT_PAGE_SIZE 256      // program unit
+#define VAULT_SECTOR_COUNT (VAULT_FLASH_SIZE / VAULT_SECTOR_SIZE)
+
+#define COUNTER_FLASH_SIZE (2 * VAULT_SECTOR_SIZE)
+#define COUNTER_FLASH_OFFSET (FLASH_TARGET_OFFSET - COUNTER_FLASH_SIZE)
+
+// Returns 0 if the firmware image ends below COUNTER_FLASH_OFFSET. Nothing
+// else stops a grown binary from reaching the counter log or the vault,
+// whose erases would then wipe code; call this before mounting either.
+int flash_hal_check_layout(void);
+
+// Memory-mapped start of the vault region (XIP on the Pico).
+const uint8_t *flash_hal_base(void);
+
+// Erases the sector at 'offset' (relative to the region) to all 0xFF.
+void flash_hal_erase_sector(uint32_t offset);
+
+// Programs one 256-byte page at 'offset'. Programming can only clear bits,
+// so bytes left at 0xFF in 'page' keep whatever the flash already holds;
+// this is what lets records be appended to a partly written page.
+void flash_hal_program_page(uint32_t offset, const uint8_t *page);
+
+const uint8_t *flash_hal_counter_base(void);
+void flash_hal_counter_erase_sector(uint32_t offset);
+void flash_hal_counter_program_page(uint32_t offset, const uint8_t *page);
+
+#endif // FLASH_HAL_H
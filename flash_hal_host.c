@@ -0,0 +1,79 @@
+#include "flash_hal.h"
+#include "flash_hal_host.h"
+
+#include <string.h>
+
+static uint8_t image[VAULT_FLASH_SIZE];
+static uint8_t counter_image[COUNTER_FLASH_SIZE];
+static flash_hal_host_counters counters;
+static int initialised = 0;
+
+static void ensure_init(void) {
+    if (!initialised) {
+        flash_hal_host_reset();
+    }
+}
+
+void flash_hal_host_reset(void) {
+    memset(image, 0xFF, sizeof(image));
+    memset(counter_image, 0xFF, sizeof(counter_image));
+    memset(&counters, 0, sizeof(counters));
+    initialised = 1;
+}
+
+uint8_t *flash_hal_host_image(void) {
+    ensure_init();
+    return image;
+}
+
+uint8_t *flash_hal_host_counter_image(void) {
+    ensure_init();
+    return counter_image;
+}
+
+flash_hal_host_counters flash_hal_host_get_counters(void) {
+    return counters;
+}
+
+int flash_hal_check_layout(void) {
+    return 0; // the images are separate arrays
+}
+
+const uint8_t *flash_hal_base(void) {
+    ensure_init();
+    return image;
+}
+
+void flash_hal_erase_sector(uint32_t offset) {
+    ensure_init();
+    memset(image + offset, 0xFF, VAULT_SECTOR_SIZE);
+    counters.sector_erases++;
+}
+
+void flash_hal_program_page(uint32_t offset, const uint8_t *page) {
+    ensure_init();
+    // NOR flash: programming only clears bits.
+    for (uint32_t i = 0; i < VAULT_PAGE_SIZE; i++) {
+        image[offset + i] &= page[i];
+    }
+    counters.page_programs++;
+}
+
+const uint8_t *flash_hal_counter_base(void) {
+    ensure_init();
+    return counter_image;
+}
+
+void flash_hal_counter_erase_sector(uint32_t offset) {
+    ensure_init();
+    memset(counter_image + offset, 0xFF, VAULT_SECTOR_SIZE);
+    counters.sector_erases++;
+}
+
+void flash_hal_counter_program_page(uint32_t offset, const uint8_t *page) {
+    ensure_init();
+    for (uint32_t i = 0; i < VAULT_PAGE_SIZE; i++) {
+        counter_image[offset + i] &= page[i];
+    }
+    counters.page_programs++;
+}
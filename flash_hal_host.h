@@ -0,0 +1,25 @@
+#ifndef FLASH_HAL_HOST_H
+#define FLASH_HAL_HOST_H
+
+#include <stdint.h>
+
+// Host-only controls for the RAM-backed flash image.
+
+// Operation counters since the last flash_hal_host_reset().
+typedef struct {
+    uint32_t page_programs;
+    uint32_t sector_erases;
+} flash_hal_host_counters;
+
+// Fills the image with 0xFF (a blank chip) and clears the counters.
+void flash_hal_host_reset(void);
+
+// Writable view of the image, for preloading layouts in tests and tools.
+uint8_t *flash_hal_host_image(void);
+
+// The same for the COUNTER_FLASH_SIZE bytes of the counter log sectors.
+uint8_t *flash_hal_host_counter_image(void);
+
+flash_hal_host_counters flash_hal_host_get_counters(void);
+
+#endif // FLASH_HAL_HOST_H
@@ -0,0 +1,55 @@
+#include "flash_hal.h"
+
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+
+// The other core runs from flash too, so park it while XIP is unavailable.
+static void erase_sector(uint32_t flash_offset) {
+    multicore_lockout_start_blocking();
+    uint32_t interrupts = save_and_disable_interrupts();
+    flash_range_erase(flash_offset, VAULT_SECTOR_SIZE);
+    restore_interrupts(interrupts);
+    multicore_lockout_end_blocking();
+}
+
+static void program_page(uint32_t flash_offset, const uint8_t *page) {
+    multicore_lockout_start_blocking();
+    uint32_t interrupts = save_and_disable_interrupts();
+    flash_range_program(flash_offset, page, VAULT_PAGE_SIZE);
+    restore_interrupts(interrupts);
+    multicore_lockout_end_blocking();
+}
+
+// End of the image in flash, from the SDK linker script.
+extern char __flash_binary_end;
+
+int flash_hal_check_layout(void) {
+    uintptr_t end = (uintptr_t)&__flash_binary_end;
+    return end <= XIP_BASE + COUNTER_FLASH_OFFSET ? 0 : -1;
+}
+
+const uint8_t *flash_hal_base(void) {
+    return (const uint8_t *)(XIP_BASE + FLASH_TARGET_OFFSET);
+}
+
+void flash_hal_erase_sector(uint32_t offset) {
+    erase_sector(FLASH_TARGET_OFFSET + offset);
+}
+
+void flash_hal_program_page(uint32_t offset, const uint8_t *page) {
+    program_page(FLASH_TARGET_OFFSET + offset, page);
+}
+
+const uint8_t *flash_hal_counter_base(void) {
+    return (const uint8_t *)(XIP_BASE + COUNTER_FLASH_OFFSET);
+}
+
+void flash_hal_counter_erase_sector(uint32_t offset) {
+    erase_sector(COUNTER_FLASH_OFFSET + offset);
+}
+
+void flash_hal_counter_program_page(uint32_t offset, const uint8_t *page) {
+    program_page(COUNTER_FLASH_OFFSET + offset, page);
+}
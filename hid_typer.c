@@ -0,0 +1,136 @@
+#include "hid_typer.h"
+
+#include <string.h>
+
+static const uint8_t no_keys[6] = {0};
+
+static bool report_holds(const uint8_t keycode[6], uint8_t key) {
+  for (int i = 0; i < 6; i++) {
+    if (keycode[i] == key) return true;
+  }
+  return false;
+}
+
+// Queues the next report, if one is due and nothing is in flight.
+//
+// Keys are packed 6-key-rollover style: the next report keeps the keys that
+// are already down and adds the following characters after them, as long as
+// they share the modifier, are not already held and there is a free slot.
+// Only a repeated character, a modifier change, a full report or the end of
+// the text forces an all-keys-up report. New keys appear in text order within
+// the array, which is the order hosts report them in.
+static void hid_typer_step(hid_typer_t *t) {
+  if (!t->active || t->in_flight) return;
+
+  size_t avail = t->ready ? *t->ready : t->len;
+
+  // Skip anything the key map can't type.
+  uint8_t key = 0, mod = 0;
+  while (t->pos < avail && !t->map(t->text[t->pos], &key, &mod)) {
+    t->pos++;
+  }
+
+  // Caught up with the producer: hid_typer_task() tries again.
+  if (t->pos >= avail && avail < t->len) return;
+
+  if (t->pos >= t->len) {
+    if (t->key_count == 0) {
+      // Everything pressed and released.
+      t->active = false;
+    } else if (t->send(0, no_keys)) {
+      t->key_count = 0;
+      t->in_flight = true;
+    }
+    return;
+  }
+
+  if (t->key_count > 0 &&
+      (mod != t->modifier || t->key_count == 6 || report_holds(t->keycode, key))) {
+    // Release before the next press so repeats and modifier changes register.
+    if (t->send(0, no_keys)) {
+      t->key_count = 0;
+      t->in_flight = true;
+    }
+    return;
+  }
+
+  // Build the next report on top of the keys already held.
+  uint8_t keycode[6];
+  memcpy(keycode, t->keycode, sizeof(keycode));
+  uint8_t count = t->key_count;
+  uint8_t added = 0;
+  size_t pos = t->pos;
+  if (count == 0) {
+    memset(keycode, 0, sizeof(keycode));
+  }
+
+  while (pos < avail && count < 6 && added < t->max_new_keys) {
+    uint8_t k, m;
+    if (!t->map(t->text[pos], &k, &m)) {
+      pos++;
+      continue;
+    }
+    if (m != mod || report_holds(keycode, k)) break;
+    keycode[count++] = k;
+    added++;
+    pos++;
+  }
+
+  if (t->send(mod, keycode)) {
+    memcpy(t->keycode, keycode, sizeof(keycode));
+    t->key_count = count;
+    t->modifier = mod;
+    t->pos = pos;
+    t->in_flight = true;
+  }
+}
+
+void hid_typer_init(hid_typer_t *t, hid_typer_send_fn send, hid_typer_map_fn map) {
+  t->send = send;
+  t->map = map;
+  t->text = NULL;
+  t->len = 0;
+  t->ready = NULL;
+  t->pos = 0;
+  t->max_new_keys = HID_TYPER_MAX_NEW_KEYS;
+  t->key_count = 0;
+  t->modifier = 0;
+  memset(t->keycode, 0, sizeof(t->keycode));
+  t->in_flight = false;
+  t->active = false;
+}
+
+bool hid_typer_start(hid_typer_t *t, const char *text, size_t len) {
+  return hid_typer_start_stream(t, text, len, NULL);
+}
+
+bool hid_typer_start_stream(hid_typer_t *t, const char *text, size_t len,
+                            const volatile size_t *ready) {
+  if (t->active) return false;
+  t->text = text;
+  t->len = len;
+  t->ready = ready;
+  t->pos = 0;
+  t->active = true;
+  hid_typer_step(t);
+  return true;
+}
+
+bool hid_typer_busy(const hid_typer_t *t) {
+  return t->active || t->in_flight;
+}
+
+void hid_typer_report_complete(hid_typer_t *t) {
+  t->in_flight = false;
+  hid_typer_step(t);
+}
+
+void hid_typer_task(hid_typer_t *t) {
+  hid_typer_step(t);
+}
+
+void hid_typer_reset(hid_typer_t *t) {
+  t->active = false;
+  t->in_flight = false;
+  t->key_count = 0;
+}
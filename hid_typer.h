@@ -0,0 +1,71 @@
+#ifndef HID_TYPER_H
+#define HID_TYPER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Non-blocking keyboard typing engine. A string is turned into a sequence of
+// HID keyboard reports; the next report is sent as soon as the previous one
+// has gone out (tud_hid_report_complete_cb), so typing runs at one report per
+// USB frame with no sleeps while the main loop keeps running.
+
+// Most new keys added to a single report. Runs of distinct characters that
+// share a modifier are packed into the 6-slot keycode array; set this to 1
+// for hosts that don't report simultaneous presses in array order, which
+// still saves reports by pressing one new key per report while holding the
+// previous ones.
+#ifndef HID_TYPER_MAX_NEW_KEYS
+#define HID_TYPER_MAX_NEW_KEYS 6
+#endif
+
+// Sends one keyboard report. Returns false if the endpoint is busy; the
+// report is then retried by the next hid_typer_task().
+typedef bool (*hid_typer_send_fn)(uint8_t modifier, const uint8_t keycode[6]);
+
+// Maps a character to its keycode and modifier. Returns false if the
+// character cannot be typed; it is then skipped.
+typedef bool (*hid_typer_map_fn)(char c, uint8_t *keycode, uint8_t *modifier);
+
+typedef struct {
+  hid_typer_send_fn send;
+  hid_typer_map_fn map;
+  const char *text;     // string being typed, owned by the caller
+  size_t len;
+  const volatile size_t *ready; // bytes of 'text' filled in so far, or NULL
+  size_t pos;           // next character to press
+  uint8_t max_new_keys; // HID_TYPER_MAX_NEW_KEYS unless changed after init
+  uint8_t keycode[6];   // keys held by the last report sent
+  uint8_t key_count;    // used entries in 'keycode'
+  uint8_t modifier;     // modifier of the last report sent
+  bool in_flight;       // a report is queued on the endpoint
+  bool active;          // typing has not finished yet
+} hid_typer_t;
+
+// Sets up an idle typer using 'send' to emit reports and 'map' for keycodes.
+void hid_typer_init(hid_typer_t *t, hid_typer_send_fn send, hid_typer_map_fn map);
+
+// Starts typing 'len' bytes of 'text'. The buffer must stay valid until
+// hid_typer_busy() returns false. Returns false if already typing.
+bool hid_typer_start(hid_typer_t *t, const char *text, size_t len);
+
+// Same, for text that is still being produced (e.g. decrypted by the other
+// core): only the first '*ready' bytes are read, and typing pauses whenever
+// it catches up. The producer must write the bytes before raising '*ready'.
+bool hid_typer_start_stream(hid_typer_t *t, const char *text, size_t len,
+                            const volatile size_t *ready);
+
+// True until the final key release has been delivered.
+bool hid_typer_busy(const hid_typer_t *t);
+
+// Call from tud_hid_report_complete_cb(): sends the next report.
+void hid_typer_report_complete(hid_typer_t *t);
+
+// Call from the main loop: (re)sends a report that could not be queued.
+void hid_typer_task(hid_typer_t *t);
+
+// Abandons any typing in progress, e.g. when the host unmounts the device
+// and the pending report will never complete.
+void hid_typer_reset(hid_typer_t *t);
+
+#endif // HID_TYPER_H
@@ -0,0 +1,125 @@
+#include "keymap.h"
+
+// HID usage IDs on the Keyboard/Keypad page (0x07) used below.
+enum {
+  K_A = 0x04,       // A..Z are contiguous
+  K_1 = 0x1E,       // 1..9 are contiguous
+  K_0 = 0x27,
+  K_ENTER = 0x28,
+  K_TAB = 0x2B,
+  K_SPACE = 0x2C,
+  K_MINUS = 0x2D,
+  K_EQUAL = 0x2E,
+  K_BRACKET_LEFT = 0x2F,
+  K_BRACKET_RIGHT = 0x30,
+  K_BACKSLASH = 0x31,
+  K_EUROPE_1 = 0x32,  // ISO key left of Enter
+  K_SEMICOLON = 0x33,
+  K_APOSTROPHE = 0x34,
+  K_GRAVE = 0x35,
+  K_COMMA = 0x36,
+  K_PERIOD = 0x37,
+  K_SLASH = 0x38,
+  K_EUROPE_2 = 0x64,  // ISO key right of left Shift
+};
+
+#define SHIFT 0x02  // KEYBOARD_MODIFIER_LEFTSHIFT
+#define ALTGR 0x40  // KEYBOARD_MODIFIER_RIGHTALT
+
+#define KEY(c, k)     [(unsigned char)(c)] = { (k), 0 }
+#define SHIFTED(c, k) [(unsigned char)(c)] = { (k), SHIFT }
+#define ALTGR_(c, k)  [(unsigned char)(c)] = { (k), ALTGR }
+
+#define LETTER(l, u, n) KEY(l, K_A + (n)), SHIFTED(u, K_A + (n))
+
+// Letters shared by every layout (y and z move on QWERTZ).
+#define LETTERS_EXCEPT_YZ \
+  LETTER('a', 'A', 0),  LETTER('b', 'B', 1),  LETTER('c', 'C', 2),  LETTER('d', 'D', 3), \
+  LETTER('e', 'E', 4),  LETTER('f', 'F', 5),  LETTER('g', 'G', 6),  LETTER('h', 'H', 7), \
+  LETTER('i', 'I', 8),  LETTER('j', 'J', 9),  LETTER('k', 'K', 10), LETTER('l', 'L', 11), \
+  LETTER('m', 'M', 12), LETTER('n', 'N', 13), LETTER('o', 'O', 14), LETTER('p', 'P', 15), \
+  LETTER('q', 'Q', 16), LETTER('r', 'R', 17), LETTER('s', 'S', 18), LETTER('t', 'T', 19), \
+  LETTER('u', 'U', 20), LETTER('v', 'V', 21), LETTER('w', 'W', 22), LETTER('x', 'X', 23)
+
+#define DIGITS \
+  KEY('1', K_1),     KEY('2', K_1 + 1), KEY('3', K_1 + 2), KEY('4', K_1 + 3), \
+  KEY('5', K_1 + 4), KEY('6', K_1 + 5), KEY('7', K_1 + 6), KEY('8', K_1 + 7), \
+  KEY('9', K_1 + 8), KEY('0', K_0)
+
+#define WHITESPACE \
+  KEY(' ', K_SPACE), KEY('\t', K_TAB), KEY('\n', K_ENTER)
+
+// Punctuation on the US and UK layouts that sits in the same place.
+#define ANSI_COMMON_SYMBOLS \
+  SHIFTED('!', K_1),     SHIFTED('$', K_1 + 3), SHIFTED('%', K_1 + 4), \
+  SHIFTED('^', K_1 + 5), SHIFTED('&', K_1 + 6), SHIFTED('*', K_1 + 7), \
+  SHIFTED('(', K_1 + 8), SHIFTED(')', K_0), \
+  KEY('-', K_MINUS),     SHIFTED('_', K_MINUS), \
+  KEY('=', K_EQUAL),     SHIFTED('+', K_EQUAL), \
+  KEY('[', K_BRACKET_LEFT),  SHIFTED('{', K_BRACKET_LEFT), \
+  KEY(']', K_BRACKET_RIGHT), SHIFTED('}', K_BRACKET_RIGHT), \
+  KEY(';', K_SEMICOLON), SHIFTED(':', K_SEMICOLON), \
+  KEY('\'', K_APOSTROPHE), \
+  KEY('`', K_GRAVE), \
+  KEY(',', K_COMMA),     SHIFTED('<', K_COMMA), \
+  KEY('.', K_PERIOD),    SHIFTED('>', K_PERIOD), \
+  KEY('/', K_SLASH),     SHIFTED('?', K_SLASH)
+
+static const keymap_entry keymap_tables[KEYMAP_LAYOUT_COUNT][128] = {
+  [KEYMAP_LAYOUT_US] = {
+    LETTERS_EXCEPT_YZ, LETTER('y', 'Y', 24), LETTER('z', 'Z', 25),
+    DIGITS, WHITESPACE, ANSI_COMMON_SYMBOLS,
+    SHIFTED('@', K_1 + 1), SHIFTED('#', K_1 + 2),
+    KEY('\\', K_BACKSLASH), SHIFTED('|', K_BACKSLASH),
+    SHIFTED('"', K_APOSTROPHE),
+    SHIFTED('~', K_GRAVE),
+  },
+
+  [KEYMAP_LAYOUT_UK] = {
+    LETTERS_EXCEPT_YZ, LETTER('y', 'Y', 24), LETTER('z', 'Z', 25),
+    DIGITS, WHITESPACE, ANSI_COMMON_SYMBOLS,
+    SHIFTED('"', K_1 + 1), SHIFTED('@', K_APOSTROPHE),
+    KEY('#', K_EUROPE_1), SHIFTED('~', K_EUROPE_1),
+    KEY('\\', K_EUROPE_2), SHIFTED('|', K_EUROPE_2),
+  },
+
+  // QWERTZ. '^' and '`' are dead keys on this layout and are left out.
+  [KEYMAP_LAYOUT_DE] = {
+    LETTERS_EXCEPT_YZ, LETTER('z', 'Z', 24), LETTER('y', 'Y', 25),
+    DIGITS, WHITESPACE,
+    SHIFTED('!', K_1),     SHIFTED('"', K_1 + 1), SHIFTED('$', K_1 + 3),
+    SHIFTED('%', K_1 + 4), SHIFTED('&', K_1 + 5), SHIFTED('/', K_1 + 6),
+    SHIFTED('(', K_1 + 7), SHIFTED(')', K_1 + 8), SHIFTED('=', K_0),
+    ALTGR_('{', K_1 + 6),  ALTGR_('[', K_1 + 7),  ALTGR_(']', K_1 + 8), ALTGR_('}', K_0),
+    SHIFTED('?', K_MINUS), ALTGR_('\\', K_MINUS),
+    KEY('+', K_BRACKET_RIGHT), SHIFTED('*', K_BRACKET_RIGHT), ALTGR_('~', K_BRACKET_RIGHT),
+    KEY('#', K_EUROPE_1),  SHIFTED('\'', K_EUROPE_1),
+    KEY(',', K_COMMA),     SHIFTED(';', K_COMMA),
+    KEY('.', K_PERIOD),    SHIFTED(':', K_PERIOD),
+    KEY('-', K_SLASH),     SHIFTED('_', K_SLASH),
+    KEY('<', K_EUROPE_2),  SHIFTED('>', K_EUROPE_2), ALTGR_('|', K_EUROPE_2),
+    ALTGR_('@', K_A + 16),
+  },
+};
+
+static const keymap_entry *active = keymap_tables[KEYMAP_DEFAULT_LAYOUT];
+
+bool keymap_set_layout(keymap_layout layout) {
+  if ((unsigned)layout >= KEYMAP_LAYOUT_COUNT) return false;
+  active = keymap_tables[layout];
+  return true;
+}
+
+const keymap_entry *keymap_table(keymap_layout layout) {
+  if ((unsigned)layout >= KEYMAP_LAYOUT_COUNT) return active;
+  return keymap_tables[layout];
+}
+
+bool keymap_lookup(char c, uint8_t *keycode, uint8_t *modifier) {
+  unsigned char i = (unsigned char)c;
+  if (i >= 128) return false;
+  keymap_entry e = active[i];
+  *keycode = e.keycode;
+  *modifier = e.modifier;
+  return e.keycode != 0;
+}
@@ -0,0 +1,38 @@
+#ifndef KEYMAP_H
+#define KEYMAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// ASCII to HID keyboard usage lookup. Each layout is a 128-entry table of
+// {keycode, modifier} built by the compiler, so a lookup is one indexed load.
+
+typedef enum {
+  KEYMAP_LAYOUT_US,
+  KEYMAP_LAYOUT_UK,
+  KEYMAP_LAYOUT_DE,
+  KEYMAP_LAYOUT_COUNT
+} keymap_layout;
+
+// Layout used until keymap_set_layout() is called; set with -DKEYMAP_LAYOUT=
+// in CMake.
+#ifndef KEYMAP_DEFAULT_LAYOUT
+#define KEYMAP_DEFAULT_LAYOUT KEYMAP_LAYOUT_US
+#endif
+
+typedef struct {
+  uint8_t keycode;    // HID usage on the keyboard page, 0 if not typeable
+  uint8_t modifier;   // KEYBOARD_MODIFIER_* bits
+} keymap_entry;
+
+// Selects the host keyboard layout. Returns false for an unknown layout.
+bool keymap_set_layout(keymap_layout layout);
+
+// Returns the table for 'layout', or the active one if out of range.
+const keymap_entry *keymap_table(keymap_layout layout);
+
+// Looks up 'c' in the active layout. Returns false if it can't be typed
+// (non-ASCII, control characters other than tab/newline, dead keys).
+bool keymap_lookup(char c, uint8_t *keycode, uint8_t *modifier);
+
+#endif // KEYMAP_H
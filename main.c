@@ -30,20 +30,26 @@
 #include "pico/stdlib.h"
 #include "bsp/board_api.h"
 #include "tusb.h"
-#include "hardware/flash.h"
+#include "pico/multicore.h"
 
 #include "hardware/uart.h"
+#include "hardware/structs/scb.h"
 
-// totp header file
-#include "totp.h"
+// core 1 owns storage, provisioning and TOTP
+#include "worker.h"
 
 #define UART_ID uart0
-#define BAUD_RATE 115200
+#define BAUD_RATE 921600
 #define UART_TX_PIN 16
 #define UART_RX_PIN 17
+// RTS pauses the sender while the provisioning ring on core 1 is full.
+#define UART_RTS_PIN 19
 
 #include "usb_descriptors.h"
-#define FLASH_TARGET_OFFSET (512 * 1024) // choosing to start at 512K
+#include "buttons.h"
+#include "pin_entry.h"
+#include "hid_typer.h"
+#include "keymap.h"
 
 //--------------------------------------------------------------------+
 // MACRO CONSTANT TYPEDEF PROTYPES
@@ -64,49 +70,53 @@ int numButtons = 8; // Number of GPIO Inputs
 uint32_t userChosen = 0;
 bool usePass = false;
 
-// Password Initial Variables
-char password[] = {0, 6, 7,  3};
-bool authorizedPass = true;
-
-char myData[4096];
-char myData1[4096];
+// Set once a PIN has unlocked the vault. The PIN is only ever entered on the
+// buttons; the first one entered on a new vault becomes its PIN.
+#ifndef PIN_DIGITS
+#define PIN_DIGITS 4
+#endif
+bool authorizedPass = false;
 
 static uint32_t blink_interval_ms = BLINK_NOT_MOUNTED;
+static uint32_t blink_start_ms = 0;
+
+// The BOOTSEL lock button has no interrupt, so it is still polled.
+#define LOCK_CHECK_INTERVAL_MS 100
+static uint32_t lock_check_ms = 0;
 
-// Time variables
-uint32_t unix_time;
-uint32_t start_time_ms = 0;
+// PIN entry while locked (see unlock_task()).
+#define PIN_DIGIT_FLASH_MS 100
+#define PIN_LOCKOUT_BLINK_MS 100
+#define PIN_NO_VAULT_BLINK_MS 1000
+static pin_entry_t pin_entry;
+static bool no_vault = false;   // core 1 has no vault to check PINs against
+static uint32_t pin_flash_start_ms = 0;
+static bool pin_flash = false;
 
+#ifdef POWER_TRACE
+// Time core 0 has spent asleep in idle_until(), for the awake share.
+static uint64_t asleep_us = 0;
+#endif
 
-// --- TOTP Variables ---
-// Maximum secret length for TOTP configuration
-#define SECRET_MAX 32
-// Global Base32 secret for TOTP generation (default value)
-char base32_secret[SECRET_MAX] = "JBSWY3DPEHPK3PXP";
-volatile bool new_secret_programmed = false;
+// Set while a command is with core 1; buttons are ignored until it answers.
+static bool worker_busy = false;
 
 void led_blinking_task(void);
 void lock_check_task(void);
+void unlock_task(void);
 void gpio_task(void);
-void storeString();
-void readString();
-
-// TOTP task: generates and sends a TOTP code periodically.
-void totp_task(void) {
-  uint32_t elapsed_time_ms = board_millis() - start_time_ms;
-  uint32_t current_time = unix_time + (elapsed_time_ms / 1000);
-
-  char otp[10] = {0};
-  int time_remaining = 0;
-  if (totp(current_time, base32_secret, 30, 6, otp, sizeof(otp), &time_remaining) == 0) {
-      printf("TOTP: %s, valid for %d seconds\n", otp, time_remaining);
-      // Optionally, send the OTP via USB HID:
-      // (We call a function similar to send_string_via_hid below.)
-      // send_string_via_hid(otp);
-  } else {
-      printf("Error generating TOTP\n");
-  }
-}
+void worker_event_task(void);
+void worker_unlock(void);
+void cdc_task(void);
+static void idle_until(absolute_time_t deadline);
+static absolute_time_t next_wakeup(void);
+static int32_t pin_led_wait_ms(uint32_t now);
+
+// Types text from core 1 one report per frame, without blocking the loop.
+static hid_typer_t typer;
+// Set while the typer is still reading text owned by core 1.
+static bool worker_typing = false;
+static bool send_keyboard_report(uint8_t modifier, const uint8_t keycode[6]);
 
 /*------------- MAIN -------------*/
 int main(void)
@@ -114,10 +124,6 @@ int main(void)
  //added for init
  stdio_init_all();
 
- uart_init(UART_ID, BAUD_RATE);
- gpio_set_function(UART_TX_PIN, UART_FUNCSEL_NUM(UART_ID, UART_TX_PIN));
- gpio_set_function(UART_RX_PIN, UART_FUNCSEL_NUM(UART_ID, UART_RX_PIN));
-
   // init device stack on configured roothub port
  tud_init(BOARD_TUD_RHPORT);
 
@@ -129,72 +135,96 @@ int main(void)
 
   stdio_init_all();
 
+  // After stdio, which would otherwise reset the baud rate.
+  uart_init(UART_ID, BAUD_RATE);
+  gpio_set_function(UART_TX_PIN, UART_FUNCSEL_NUM(UART_ID, UART_TX_PIN));
+  gpio_set_function(UART_RX_PIN, UART_FUNCSEL_NUM(UART_ID, UART_RX_PIN));
+  gpio_set_function(UART_RTS_PIN, UART_FUNCSEL_NUM(UART_ID, UART_RTS_PIN));
+  uart_set_hw_flow(UART_ID, false, true);
+
   //Initiaizing all the GPIO pins as inputs for the buttons
   for (int i = 0; i < numButtons ; i++) {
       gpio_init(i);
       gpio_set_dir(i, GPIO_IN);
   }
 
+  buttons_init(0);
+
   gpio_init(PICO_DEFAULT_LED_PIN);
   gpio_set_dir(PICO_DEFAULT_LED_PIN, GPIO_OUT);
   gpio_put(PICO_DEFAULT_LED_PIN, 0);
 
-  //Check initial button presses for password
-  char passwordInput[] = {0, 0, 0, 0};
-  int numInputs = 0;
-  bool wrongPassword = false;
+  // Any interrupt becoming pending wakes __wfe(), even one that fires just
+  // before the loop goes to sleep.
+  scb_hw->scr |= M0PLUS_SCR_SEVONPEND_BITS;
+
+  pin_entry_init(&pin_entry, PIN_DIGITS);
+
+  // Core 1 erases and programs flash, so it must be able to pause us.
+  multicore_lockout_victim_init();
+  worker_start();
 
-  readString();
+  hid_typer_init(&typer, send_keyboard_report, keymap_lookup);
 
 
   while (1)
   {
     tud_task(); // Process USB tasks
     
+    // USB keeps running while the PIN is entered.
     while (!authorizedPass) {
-        //Cycles through to check for button press, blinks if there is input
-        for (int i = 0; i < numButtons; i++) {
-            if(gpio_get(i)) {
-                passwordInput[numInputs] = i;
-                numInputs++;
-                gpio_put(PICO_DEFAULT_LED_PIN, 1);
-                sleep_ms(500);
-                gpio_put(PICO_DEFAULT_LED_PIN, 0);
-                sleep_ms(500);
-            }
-            
-            //On 4th input will check to see if passcode is correct
-            if (numInputs == 4) {
-                numInputs = 0;
-                for (int j = 0; j < 4 && !wrongPassword; j++) {
-                    if (password[j] != passwordInput[j]) {
-                        wrongPassword = true;
-                    }
-                }
-
-                if (!wrongPassword) {
-                    authorizedPass = true;
-                } else {
-          	  wrongPassword = false;
-          	  for(int i=0; i<3; i++) {
-                	    gpio_put(PICO_DEFAULT_LED_PIN, 1);
-                	    sleep_ms(100);
-                	    gpio_put(PICO_DEFAULT_LED_PIN, 0);
-                	    sleep_ms(100);
-          	  }
-                }
-            }
-        }
+      tud_task();
+      unlock_task();
+      idle_until(next_wakeup());
     }
     while (authorizedPass) {
       tud_task(); // tinyusb device task
       led_blinking_task();
+      hid_typer_task(&typer);
       gpio_task();
+      worker_event_task();
+      cdc_task();
       lock_check_task();
+      idle_until(next_wakeup());
     }
   }
 }
 
+//--------------------------------------------------------------------+
+// IDLE
+//--------------------------------------------------------------------+
+
+// The next time a task has to run without an interrupt or core 1 to
+// prompt it: a blink or the lock button poll; while locked, only a change
+// of the PIN feedback on the LED.
+static absolute_time_t next_wakeup(void) {
+  uint32_t now = board_millis();
+  if (!authorizedPass) {
+    int32_t led_ms = pin_led_wait_ms(now);
+    return make_timeout_time_ms(led_ms >= 0 ? (uint32_t)led_ms : INT32_MAX);
+  }
+
+  int32_t wait_ms = (int32_t)(LOCK_CHECK_INTERVAL_MS - (now - lock_check_ms));
+  if (blink_interval_ms) {
+    int32_t blink_ms = (int32_t)(blink_interval_ms - (now - blink_start_ms));
+    if (blink_ms < wait_ms) wait_ms = blink_ms;
+  }
+  return make_timeout_time_ms(wait_ms > 0 ? (uint32_t)wait_ms : 0);
+}
+
+// Sleeps in __wfe() until 'deadline', an interrupt (USB, buttons) or an
+// event from core 1, unless TinyUSB already has work queued.
+static void idle_until(absolute_time_t deadline) {
+  if (tud_task_event_ready()) return;
+#ifdef POWER_TRACE
+  uint64_t start = time_us_64();
+  best_effort_wfe_or_timeout(deadline);
+  asleep_us += time_us_64() - start;
+#else
+  best_effort_wfe_or_timeout(deadline);
+#endif
+}
+
 //--------------------------------------------------------------------+
 // Device callbacks
 //--------------------------------------------------------------------+
@@ -209,6 +239,7 @@ void tud_mount_cb(void)
 void tud_umount_cb(void)
 {
   blink_interval_ms = BLINK_NOT_MOUNTED;
+  hid_typer_reset(&typer);
 }
 
 // Invoked when usb bus is suspended
@@ -231,6 +262,9 @@ void tud_resume_cb(void)
 // Lock Check Task
 //--------------------------------------------------------------------+
 void lock_check_task(void) {
+  if (board_millis() - lock_check_ms < LOCK_CHECK_INTERVAL_MS) return;
+  lock_check_ms = board_millis();
+
   uint32_t const btn = board_button_read();
   if(btn) {
 	blink_interval_ms = BLINK_MOUNTED;
@@ -238,208 +272,240 @@ void lock_check_task(void) {
   }
 }
 
-//--------------------------------------------------------------------+
-// DATA STORAGE
-//--------------------------------------------------------------------+
-void storeString () {
-    uint32_t userMult = 2 * (userChosen - 1) + usePass;
-    uint8_t* myDataAsBytes = (uint8_t*) &myData1;
-    int myDataSize = sizeof(myData1);
-    
-    uint32_t interrupts = save_and_disable_interrupts();
-    flash_range_erase(FLASH_TARGET_OFFSET + (4096 * userMult), 1);
-    flash_range_program(FLASH_TARGET_OFFSET + (4096 * userMult), myDataAsBytes, 1);
-    restore_interrupts(interrupts);
-}
-
-void readString() {
-    uint32_t userMult = 2 * (userChosen - 1) + usePass;
-    const uint8_t* flash_target_contents = (const uint8_t *) (XIP_BASE + FLASH_TARGET_OFFSET + (4096 * userMult));
-    memcpy(&myData, flash_target_contents, sizeof(myData1));
+// Milliseconds until the PIN feedback on the LED changes: a digit's flash
+// ends, or a lockout blink toggles. -1 if it is steady.
+static int32_t pin_led_wait_ms(uint32_t now) {
+  if (no_vault) return (int32_t)(PIN_NO_VAULT_BLINK_MS - now % PIN_NO_VAULT_BLINK_MS);
+  uint32_t lockout = pin_entry_lockout_left(&pin_entry, now);
+  if (lockout) {
+    return (int32_t)(lockout % PIN_LOCKOUT_BLINK_MS ? lockout % PIN_LOCKOUT_BLINK_MS
+                                                     : PIN_LOCKOUT_BLINK_MS);
+  }
+  if (pin_flash) {
+    uint32_t elapsed = now - pin_flash_start_ms;
+    if (elapsed < PIN_DIGIT_FLASH_MS) return (int32_t)(PIN_DIGIT_FLASH_MS - elapsed);
+    pin_flash = false;
+  }
+  return -1;
 }
 
-void programmer(uint32_t btn) {
+// Feeds single button presses to the PIN state machine as they arrive, and
+// hands each complete PIN to core 1, whose key check accepts or rejects it.
+// The LED flashes for each digit taken, stays on during the check and
+// blinks fast through a lockout, or slowly for good if there is no vault to
+// check against; nothing sleeps, so USB keeps being serviced.
+void unlock_task(void) {
+  uint32_t now = board_millis();
+
+  worker_evt evt;
+  if (worker_busy && worker_poll_event(&evt)) {
+    worker_busy = false;
+    if (evt.type == WORKER_EVT_NO_VAULT) {
+      // Not a wrong PIN, and no other PIN can do better until a reboot.
+      pin_entry_discard(&pin_entry);
+      no_vault = true;
+      printf("No vault: PIN not checked\n");
+    } else {
+      bool right = (evt.type == WORKER_EVT_DONE);
+      pin_entry_checked(&pin_entry, right, now);
+      if (right) {
+        authorizedPass = true;
+        blink_start_ms = now;
+        gpio_put(PICO_DEFAULT_LED_PIN, 0);
+        return;
+      }
+      printf("Wrong PIN: locked for %lu ms\n",
+             (unsigned long)pin_entry_lockout_left(&pin_entry, now));
+    }
+  }
 
-  uint32_t btn2 = (gpio_get(0));
-  for(int i=1; i<numButtons; i++) {
-      btn2 = btn2 | (gpio_get(i) << i);
+  buttons_event press;
+  if (no_vault) {
+    while (buttons_poll(&press)) {
+    }
+    gpio_put(PICO_DEFAULT_LED_PIN, (now / PIN_NO_VAULT_BLINK_MS) % 2 == 0);
+    return;
   }
 
-  char s[4096];
-  int i=0;
+  while (buttons_poll(&press)) {
+    // Chords and releases are not digits.
+    if (press.pressed == 0 || (press.pressed & (press.pressed - 1)) != 0) continue;
 
-  while(1) {
-    s[i] = uart_getc(UART_ID);
-    i++;
-    if(i == 4096){
-      break;
+    if (pin_entry_press(&pin_entry, (uint8_t)__builtin_ctz(press.pressed), now) ==
+        PIN_ENTRY_DIGIT) {
+      pin_flash = true;
+      pin_flash_start_ms = now;
     }
-    if(s[i-1] == ';'){
-      i--;
-      break;
+  }
+
+  size_t len;
+  bool checking = (pin_entry_digits(&pin_entry, &len) != NULL);
+  if (checking && !worker_busy) worker_unlock();
+
+  uint32_t lockout = pin_entry_lockout_left(&pin_entry, now);
+  bool led = lockout ? (lockout / PIN_LOCKOUT_BLINK_MS) % 2 == 0
+                     : checking || pin_led_wait_ms(now) > 0;
+  gpio_put(PICO_DEFAULT_LED_PIN, led);
+}
+
+//--------------------------------------------------------------------+
+// WORKER
+//--------------------------------------------------------------------+
+
+// Hands a command to core 1 unless one is already in flight.
+static void worker_request(uint8_t type) {
+  if (worker_busy) return;
+  worker_cmd cmd = { .type = type, .user = (uint8_t)userChosen, .use_pass = usePass };
+  if (worker_post(&cmd)) {
+    worker_busy = true;
+    if (type == WORKER_CMD_PROGRAM || type == WORKER_CMD_SET_TIME) {
+      gpio_put(PICO_DEFAULT_LED_PIN, 0);
     }
   }
+}
+
+// Hands the PIN just entered to core 1, which derives the vault key from it.
+// The digits stay in pin_entry until core 1 answers.
+void worker_unlock(void) {
+  size_t len;
+  const uint8_t *pin = pin_entry_digits(&pin_entry, &len);
+  if (pin == NULL) return;
+  worker_cmd cmd = { .type = WORKER_CMD_UNLOCK, .pin = pin, .pin_len = (uint8_t)len };
+  if (worker_post(&cmd)) {
+    worker_busy = true;
+  }
+}
+
+// Handles replies from core 1.
+void worker_event_task(void) {
+  // Text from core 1 is only valid until RELEASE, so keep the worker busy
+  // until the typer has finished with it; RELEASE's DONE then frees it.
+  if (worker_typing) {
+    if (hid_typer_busy(&typer)) return;
+    worker_cmd cmd = { .type = WORKER_CMD_RELEASE };
+    if (!worker_post(&cmd)) return;
+    worker_typing = false;
+  }
 
-  if(btn == 2) {
-    start_time_ms = board_millis();
-    unix_time = atoi(s);
-  } else {
-    s[i] = '\0';
-    strcpy(myData1, s);
-    storeString(); 
+  worker_evt evt;
+  while (worker_poll_event(&evt)) {
+    if (evt.type == WORKER_EVT_TEXT &&
+        hid_typer_start_stream(&typer, evt.text, evt.len, evt.ready)) {
+      worker_typing = true;
+      return;
+    }
+    if (userChosen != 0) {
+      gpio_put(PICO_DEFAULT_LED_PIN, 1);
+    }
+    worker_busy = false;
   }
 }
+
 //--------------------------------------------------------------------+
-// USB HID
+// USB CDC
 //--------------------------------------------------------------------+
 
-void send_key(uint8_t hid_send_key) {
-    waiter1:
-    if(!tud_hid_ready()) goto waiter1;
+// Moves provisioning bytes between the CDC interface and core 1, which
+// parses and answers them (see provision.h). Bytes are only taken from
+// TinyUSB while core 1 has room, so a slow flash write backs up into the
+// endpoint and the host is NAKed rather than data being lost.
+void cdc_task(void) {
+  worker_cdc_chunk chunk;
 
-    uint8_t mod = 0;
-    if((hid_send_key >= 65) && (hid_send_key <= 90)) {
-      mod = KEYBOARD_MODIFIER_LEFTSHIFT;
-    }
+  while (tud_cdc_available() && worker_cdc_can_push()) {
+    chunk.len = (uint8_t)tud_cdc_read(chunk.data, sizeof(chunk.data));
+    worker_cdc_push(&chunk);
+  }
 
-    switch(hid_send_key) {
-      // Numbers 0-9
-      case '1': hid_send_key = HID_KEY_1; break;
-      case '2': hid_send_key = HID_KEY_2; break;
-      case '3': hid_send_key = HID_KEY_3; break;
-      case '4': hid_send_key = HID_KEY_4; break;
-      case '5': hid_send_key = HID_KEY_5; break;
-      case '6': hid_send_key = HID_KEY_6; break;
-      case '7': hid_send_key = HID_KEY_7; break;
-      case '8': hid_send_key = HID_KEY_8; break;
-      case '9': hid_send_key = HID_KEY_9; break;
-      case '0': hid_send_key = HID_KEY_0; break;
-
-      // Lowercase letters a-z
-      case 'a': hid_send_key = HID_KEY_A; break;
-      case 'b': hid_send_key = HID_KEY_B; break;
-      case 'c': hid_send_key = HID_KEY_C; break;
-      case 'd': hid_send_key = HID_KEY_D; break;
-      case 'e': hid_send_key = HID_KEY_E; break;
-      case 'f': hid_send_key = HID_KEY_F; break;
-      case 'g': hid_send_key = HID_KEY_G; break;
-      case 'h': hid_send_key = HID_KEY_H; break;
-      case 'i': hid_send_key = HID_KEY_I; break;
-      case 'j': hid_send_key = HID_KEY_J; break;
-      case 'k': hid_send_key = HID_KEY_K; break;
-      case 'l': hid_send_key = HID_KEY_L; break;
-      case 'm': hid_send_key = HID_KEY_M; break;
-      case 'n': hid_send_key = HID_KEY_N; break;
-      case 'o': hid_send_key = HID_KEY_O; break;
-      case 'p': hid_send_key = HID_KEY_P; break;
-      case 'q': hid_send_key = HID_KEY_Q; break;
-      case 'r': hid_send_key = HID_KEY_R; break;
-      case 's': hid_send_key = HID_KEY_S; break;
-      case 't': hid_send_key = HID_KEY_T; break;
-      case 'u': hid_send_key = HID_KEY_U; break;
-      case 'v': hid_send_key = HID_KEY_V; break;
-      case 'w': hid_send_key = HID_KEY_W; break;
-      case 'x': hid_send_key = HID_KEY_X; break;
-      case 'y': hid_send_key = HID_KEY_Y; break;
-      case 'z': hid_send_key = HID_KEY_Z; break;
-
-      // Lowercase letters a-z
-      case 'A': hid_send_key = HID_KEY_A; break;
-      case 'B': hid_send_key = HID_KEY_B; break;
-      case 'C': hid_send_key = HID_KEY_C; break;
-      case 'D': hid_send_key = HID_KEY_D; break;
-      case 'E': hid_send_key = HID_KEY_E; break;
-      case 'F': hid_send_key = HID_KEY_F; break;
-      case 'G': hid_send_key = HID_KEY_G; break;
-      case 'H': hid_send_key = HID_KEY_H; break;
-      case 'I': hid_send_key = HID_KEY_I; break;
-      case 'J': hid_send_key = HID_KEY_J; break;
-      case 'K': hid_send_key = HID_KEY_K; break;
-      case 'L': hid_send_key = HID_KEY_L; break;
-      case 'M': hid_send_key = HID_KEY_M; break;
-      case 'N': hid_send_key = HID_KEY_N; break;
-      case 'O': hid_send_key = HID_KEY_O; break;
-      case 'P': hid_send_key = HID_KEY_P; break;
-      case 'Q': hid_send_key = HID_KEY_Q; break;
-      case 'R': hid_send_key = HID_KEY_R; break;
-      case 'S': hid_send_key = HID_KEY_S; break;
-      case 'T': hid_send_key = HID_KEY_T; break;
-      case 'U': hid_send_key = HID_KEY_U; break;
-      case 'V': hid_send_key = HID_KEY_V; break;
-      case 'W': hid_send_key = HID_KEY_W; break;
-      case 'X': hid_send_key = HID_KEY_X; break;
-      case 'Y': hid_send_key = HID_KEY_Y; break;
-      case 'Z': hid_send_key = HID_KEY_Z; break;
+  if (!tud_cdc_connected()) {
+    // Nobody is listening: drop replies rather than stall core 1.
+    while (worker_cdc_peek(&chunk)) {
+      worker_cdc_pop();
     }
+    return;
+  }
 
-    // Prepare the key report
-    uint8_t keycode[6] = {0};
-    keycode[0] = hid_send_key;
-
-    // Send key press
-    tud_hid_keyboard_report(REPORT_ID_KEYBOARD, mod, keycode);
-    sleep_ms(10); // Wait for key to be recognized
-    tud_task();
-    waiter2:
-    if(!tud_hid_ready()) goto waiter2;
-    tud_hid_keyboard_report(REPORT_ID_KEYBOARD, 0, NULL);
-    sleep_ms(10);
+  bool wrote = false;
+  while (worker_cdc_peek(&chunk) && tud_cdc_write_available() >= chunk.len) {
+    tud_cdc_write(chunk.data, chunk.len);
+    worker_cdc_pop();
+    wrote = true;
+  }
+  if (wrote) {
+    tud_cdc_write_flush();
+  }
 }
 
-void send_multiple_keys(char* string) {
-    for (size_t i = 0; i < strlen(string); i++) {
-        send_key(string[i]);
-	tud_task();
-    }
+//--------------------------------------------------------------------+
+// USB HID
+//--------------------------------------------------------------------+
+
+static bool send_keyboard_report(uint8_t modifier, const uint8_t keycode[6]) {
+    if (!tud_hid_ready()) return false;
+    return tud_hid_keyboard_report(REPORT_ID_KEYBOARD, modifier, keycode);
 }
 
-void gpio_task(void) {
-  // Poll every 10ms
-  const uint32_t interval_ms = 100;
-  static uint32_t start_ms = 0;
+// Invoked when a report has been sent to the host: queue the next keystroke.
+void tud_hid_report_complete_cb(uint8_t instance, uint8_t const* report, uint16_t len)
+{
+  (void) instance;
+  (void) report;
+  (void) len;
 
-  if ( board_millis() - start_ms < interval_ms) return; // not enough time
-  start_ms += interval_ms;
+  hid_typer_report_complete(&typer);
+}
 
-  uint32_t btn = (gpio_get(0));
-  for(int i=1; i<numButtons; i++) {
-  	btn = btn | (gpio_get(i) << i);
-  }
+// Acts once per settled change of the buttons held (see buttons.h), rather
+// than on every 100 ms poll while they are held. An account is chosen with
+// a chord of buttons 0-5, taken when they are all released so they need not
+// go down together; commands act as soon as their button is pressed.
+void gpio_task(void) {
+  buttons_event evt;
+  if (!buttons_poll(&evt)) return;
+  uint32_t btn = evt.pressed;
+  if (btn == 0 && evt.chord == 0) return;
 
   // Remote wakeup
   if ( tud_suspended() && btn ) {
     // Wake up host if we are in suspend mode
     // and REMOTE_WAKEUP feature is enabled by host
     tud_remote_wakeup();
-  } else if (btn && (btn<64) && (userChosen == 0)) {
+  } else if (evt.chord && (evt.chord<64) && (userChosen == 0)) {
         blink_interval_ms = 0;
         gpio_put(PICO_DEFAULT_LED_PIN, 1);
-  	userChosen = btn;
+  	userChosen = evt.chord;
   } else if (btn==128 && (userChosen != 0)) {
 	usePass = false;
-	readString();
-        send_multiple_keys(myData);
+	worker_request(WORKER_CMD_TYPE_SECRET);
   } else if (btn==64 && (userChosen != 0)) {
 	usePass = true;
-	readString();
-        send_multiple_keys(myData);
+	worker_request(WORKER_CMD_TYPE_SECRET);
   } else if (btn==32 && (userChosen != 0)) {
-	totp_task();
+	worker_request(WORKER_CMD_TOTP);
   } else if (btn==16 && (userChosen != 0)) {
-        gpio_put(PICO_DEFAULT_LED_PIN, 0);
 	usePass = false;
-        programmer(btn);
-        gpio_put(PICO_DEFAULT_LED_PIN, 1);
+	worker_request(WORKER_CMD_PROGRAM);
   } else if (btn==8 && (userChosen != 0)) {
-        gpio_put(PICO_DEFAULT_LED_PIN, 0);
 	usePass = true;
-        programmer(btn);
-        gpio_put(PICO_DEFAULT_LED_PIN, 1);
+	worker_request(WORKER_CMD_PROGRAM);
+  } else if (btn==4 && (userChosen != 0)) {
+	worker_request(WORKER_CMD_TYPE_OTP);
   } else if (btn==2 && (userChosen != 0)) {
-        gpio_put(PICO_DEFAULT_LED_PIN, 0);
-	programmer(btn);
-        gpio_put(PICO_DEFAULT_LED_PIN, 1);
+	worker_request(WORKER_CMD_SET_TIME);
   }
+
+#ifdef POWER_TRACE
+  // Edge to action, including the settle time; and how much of the time
+  // since boot each core has been awake.
+  uint64_t up_us = time_us_64();
+  uint64_t awake0 = (up_us - asleep_us) * 1000 / up_us;
+  uint64_t awake1 = (up_us - worker_asleep_us()) * 1000 / up_us;
+  printf("Button 0x%02lx: %lu us to act, awake core 0 %lu.%lu%%, core 1 %lu.%lu%%\n",
+         (unsigned long)(btn ? btn : evt.chord),
+         (unsigned long)(time_us_32() - evt.edge_us),
+         (unsigned long)(awake0 / 10), (unsigned long)(awake0 % 10),
+         (unsigned long)(awake1 / 10), (unsigned long)(awake1 % 10));
+#endif
 }
 
 // Invoked when received GET_REPORT control request
@@ -485,15 +551,14 @@ board_led_write(true);
 //--------------------------------------------------------------------+
 void led_blinking_task(void)
 {
-  static uint32_t start_ms = 0;
   static bool led_state = false;
 
   // blink is disabled
   if (!blink_interval_ms) return;
 
   // Blink every interval ms
-  if ( board_millis() - start_ms < blink_interval_ms) return; // not enough time
-  start_ms += blink_interval_ms;
+  if ( board_millis() - blink_start_ms < blink_interval_ms) return; // not enough time
+  blink_start_ms += blink_interval_ms;
 
   board_led_write(led_state);
   led_state = 1 - led_state; // toggle
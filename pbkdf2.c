@@ -0,0 +1,133 @@
+#include "pbkdf2.h"
+
+#include <string.h>
+
+#include "sha1.h"
+
+// Bit length of every message hashed after a midstate in the loop below:
+// one 64-byte pad block plus a 20-byte digest.
+#define HMAC_TAIL_BITS ((SHA1_BLOCK_SIZE + SHA1_DIGEST_SIZE) * 8)
+
+static void store_be32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static void store_digest(uint8_t *p, const uint32_t h[5]) {
+    for (int i = 0; i < 5; i++) {
+        store_be32(p + 4*i, h[i]);
+    }
+}
+
+// Both compressions of an iteration hash a 20-byte digest after a pad
+// block, so they share one final block, padded once up front: only its
+// first 20 bytes change. 'block' holds U(1) on entry; 't' accumulates
+// U(2) .. U(count + 1).
+static void iterate(const hmac_sha1_key *hkey, uint8_t block[SHA1_BLOCK_SIZE],
+                    uint32_t t[5], uint32_t count) {
+    uint32_t h[5];
+    for (uint32_t i = 0; i < count; i++) {
+        memcpy(h, hkey->inner.h, sizeof(h));
+        sha1_compress(h, block);
+        store_digest(block, h);
+        memcpy(h, hkey->outer.h, sizeof(h));
+        sha1_compress(h, block);
+        store_digest(block, h);
+        for (int j = 0; j < 5; j++) {
+            t[j] ^= h[j];
+        }
+    }
+    memset(h, 0, sizeof(h));
+}
+
+static void pad_block(uint8_t block[SHA1_BLOCK_SIZE]) {
+    memset(block + SHA1_DIGEST_SIZE, 0, SHA1_BLOCK_SIZE - SHA1_DIGEST_SIZE);
+    block[SHA1_DIGEST_SIZE] = 0x80;
+    block[62] = (uint8_t)(HMAC_TAIL_BITS >> 8);
+    block[63] = (uint8_t)HMAC_TAIL_BITS;
+}
+
+static void load_digest(uint32_t t[5], const uint8_t *p) {
+    for (int i = 0; i < 5; i++) {
+        t[i] = ((uint32_t)p[4*i] << 24) | ((uint32_t)p[4*i+1] << 16) |
+               ((uint32_t)p[4*i+2] << 8) | (uint32_t)p[4*i+3];
+    }
+}
+
+void pbkdf2_hmac_sha1(const uint8_t *password, size_t password_len,
+                      const uint8_t *salt, size_t salt_len, uint32_t iterations,
+                      uint8_t *out, size_t out_len) {
+    hmac_sha1_key hkey;
+    sha1_ctx ctx;
+    uint8_t block[SHA1_BLOCK_SIZE];
+    uint8_t inner[SHA1_DIGEST_SIZE];
+    uint32_t t[5];
+    hmac_sha1_setkey(&hkey, password, password_len);
+
+    for (uint32_t index = 1; out_len > 0; index++) {
+        // U(1) = HMAC(password, salt || INT(index)), streamed so the salt
+        // can be any length.
+        uint8_t be_index[4];
+        store_be32(be_index, index);
+        ctx = hkey.inner;
+        sha1_update(&ctx, salt, salt_len);
+        sha1_update(&ctx, be_index, sizeof(be_index));
+        sha1_final(&ctx, inner);
+        ctx = hkey.outer;
+        sha1_update(&ctx, inner, sizeof(inner));
+        sha1_final(&ctx, block);
+
+        pad_block(block);
+        load_digest(t, block);
+        if (iterations > 1) {
+            iterate(&hkey, block, t, iterations - 1);
+        }
+
+        store_digest(block, t);
+        size_t n = out_len < SHA1_DIGEST_SIZE ? out_len : SHA1_DIGEST_SIZE;
+        memcpy(out, block, n);
+        out += n;
+        out_len -= n;
+    }
+
+    // Don't leave key material on the stack.
+    memset(&hkey, 0, sizeof(hkey));
+    memset(&ctx, 0, sizeof(ctx));
+    memset(block, 0, sizeof(block));
+    memset(inner, 0, sizeof(inner));
+    memset(t, 0, sizeof(t));
+}
+
+uint32_t pbkdf2_rate(pbkdf2_clock_fn now_us, uint32_t sample_ms) {
+    static const uint8_t password[] = {0, 0, 0, 0};
+    hmac_sha1_key hkey;
+    uint8_t block[SHA1_BLOCK_SIZE] = {0};
+    uint32_t t[5] = {0};
+    hmac_sha1_setkey(&hkey, password, sizeof(password));
+    pad_block(block);
+
+    // Batches short enough to stop near the sample time, long enough that
+    // reading the clock doesn't count.
+    const uint32_t batch = 64;
+    uint64_t done = 0;
+    uint64_t start = now_us();
+    uint64_t elapsed;
+    do {
+        iterate(&hkey, block, t, batch);
+        done += batch;
+        elapsed = now_us() - start;
+    } while (elapsed < (uint64_t)sample_ms * 1000u);
+
+    uint64_t rate = done * 1000000u / elapsed;
+    return rate > UINT32_MAX ? UINT32_MAX : (uint32_t)rate;
+}
+
+uint32_t pbkdf2_iterations_for(uint32_t rate, uint32_t target_ms, size_t out_len) {
+    uint64_t blocks = (out_len + SHA1_DIGEST_SIZE - 1) / SHA1_DIGEST_SIZE;
+    if (blocks == 0) blocks = 1;
+    uint64_t n = (uint64_t)rate * target_ms / 1000u / blocks;
+    if (n < PBKDF2_MIN_ITERATIONS) n = PBKDF2_MIN_ITERATIONS;
+    return n > UINT32_MAX ? UINT32_MAX : (uint32_t)n;
+}
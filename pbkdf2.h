@@ -0,0 +1,31 @@
+#ifndef PBKDF2_H
+#define PBKDF2_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// PBKDF2 with HMAC-SHA1 (RFC 8018), for turning the unlock PIN into the
+// vault key. Each iteration costs two SHA-1 compressions: the HMAC ipad and
+// opad blocks are absorbed once per derivation, not once per iteration.
+
+// RFC 8018's recommended floor; pbkdf2_iterations_for() never goes below it.
+#define PBKDF2_MIN_ITERATIONS 1000
+
+// Monotonic clock in microseconds, for calibration.
+typedef uint64_t (*pbkdf2_clock_fn)(void);
+
+// Derives 'out_len' bytes from 'password' and 'salt' with 'iterations'
+// rounds. Every 20 bytes of output cost the full iteration count.
+void pbkdf2_hmac_sha1(const uint8_t *password, size_t password_len,
+                      const uint8_t *salt, size_t salt_len, uint32_t iterations,
+                      uint8_t *out, size_t out_len);
+
+// Measures how many iterations per second this CPU runs, timing batches of
+// them for at least 'sample_ms'.
+uint32_t pbkdf2_rate(pbkdf2_clock_fn now_us, uint32_t sample_ms);
+
+// Iteration count at which deriving an 'out_len'-byte key takes about
+// 'target_ms' on a CPU that runs 'rate' iterations per second.
+uint32_t pbkdf2_iterations_for(uint32_t rate, uint32_t target_ms, size_t out_len);
+
+#endif // PBKDF2_H
@@ -0,0 +1,64 @@
+#include "pin_entry.h"
+
+#include <string.h>
+
+void pin_entry_init(pin_entry_t *p, uint8_t pin_len) {
+  memset(p, 0, sizeof(*p));
+  p->pin_len = pin_len < PIN_ENTRY_MAX ? pin_len : PIN_ENTRY_MAX;
+  if (p->pin_len == 0) p->pin_len = 1;
+}
+
+static bool pin_entry_complete(const pin_entry_t *p) {
+  return p->input_len == p->pin_len;
+}
+
+uint32_t pin_entry_lockout_left(pin_entry_t *p, uint32_t now_ms) {
+  if (p->lockout_ms == 0) return 0;
+  uint32_t elapsed = now_ms - p->lockout_start_ms;
+  if (elapsed >= p->lockout_ms) {
+    p->lockout_ms = 0;
+    return 0;
+  }
+  return p->lockout_ms - elapsed;
+}
+
+pin_entry_result pin_entry_press(pin_entry_t *p, uint8_t digit, uint32_t now_ms) {
+  if (p->accepted || pin_entry_complete(p) || pin_entry_lockout_left(p, now_ms) != 0) {
+    return PIN_ENTRY_LOCKED;
+  }
+  p->input[p->input_len++] = digit;
+  return pin_entry_complete(p) ? PIN_ENTRY_COMPLETE : PIN_ENTRY_DIGIT;
+}
+
+const uint8_t *pin_entry_digits(const pin_entry_t *p, size_t *len) {
+  if (p->accepted || !pin_entry_complete(p)) return NULL;
+  *len = p->input_len;
+  return p->input;
+}
+
+void pin_entry_discard(pin_entry_t *p) {
+  memset(p->input, 0, sizeof(p->input));
+  p->input_len = 0;
+}
+
+void pin_entry_checked(pin_entry_t *p, bool right, uint32_t now_ms) {
+  pin_entry_discard(p);
+  if (right) {
+    p->accepted = true;
+    p->failures = 0;
+    return;
+  }
+
+  // 1 s, 2 s, 4 s, ... until the cap.
+  uint32_t lockout = PIN_ENTRY_LOCKOUT_BASE_MS;
+  for (uint32_t i = 0; i < p->failures && lockout < PIN_ENTRY_LOCKOUT_MAX_MS; i++) {
+    lockout *= 2;
+  }
+  if (p->failures < UINT32_MAX) p->failures++;
+  p->lockout_ms = lockout < PIN_ENTRY_LOCKOUT_MAX_MS ? lockout : PIN_ENTRY_LOCKOUT_MAX_MS;
+  p->lockout_start_ms = now_ms;
+}
+
+bool pin_entry_accepted(const pin_entry_t *p) {
+  return p->accepted;
+}
@@ -0,0 +1,67 @@
+#ifndef PIN_ENTRY_H
+#define PIN_ENTRY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Non-blocking PIN entry. Each button press is handed in with the current
+// time and answered at once; nothing sleeps, so the caller's loop keeps
+// servicing USB. The device holds no copy of the PIN: once all digits are in,
+// the caller checks them (by deriving the vault key, see vault_crypt.h) and
+// reports the outcome with pin_entry_checked(). Every wrong PIN locks input
+// out for twice as long as the previous lockout, up to
+// PIN_ENTRY_LOCKOUT_MAX_MS. Presses during a check or a lockout are dropped
+// and do not start a new attempt.
+
+#define PIN_ENTRY_MAX 16
+
+// Lockout after the first wrong PIN, and the most it doubles up to.
+#ifndef PIN_ENTRY_LOCKOUT_BASE_MS
+#define PIN_ENTRY_LOCKOUT_BASE_MS 1000
+#endif
+#ifndef PIN_ENTRY_LOCKOUT_MAX_MS
+#define PIN_ENTRY_LOCKOUT_MAX_MS (15u * 60u * 1000u)
+#endif
+
+typedef enum {
+  PIN_ENTRY_DIGIT,      // taken; the PIN is not complete yet
+  PIN_ENTRY_COMPLETE,   // taken, and the PIN is complete: check it
+  PIN_ENTRY_LOCKED,     // dropped: being checked, locked out, or accepted
+} pin_entry_result;
+
+typedef struct {
+  uint8_t pin_len;
+  uint8_t input[PIN_ENTRY_MAX];
+  uint8_t input_len;
+  bool accepted;
+  uint32_t failures;    // wrong PINs since the last right one
+  uint32_t lockout_start_ms;
+  uint32_t lockout_ms;  // 0 when not locked out
+} pin_entry_t;
+
+// Sets up entry of PINs of 'pin_len' digits (at most PIN_ENTRY_MAX).
+void pin_entry_init(pin_entry_t *p, uint8_t pin_len);
+
+// Takes one digit pressed at 'now_ms'.
+pin_entry_result pin_entry_press(pin_entry_t *p, uint8_t digit, uint32_t now_ms);
+
+// The digits of a complete PIN awaiting its check, or NULL if there is none.
+// They stay valid until pin_entry_checked().
+const uint8_t *pin_entry_digits(const pin_entry_t *p, size_t *len);
+
+// Records whether the complete PIN was right and wipes its digits. A wrong
+// one starts a lockout at 'now_ms'.
+void pin_entry_checked(pin_entry_t *p, bool right, uint32_t now_ms);
+
+// Wipes the digits of a complete PIN that could not be checked at all,
+// without counting it as wrong.
+void pin_entry_discard(pin_entry_t *p);
+
+// Milliseconds until input is taken again, or 0 if it is now.
+uint32_t pin_entry_lockout_left(pin_entry_t *p, uint32_t now_ms);
+
+// Whether a right PIN has been entered.
+bool pin_entry_accepted(const pin_entry_t *p);
+
+#endif // PIN_ENTRY_H
@@ -0,0 +1,328 @@
+#include "provision.h"
+
+#include <string.h>
+
+#include "account.h"
+#include "account_index.h"
+#include "crc32.h"
+#include "totp.h"
+#include "vault.h"
+#include "vault_crypt.h"
+
+enum {
+    ST_SYNC0,
+    ST_SYNC1,
+    ST_HEADER,
+    ST_BODY,
+};
+
+static uint16_t get_le16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_le32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put_le16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_le32(uint8_t *p, uint32_t v) {
+    put_le16(p, (uint16_t)v);
+    put_le16(p + 2, (uint16_t)(v >> 16));
+}
+
+size_t provision_frame(uint8_t *out, uint8_t type, uint8_t seq,
+                       const uint8_t *payload, size_t len) {
+    out[0] = PROVISION_SYNC0;
+    out[1] = PROVISION_SYNC1;
+    out[2] = type;
+    out[3] = seq;
+    put_le16(out + 4, (uint16_t)len);
+    if (len > 0 && payload != out + 6) {
+        memmove(out + 6, payload, len);
+    }
+    put_le32(out + 6 + len, crc32_update(0, out + 2, 4 + len));
+    return len + PROVISION_FRAME_OVERHEAD;
+}
+
+//--------------------------------------------------------------------+
+// Replies
+//--------------------------------------------------------------------+
+
+// Reply payloads are built in place, after the reply frame header.
+static uint8_t *reply_payload(provision_t *p) {
+    return p->reply + 6;
+}
+
+static void send_reply(provision_t *p, uint8_t type, uint8_t seq, size_t len) {
+    size_t n = provision_frame(p->reply, type, seq, reply_payload(p), len);
+    p->io.write(p->reply, n);
+}
+
+static void send_status(provision_t *p, uint8_t type, uint8_t seq, uint8_t status) {
+    reply_payload(p)[0] = status;
+    send_reply(p, type, seq, 1);
+}
+
+// ACKs a request and keeps the status for when the ACK is lost and the
+// request comes again.
+static void send_ack(provision_t *p, uint8_t seq, uint8_t status) {
+    p->status[seq & (PROVISION_WINDOW - 1)] = status;
+    send_status(p, PROVISION_ACK, seq, status);
+}
+
+static void send_nak(provision_t *p, uint8_t status) {
+    if (p->nak_sent) return;
+    p->nak_sent = true;
+    send_status(p, PROVISION_NAK, p->expected, status);
+}
+
+//--------------------------------------------------------------------+
+// Requests
+//--------------------------------------------------------------------+
+
+static void begin_write(provision_t *p) {
+    if (!p->dirty) {
+        vault_batch_begin();
+        p->dirty = true;
+    }
+}
+
+static void handle_hello(provision_t *p, uint8_t seq) {
+    uint8_t *out = reply_payload(p);
+    out[0] = PROVISION_VERSION;
+    out[1] = PROVISION_WINDOW;
+    put_le16(out + 2, PROVISION_MAX_PAYLOAD);
+    put_le16(out + 4, (uint16_t)account_index_count());
+    put_le16(out + 6, ACCOUNT_MAX);
+    send_reply(p, PROVISION_DATA, seq, 8);
+}
+
+static uint8_t handle_put(provision_t *p, const uint8_t *data, size_t len) {
+    account acc;
+    if (len < 2) return PROVISION_ERR_ARG;
+    uint16_t id = get_le16(data);
+    if (id >= ACCOUNT_MAX || account_decode(data + 2, len - 2, &acc) != 0 ||
+        acc.totp_digits > TOTP_MAX_DIGITS) {
+        return PROVISION_ERR_ARG;
+    }
+    begin_write(p);
+    return account_store(id, &acc) == 0 ? PROVISION_OK : PROVISION_ERR_FULL;
+}
+
+static uint8_t handle_delete(provision_t *p, const uint8_t *data, size_t len) {
+    if (len != 2) return PROVISION_ERR_ARG;
+    begin_write(p);
+    return account_remove(get_le16(data)) == 0 ? PROVISION_OK : PROVISION_ERR_FULL;
+}
+
+static void handle_list(provision_t *p, uint8_t seq, const uint8_t *data, size_t len) {
+    if (len != 2) {
+        send_status(p, PROVISION_ACK, seq, PROVISION_ERR_ARG);
+        return;
+    }
+    uint8_t *out = reply_payload(p);
+    size_t total = account_index_count();
+    size_t pos = get_le16(data);
+    size_t n = 4;
+
+    for (; pos < total; pos++) {
+        uint16_t id = account_index_at(pos);
+        size_t rec_len;
+        account acc;
+        const uint8_t *rec = vault_get(ACCOUNT_KEY_BASE + id, &rec_len);
+        if (rec == NULL || account_decode(rec, rec_len, &acc) != 0) continue;
+
+        size_t name_len = acc.name_len > 255 ? 255 : acc.name_len;
+        if (n + 7 + name_len > PROVISION_MAX_PAYLOAD) break;
+        put_le16(out + n, id);
+        put_le32(out + n + 2, account_plain_crc(rec, rec_len));
+        out[n + 6] = (uint8_t)name_len;
+        memcpy(out + n + 7, acc.name, name_len);
+        n += 7 + name_len;
+    }
+    put_le16(out, (uint16_t)total);
+    put_le16(out + 2, (uint16_t)get_le16(data));
+    send_reply(p, PROVISION_DATA, seq, n);
+}
+
+static void handle_find(provision_t *p, uint8_t seq, const uint8_t *data, size_t len) {
+    size_t first;
+    size_t count = account_index_prefix((const char *)data, len, &first);
+    uint8_t *out = reply_payload(p);
+    put_le16(out, (uint16_t)count);
+    put_le16(out + 2, (uint16_t)first);
+    send_reply(p, PROVISION_DATA, seq, 4);
+}
+
+static void handle_get(provision_t *p, uint8_t seq, const uint8_t *data, size_t len) {
+    size_t rec_len;
+    const uint8_t *rec = NULL;
+    if (len == 2 && get_le16(data) < ACCOUNT_MAX) {
+        rec = vault_get(ACCOUNT_KEY_BASE + get_le16(data), &rec_len);
+    }
+    int n = rec ? account_export(rec, rec_len, reply_payload(p), PROVISION_MAX_PAYLOAD) : -1;
+    if (n < 0) {
+        send_status(p, PROVISION_ACK, seq, rec ? PROVISION_ERR_ARG : PROVISION_ERR_NOT_FOUND);
+        return;
+    }
+    send_reply(p, PROVISION_DATA, seq, (size_t)n);
+}
+
+// Repeats of requests from before this session get ERR_SEQ, not a stale status.
+static void reset_status(provision_t *p) {
+    memset(p->status, PROVISION_ERR_SEQ, sizeof(p->status));
+}
+
+static bool is_query(uint8_t type) {
+    return type == PROVISION_LIST || type == PROVISION_FIND || type == PROVISION_GET;
+}
+
+static void handle_frame(provision_t *p, uint8_t type, uint8_t seq,
+                         const uint8_t *data, size_t len) {
+    if (type == PROVISION_HELLO) {
+        p->expected = (uint8_t)(seq + 1);
+        p->nak_sent = false;
+        reset_status(p);
+        handle_hello(p, seq);
+        return;
+    }
+
+    if (seq != p->expected) {
+        // A resent frame we already handled: its reply was probably lost.
+        uint8_t behind = (uint8_t)(p->expected - seq);
+        if (behind >= 1 && behind <= PROVISION_WINDOW) {
+            if (!is_query(type)) {
+                send_status(p, PROVISION_ACK, seq, p->status[seq & (PROVISION_WINDOW - 1)]);
+                return;
+            }
+        } else {
+            send_nak(p, PROVISION_ERR_SEQ);
+            return;
+        }
+    } else {
+        p->expected++;
+        p->nak_sent = false;
+    }
+
+    if (!vault_crypt_unlocked() && type != PROVISION_SET_TIME) {
+        send_ack(p, seq, PROVISION_ERR_LOCKED);
+        return;
+    }
+
+    uint8_t status = PROVISION_OK;
+    switch (type) {
+        case PROVISION_COMMIT:
+            vault_batch_end();
+            p->dirty = false;
+            break;
+        case PROVISION_PUT:
+            status = handle_put(p, data, len);
+            break;
+        case PROVISION_DELETE:
+            status = handle_delete(p, data, len);
+            break;
+        case PROVISION_SET_TIME:
+            if (len != 4) {
+                status = PROVISION_ERR_ARG;
+            } else if (p->io.set_time) {
+                p->io.set_time(get_le32(data));
+            }
+            break;
+        case PROVISION_LIST:
+            handle_list(p, seq, data, len);
+            return;
+        case PROVISION_FIND:
+            handle_find(p, seq, data, len);
+            return;
+        case PROVISION_GET:
+            handle_get(p, seq, data, len);
+            return;
+        default:
+            status = PROVISION_ERR_TYPE;
+            break;
+    }
+    send_ack(p, seq, status);
+}
+
+//--------------------------------------------------------------------+
+// Framing
+//--------------------------------------------------------------------+
+
+void provision_init(provision_t *p, const provision_io *io) {
+    memset(p, 0, sizeof(*p));
+    p->io = *io;
+    p->state = ST_SYNC0;
+    reset_status(p);
+}
+
+void provision_input(provision_t *p, const uint8_t *data, size_t len, uint32_t now_ms) {
+    if (len > 0) {
+        p->last_rx_ms = now_ms;
+    }
+
+    while (len > 0) {
+        uint8_t b = *data;
+        switch (p->state) {
+            case ST_SYNC0:
+                if (b == PROVISION_SYNC0) p->state = ST_SYNC1;
+                data++;
+                len--;
+                break;
+
+            case ST_SYNC1:
+                p->state = (b == PROVISION_SYNC1) ? ST_HEADER : (b == PROVISION_SYNC0 ? ST_SYNC1 : ST_SYNC0);
+                p->got = 0;
+                data++;
+                len--;
+                break;
+
+            case ST_HEADER:
+                p->header[p->got++] = b;
+                data++;
+                len--;
+                if (p->got == sizeof(p->header)) {
+                    p->len = get_le16(p->header + 2);
+                    p->got = 0;
+                    if (p->len > PROVISION_MAX_PAYLOAD) {
+                        send_nak(p, PROVISION_ERR_ARG);
+                        p->state = ST_SYNC0;
+                    } else {
+                        p->state = ST_BODY;
+                    }
+                }
+                break;
+
+            case ST_BODY: {
+                // Payload and CRC, copied in runs.
+                size_t want = p->len + 4 - p->got;
+                size_t n = len < want ? len : want;
+                memcpy(p->frame + p->got, data, n);
+                p->got += n;
+                data += n;
+                len -= n;
+                if (p->got < p->len + 4) break;
+
+                p->state = ST_SYNC0;
+                uint32_t crc = crc32_update(0, p->header, sizeof(p->header));
+                crc = crc32_update(crc, p->frame, p->len);
+                if (crc != get_le32(p->frame + p->len)) {
+                    send_nak(p, PROVISION_ERR_CRC);
+                } else {
+                    handle_frame(p, p->header[0], p->header[1], p->frame, p->len);
+                }
+                break;
+            }
+        }
+    }
+}
+
+void provision_poll(provision_t *p, uint32_t now_ms) {
+    if (p->dirty && now_ms - p->last_rx_ms >= PROVISION_IDLE_FLUSH_MS) {
+        vault_batch_end();
+        p->dirty = false;
+    }
+}
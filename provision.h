@@ -0,0 +1,114 @@
+#ifndef PROVISION_H
+#define PROVISION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Framed binary provisioning protocol, carried over the USB CDC interface.
+//
+// Every frame, in both directions:
+//
+//   sync(2) = A5 5A | type(1) | seq(1) | len(2, LE) | payload(len) | crc(4, LE)
+//
+// The CRC-32 covers type, seq, len and payload. The host may have up to
+// PROVISION_WINDOW requests outstanding. The device handles requests strictly
+// in sequence order and answers each one with an ACK, or a DATA frame for
+// queries, carrying the request's seq. A corrupt or out-of-order frame gets a
+// NAK carrying the next expected seq, and the host resends from there
+// (go-back-N). Repeats of requests that were already handled are ACKed again
+// with the status they first got, without being applied twice.
+//
+// Writes go through a vault batch, so each flash page is programmed once per
+// sector's worth of records. They are durable once COMMIT is ACKed, or after
+// the link has been idle for PROVISION_IDLE_FLUSH_MS.
+//
+// Requests (host to device) and their payloads:
+//   HELLO                            -> DATA: version(1) window(1)
+//                                       max_payload(2) accounts(2) capacity(2)
+//                                       Restarts sequencing at this frame's seq.
+//   COMMIT                           -> ACK once everything is in flash
+//   PUT       id(2) record(TLV)      -> ACK; record is an account_encode() blob
+//   DELETE    id(2)                  -> ACK
+//   LIST      pos(2)                 -> DATA: total(2) pos(2) then, in name
+//                                       order, { id(2) crc(4) name_len(1) name }
+//                                       for as many accounts as fit
+//   FIND      prefix                 -> DATA: count(2) first_pos(2)
+//   GET       id(2)                  -> DATA: record(TLV)
+//   SET_TIME  unix_time(4)           -> ACK
+// All multi-byte fields are little-endian. Records travel in plaintext, as
+// account_encode() produces them; the device encrypts them at rest. 'crc' in
+// LIST is the CRC-32 of that plaintext form, so a host can tell which
+// accounts differ. While the vault is locked every request but HELLO and
+// SET_TIME is answered with an ACK carrying PROVISION_ERR_LOCKED.
+
+#define PROVISION_VERSION 1
+#define PROVISION_WINDOW 8   // a power of two
+#define PROVISION_MAX_PAYLOAD 1024
+#define PROVISION_FRAME_OVERHEAD 10
+#define PROVISION_IDLE_FLUSH_MS 200
+
+#define PROVISION_SYNC0 0xA5
+#define PROVISION_SYNC1 0x5A
+
+enum {
+    PROVISION_HELLO    = 0x01,
+    PROVISION_COMMIT   = 0x02,
+    PROVISION_PUT      = 0x10,
+    PROVISION_DELETE   = 0x11,
+    PROVISION_LIST     = 0x12,
+    PROVISION_FIND     = 0x13,
+    PROVISION_GET      = 0x14,
+    PROVISION_SET_TIME = 0x15,
+
+    PROVISION_ACK      = 0x80,   // payload: status(1)
+    PROVISION_NAK      = 0x81,   // payload: status(1); seq is the one expected
+    PROVISION_DATA     = 0x82,
+};
+
+enum {
+    PROVISION_OK = 0,
+    PROVISION_ERR_CRC,
+    PROVISION_ERR_SEQ,
+    PROVISION_ERR_ARG,
+    PROVISION_ERR_FULL,
+    PROVISION_ERR_TYPE,
+    PROVISION_ERR_NOT_FOUND,
+    PROVISION_ERR_LOCKED,
+};
+
+// Where the engine sends reply bytes, and what it does with SET_TIME.
+typedef struct {
+    void (*write)(const uint8_t *data, size_t len);
+    void (*set_time)(uint32_t unix_time);   // may be NULL
+} provision_io;
+
+typedef struct {
+    provision_io io;
+    uint8_t state;
+    uint8_t header[4];               // type, seq, len
+    size_t got;                      // bytes of the current part received
+    size_t len;                      // payload length of the current frame
+    uint8_t frame[PROVISION_MAX_PAYLOAD + 4];
+    uint8_t expected;                // next seq to apply
+    bool nak_sent;                   // one NAK per gap until it is repaired
+    uint8_t status[PROVISION_WINDOW]; // ACKed status by seq, for repeats
+    bool dirty;                      // writes staged since the last flush
+    uint32_t last_rx_ms;
+    uint8_t reply[PROVISION_MAX_PAYLOAD + PROVISION_FRAME_OVERHEAD];
+} provision_t;
+
+void provision_init(provision_t *p, const provision_io *io);
+
+// Feeds received bytes; any number at a time, split anywhere.
+void provision_input(provision_t *p, const uint8_t *data, size_t len, uint32_t now_ms);
+
+// Flushes staged writes once the link has been idle for a while.
+void provision_poll(provision_t *p, uint32_t now_ms);
+
+// Builds a frame into 'out' (which needs len + PROVISION_FRAME_OVERHEAD
+// bytes) and returns its size. Shared with host tools.
+size_t provision_frame(uint8_t *out, uint8_t type, uint8_t seq,
+                       const uint8_t *payload, size_t len);
+
+#endif // PROVISION_H
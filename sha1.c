@@ -1,147 +1,259 @@
 #include "sha1.h"
-#include <stdlib.h>
 #include <string.h>
-#include <stdio.h>
+
+// SHA1_UNROLLED selects the unrolled compression kernel (default). Build with
+// -DSHA1_UNROLLED=0 for the smaller looped kernel when flash is tight.
+#ifndef SHA1_UNROLLED
+#define SHA1_UNROLLED 1
+#endif
+
+#if defined(PICO_ON_DEVICE) && PICO_ON_DEVICE
+#include "pico.h"
+#define SHA1_KERNEL_ATTR(name) __not_in_flash_func(name)
+#else
+#define SHA1_KERNEL_ATTR(name) name
+#endif
 
 // Helper: Left-rotate a 32-bit integer 'value' by 'count' bits.
-static uint32_t leftrotate(uint32_t value, unsigned int count) {
-return (value << count) | (value >> (32 - count));
+static inline uint32_t leftrotate(uint32_t value, unsigned int count) {
+    return (value << count) | (value >> (32 - count));
 }
 
-void sha1(const uint8_t *msg, size_t len, uint8_t *digest) {
-// Initial hash constants.
-uint32_t h0 = 0x67452301;
-uint32_t h1 = 0xEFCDAB89;
-uint32_t h2 = 0x98BADCFE;
-uint32_t h3 = 0x10325476;
-uint32_t h4 = 0xC3D2E1F0;
-
-uint64_t bit_len = len * 8;
-size_t new_len = len + 1;
-while (new_len % 64 != 56)
-new_len++;
-new_len += 8;
-
-uint8_t *msg_padded = (uint8_t*)calloc(new_len, sizeof(uint8_t));
-if (!msg_padded) {
-fprintf(stderr, "Memory allocation error\n");
-exit(1);
+// Reads a 32-bit big-endian word.
+static inline uint32_t load_be32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] << 8) | (uint32_t)p[3];
 }
-memcpy(msg_padded, msg, len);
-msg_padded[len] = 0x80; // Append the '1' bit
 
-// Append the original message length (in bits) as a 64-bit big-endian integer.
-for (int i = 0; i < 8; i++) {
-msg_padded[new_len - 1 - i] = (uint8_t)((bit_len >> (8 * i)) & 0xFF);
-}
+#if SHA1_UNROLLED
 
-size_t chunk_count = new_len / 64;
-for (size_t i = 0; i < chunk_count; i++) {
-uint32_t w[80];
-// Break chunk into sixteen 32-bit big-endian words.
-for (int j = 0; j < 16; j++) {
-size_t index = i * 64 + j * 4;
-w[j] = ((uint32_t)msg_padded[index] << 24) |
-((uint32_t)msg_padded[index+1] << 16) |
-((uint32_t)msg_padded[index+2] << 8) |
-((uint32_t)msg_padded[index+3]);
-}
-// Extend the sixteen words into eighty words.
-for (int j = 16; j < 80; j++) {
-w[j] = leftrotate(w[j-3] ^ w[j-8] ^ w[j-14] ^ w[j-16], 1);
-}
+// Round functions for the four groups of 20 rounds.
+#define SHA1_F0(b, c, d) ((d) ^ ((b) & ((c) ^ (d))))
+#define SHA1_F1(b, c, d) ((b) ^ (c) ^ (d))
+#define SHA1_F2(b, c, d) (((b) & (c)) | ((d) & ((b) | (c))))
+#define SHA1_F3(b, c, d) ((b) ^ (c) ^ (d))
+
+// Message schedule kept in a 16-word ring: w[j] = rol1(w[j-3] ^ w[j-8] ^ w[j-14] ^ w[j-16]).
+#define SHA1_W(j)  (w[(j) & 15])
+#define SHA1_WX(j) (SHA1_W(j) = leftrotate(SHA1_W((j) + 13) ^ SHA1_W((j) + 8) ^ \
+                                           SHA1_W((j) + 2) ^ SHA1_W(j), 1))
+
+// One round; the caller rotates the variable names instead of moving values.
+#define SHA1_ROUND(a, b, c, d, e, f, k, x) \
+    do { \
+        (e) += leftrotate((a), 5) + f((b), (c), (d)) + (k) + (x); \
+        (b) = leftrotate((b), 30); \
+    } while (0)
+
+#define SHA1_R0(a, b, c, d, e, j) SHA1_ROUND(a, b, c, d, e, SHA1_F0, 0x5A827999, SHA1_W(j))
+#define SHA1_R1(a, b, c, d, e, j) SHA1_ROUND(a, b, c, d, e, SHA1_F0, 0x5A827999, SHA1_WX(j))
+#define SHA1_R2(a, b, c, d, e, j) SHA1_ROUND(a, b, c, d, e, SHA1_F1, 0x6ED9EBA1, SHA1_WX(j))
+#define SHA1_R3(a, b, c, d, e, j) SHA1_ROUND(a, b, c, d, e, SHA1_F2, 0x8F1BBCDC, SHA1_WX(j))
+#define SHA1_R4(a, b, c, d, e, j) SHA1_ROUND(a, b, c, d, e, SHA1_F3, 0xCA62C1D6, SHA1_WX(j))
+
+// Five rounds, after which the variables are back in their original roles.
+#define SHA1_R5(R, j) \
+    do { \
+        R(a, b, c, d, e, (j)); \
+        R(e, a, b, c, d, (j) + 1); \
+        R(d, e, a, b, c, (j) + 2); \
+        R(c, d, e, a, b, (j) + 3); \
+        R(b, c, d, e, a, (j) + 4); \
+    } while (0)
 
-// Initialize working variables.
-uint32_t a = h0, b = h1, c = h2, d = h3, e = h4;
-for (int j = 0; j < 80; j++) {
-uint32_t f, k;
-if (j < 20) {
-f = (b & c) | ((~b) & d);
-k = 0x5A827999;
-} else if (j < 40) {
-f = b ^ c ^ d;
-k = 0x6ED9EBA1;
-} else if (j < 60) {
-f = (b & c) | (b & d) | (c & d);
-k = 0x8F1BBCDC;
-} else {
-f = b ^ c ^ d;
-k = 0xCA62C1D6;
+// Processes one 64-byte block, updating the chaining value 'h'.
+// Fully unrolled with a rolling 16-word schedule: no per-round branches and
+// 64 bytes of schedule on the stack instead of 320. On the Pico the kernel is
+// placed in SRAM so the unrolled body doesn't contend for the XIP cache.
+void SHA1_KERNEL_ATTR(sha1_compress)(uint32_t h[5], const uint8_t *block) {
+    uint32_t w[16];
+    for (int j = 0; j < 16; j++) {
+        w[j] = load_be32(block + 4*j);
+    }
+
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+
+    SHA1_R5(SHA1_R0, 0);  SHA1_R5(SHA1_R0, 5);  SHA1_R5(SHA1_R0, 10);
+    SHA1_R0(a, b, c, d, e, 15);
+    SHA1_R1(e, a, b, c, d, 16); SHA1_R1(d, e, a, b, c, 17);
+    SHA1_R1(c, d, e, a, b, 18); SHA1_R1(b, c, d, e, a, 19);
+
+    SHA1_R5(SHA1_R2, 20); SHA1_R5(SHA1_R2, 25); SHA1_R5(SHA1_R2, 30); SHA1_R5(SHA1_R2, 35);
+    SHA1_R5(SHA1_R3, 40); SHA1_R5(SHA1_R3, 45); SHA1_R5(SHA1_R3, 50); SHA1_R5(SHA1_R3, 55);
+    SHA1_R5(SHA1_R4, 60); SHA1_R5(SHA1_R4, 65); SHA1_R5(SHA1_R4, 70); SHA1_R5(SHA1_R4, 75);
+
+    // Add the chunk's hash to the result.
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
 }
-uint32_t temp = leftrotate(a, 5) + f + e + k + w[j];
-e = d;
-d = c;
-c = leftrotate(b, 30);
-b = a;
-a = temp;
+
+#else // !SHA1_UNROLLED
+
+// Processes one 64-byte block, updating the chaining value 'h'.
+// Compact portable version: same rolling schedule, one round per iteration.
+void sha1_compress(uint32_t h[5], const uint8_t *block) {
+    uint32_t w[16];
+    for (int j = 0; j < 16; j++) {
+        w[j] = load_be32(block + 4*j);
+    }
+
+    // Initialize working variables.
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int j = 0; j < 80; j++) {
+        uint32_t f, k;
+        if (j >= 16) {
+            w[j & 15] = leftrotate(w[(j + 13) & 15] ^ w[(j + 8) & 15] ^
+                                   w[(j + 2) & 15] ^ w[j & 15], 1);
+        }
+        if (j < 20) {
+            f = d ^ (b & (c ^ d));
+            k = 0x5A827999;
+        } else if (j < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if (j < 60) {
+            f = (b & c) | (d & (b | c));
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        uint32_t temp = leftrotate(a, 5) + f + e + k + w[j & 15];
+        e = d;
+        d = c;
+        c = leftrotate(b, 30);
+        b = a;
+        a = temp;
+    }
+    // Add the chunk's hash to the result.
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
 }
-// Add the chunk's hash to the result.
-h0 += a; h1 += b; h2 += c; h3 += d; h4 += e;
+
+#endif // SHA1_UNROLLED
+
+void sha1_init(sha1_ctx *ctx) {
+    // Initial hash constants.
+    ctx->h[0] = 0x67452301;
+    ctx->h[1] = 0xEFCDAB89;
+    ctx->h[2] = 0x98BADCFE;
+    ctx->h[3] = 0x10325476;
+    ctx->h[4] = 0xC3D2E1F0;
+    ctx->total_len = 0;
+    ctx->block_len = 0;
 }
-free(msg_padded);
-
-// Produce the final hash value in big-endian format.
-digest[0] = (uint8_t)((h0 >> 24) & 0xFF);
-digest[1] = (uint8_t)((h0 >> 16) & 0xFF);
-digest[2] = (uint8_t)((h0 >> 8) & 0xFF);
-digest[3] = (uint8_t)(h0 & 0xFF);
-digest[4] = (uint8_t)((h1 >> 24) & 0xFF);
-digest[5] = (uint8_t)((h1 >> 16) & 0xFF);
-digest[6] = (uint8_t)((h1 >> 8) & 0xFF);
-digest[7] = (uint8_t)(h1 & 0xFF);
-digest[8] = (uint8_t)((h2 >> 24) & 0xFF);
-digest[9] = (uint8_t)((h2 >> 16) & 0xFF);
-digest[10] = (uint8_t)((h2 >> 8) & 0xFF);
-digest[11] = (uint8_t)(h2 & 0xFF);
-digest[12] = (uint8_t)((h3 >> 24) & 0xFF);
-digest[13] = (uint8_t)((h3 >> 16) & 0xFF);
-digest[14] = (uint8_t)((h3 >> 8) & 0xFF);
-digest[15] = (uint8_t)(h3 & 0xFF);
-digest[16] = (uint8_t)((h4 >> 24) & 0xFF);
-digest[17] = (uint8_t)((h4 >> 16) & 0xFF);
-digest[18] = (uint8_t)((h4 >> 8) & 0xFF);
-digest[19] = (uint8_t)(h4 & 0xFF);
+
+void sha1_update(sha1_ctx *ctx, const uint8_t *msg, size_t len) {
+    ctx->total_len += len;
+
+    // Top up a partially filled block first.
+    if (ctx->block_len > 0) {
+        size_t take = SHA1_BLOCK_SIZE - ctx->block_len;
+        if (take > len) take = len;
+        memcpy(ctx->block + ctx->block_len, msg, take);
+        ctx->block_len += take;
+        msg += take;
+        len -= take;
+        if (ctx->block_len < SHA1_BLOCK_SIZE) return;
+        sha1_compress(ctx->h, ctx->block);
+        ctx->block_len = 0;
+    }
+
+    // Whole blocks are hashed straight from the caller's buffer.
+    while (len >= SHA1_BLOCK_SIZE) {
+        sha1_compress(ctx->h, msg);
+        msg += SHA1_BLOCK_SIZE;
+        len -= SHA1_BLOCK_SIZE;
+    }
+
+    memcpy(ctx->block, msg, len);
+    ctx->block_len = len;
 }
 
-void hmac_sha1(const uint8_t *key, size_t key_len,
-const uint8_t *msg, size_t msg_len,
-uint8_t *digest) {
-const size_t block_size = 64;
-uint8_t key_block[64];
-uint8_t ipad[64];
-uint8_t opad[64];
-
-// If key is longer than block_size, hash it first.
-if (key_len > block_size) {
-sha1(key, key_len, key_block);
-memset(key_block + 20, 0, block_size - 20);
-} else {
-memcpy(key_block, key, key_len);
-memset(key_block + key_len, 0, block_size - key_len);
+void sha1_final(sha1_ctx *ctx, uint8_t *digest) {
+    uint64_t bit_len = ctx->total_len * 8;
+
+    // Append the '1' bit, then zeros up to 56 bytes into the last block.
+    ctx->block[ctx->block_len++] = 0x80;
+    if (ctx->block_len > 56) {
+        memset(ctx->block + ctx->block_len, 0, SHA1_BLOCK_SIZE - ctx->block_len);
+        sha1_compress(ctx->h, ctx->block);
+        ctx->block_len = 0;
+    }
+    memset(ctx->block + ctx->block_len, 0, 56 - ctx->block_len);
+
+    // Append the original message length (in bits) as a 64-bit big-endian integer.
+    for (int i = 0; i < 8; i++) {
+        ctx->block[63 - i] = (uint8_t)((bit_len >> (8 * i)) & 0xFF);
+    }
+    sha1_compress(ctx->h, ctx->block);
+
+    // Produce the final hash value in big-endian format.
+    for (int i = 0; i < 5; i++) {
+        digest[4*i] = (uint8_t)((ctx->h[i] >> 24) & 0xFF);
+        digest[4*i+1] = (uint8_t)((ctx->h[i] >> 16) & 0xFF);
+        digest[4*i+2] = (uint8_t)((ctx->h[i] >> 8) & 0xFF);
+        digest[4*i+3] = (uint8_t)(ctx->h[i] & 0xFF);
+    }
 }
 
-// Create the inner and outer padded keys.
-for (size_t i = 0; i < block_size; i++) {
-ipad[i] = key_block[i] ^ 0x36;
-opad[i] = key_block[i] ^ 0x5C;
+void sha1(const uint8_t *msg, size_t len, uint8_t *digest) {
+    sha1_ctx ctx;
+    sha1_init(&ctx);
+    sha1_update(&ctx, msg, len);
+    sha1_final(&ctx, digest);
 }
 
-// Compute inner hash: SHA1(ipad || msg)
-uint8_t *inner_data = malloc(block_size + msg_len);
-if (!inner_data) {
-fprintf(stderr, "Memory allocation error\n");
-exit(1);
+void hmac_sha1_setkey(hmac_sha1_key *hkey, const uint8_t *key, size_t key_len) {
+    const size_t block_size = SHA1_BLOCK_SIZE;
+    uint8_t key_block[SHA1_BLOCK_SIZE];
+    uint8_t pad[SHA1_BLOCK_SIZE];
+
+    // If key is longer than block_size, hash it first.
+    if (key_len > block_size) {
+        sha1(key, key_len, key_block);
+        memset(key_block + SHA1_DIGEST_SIZE, 0, block_size - SHA1_DIGEST_SIZE);
+    } else {
+        memcpy(key_block, key, key_len);
+        memset(key_block + key_len, 0, block_size - key_len);
+    }
+
+    // Absorb the inner and outer padded keys.
+    for (size_t i = 0; i < block_size; i++) {
+        pad[i] = key_block[i] ^ 0x36;
+    }
+    sha1_init(&hkey->inner);
+    sha1_update(&hkey->inner, pad, block_size);
+
+    for (size_t i = 0; i < block_size; i++) {
+        pad[i] = key_block[i] ^ 0x5C;
+    }
+    sha1_init(&hkey->outer);
+    sha1_update(&hkey->outer, pad, block_size);
+
+    // Don't leave key material on the stack.
+    memset(key_block, 0, sizeof(key_block));
+    memset(pad, 0, sizeof(pad));
 }
-memcpy(inner_data, ipad, block_size);
-memcpy(inner_data + block_size, msg, msg_len);
-uint8_t inner_hash[20];
-sha1(inner_data, block_size + msg_len, inner_hash);
-free(inner_data);
-
-// Compute outer hash: SHA1(opad || inner_hash)
-uint8_t outer_data[64 + 20];
-memcpy(outer_data, opad, block_size);
-memcpy(outer_data + block_size, inner_hash, 20);
-sha1(outer_data, block_size + 20, digest);
+
+void hmac_sha1_mac(const hmac_sha1_key *hkey, const uint8_t *msg, size_t msg_len,
+                   uint8_t *digest) {
+    sha1_ctx ctx;
+    uint8_t inner_hash[SHA1_DIGEST_SIZE];
+
+    // Compute inner hash: SHA1(ipad || msg)
+    ctx = hkey->inner;
+    sha1_update(&ctx, msg, msg_len);
+    sha1_final(&ctx, inner_hash);
+
+    // Compute outer hash: SHA1(opad || inner_hash)
+    ctx = hkey->outer;
+    sha1_update(&ctx, inner_hash, SHA1_DIGEST_SIZE);
+    sha1_final(&ctx, digest);
 }
 
+void hmac_sha1(const uint8_t *key, size_t key_len,
+               const uint8_t *msg, size_t msg_len,
+               uint8_t *digest) {
+    hmac_sha1_key hkey;
+    hmac_sha1_setkey(&hkey, key, key_len);
+    hmac_sha1_mac(&hkey, msg, msg_len, digest);
+}
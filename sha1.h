@@ -4,6 +4,31 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#define SHA1_BLOCK_SIZE 64
+#define SHA1_DIGEST_SIZE 20
+
+// Streaming SHA-1 state. Holds one 64-byte block buffer and never uses the heap.
+typedef struct {
+    uint32_t h[5];                    // chaining value
+    uint64_t total_len;               // bytes hashed so far
+    uint8_t block[SHA1_BLOCK_SIZE];   // pending partial block
+    size_t block_len;                 // bytes used in 'block'
+} sha1_ctx;
+
+// Processes one 64-byte block, updating the chaining value 'h'. For callers
+// that build their own padded blocks (see pbkdf2.c); most want sha1_update().
+void sha1_compress(uint32_t h[5], const uint8_t *block);
+
+// Resets 'ctx' to the SHA-1 initial state.
+void sha1_init(sha1_ctx *ctx);
+
+// Feeds 'len' bytes of 'msg' into the running hash.
+void sha1_update(sha1_ctx *ctx, const uint8_t *msg, size_t len);
+
+// Pads the message and writes the 20-byte hash to 'digest'.
+// 'ctx' must be re-initialised before it is used again.
+void sha1_final(sha1_ctx *ctx, uint8_t *digest);
+
 // Computes SHA-1 hash of the input message.
 // 'msg' is the input data of length 'len' bytes.
 // 'digest' must point to a buffer of at least 20 bytes.
@@ -16,4 +41,18 @@ void hmac_sha1(const uint8_t *key, size_t key_len,
                const uint8_t *msg, size_t msg_len,
                uint8_t *digest);
 
+// HMAC-SHA1 key with the ipad/opad blocks already absorbed, so each MAC
+// over a short message costs only the message and outer-digest compressions.
+typedef struct {
+    sha1_ctx inner;   // state after SHA1(key ^ ipad)
+    sha1_ctx outer;   // state after SHA1(key ^ opad)
+} hmac_sha1_key;
+
+// Precomputes the inner and outer midstates for 'key'.
+void hmac_sha1_setkey(hmac_sha1_key *hkey, const uint8_t *key, size_t key_len);
+
+// Computes HMAC-SHA1 of 'msg' using precomputed midstates; 'hkey' is not modified.
+void hmac_sha1_mac(const hmac_sha1_key *hkey, const uint8_t *msg, size_t msg_len,
+                   uint8_t *digest);
+
 #endif // SHA1_H
@@ -0,0 +1,206 @@
+#include "sha256.h"
+#include <string.h>
+
+#if defined(PICO_ON_DEVICE) && PICO_ON_DEVICE
+#include "pico.h"
+#define SHA256_KERNEL_ATTR(name) __not_in_flash_func(name)
+#else
+#define SHA256_KERNEL_ATTR(name) name
+#endif
+
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static inline uint32_t rotr(uint32_t value, unsigned int count) {
+    return (value >> count) | (value << (32 - count));
+}
+
+static inline uint32_t load_be32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+#define SHA256_CH(e, f, g)  ((g) ^ ((e) & ((f) ^ (g))))
+#define SHA256_MAJ(a, b, c) (((a) & (b)) | ((c) & ((a) | (b))))
+#define SHA256_S0(a) (rotr((a), 2) ^ rotr((a), 13) ^ rotr((a), 22))
+#define SHA256_S1(e) (rotr((e), 6) ^ rotr((e), 11) ^ rotr((e), 25))
+#define SHA256_s0(w) (rotr((w), 7) ^ rotr((w), 18) ^ ((w) >> 3))
+#define SHA256_s1(w) (rotr((w), 17) ^ rotr((w), 19) ^ ((w) >> 10))
+
+// Message schedule kept in a 16-word ring, as in sha1.c.
+#define SHA256_W(j)  (w[(j) & 15])
+#define SHA256_WX(j) (SHA256_W(j) += SHA256_s1(SHA256_W((j) + 14)) + SHA256_W((j) + 9) + \
+                                     SHA256_s0(SHA256_W((j) + 1)))
+
+// One round; the caller rotates the variable names instead of moving values.
+#define SHA256_ROUND(a, b, c, d, e, f, g, h, j, x) \
+    do { \
+        uint32_t t1 = (h) + SHA256_S1(e) + SHA256_CH((e), (f), (g)) + K[j] + (x); \
+        (d) += t1; \
+        (h) = t1 + SHA256_S0(a) + SHA256_MAJ((a), (b), (c)); \
+    } while (0)
+
+// Eight rounds, after which the variables are back in their original roles.
+#define SHA256_R8(W, j) \
+    do { \
+        SHA256_ROUND(a, b, c, d, e, f, g, h, (j), W(j)); \
+        SHA256_ROUND(h, a, b, c, d, e, f, g, (j) + 1, W((j) + 1)); \
+        SHA256_ROUND(g, h, a, b, c, d, e, f, (j) + 2, W((j) + 2)); \
+        SHA256_ROUND(f, g, h, a, b, c, d, e, (j) + 3, W((j) + 3)); \
+        SHA256_ROUND(e, f, g, h, a, b, c, d, (j) + 4, W((j) + 4)); \
+        SHA256_ROUND(d, e, f, g, h, a, b, c, (j) + 5, W((j) + 5)); \
+        SHA256_ROUND(c, d, e, f, g, h, a, b, (j) + 6, W((j) + 6)); \
+        SHA256_ROUND(b, c, d, e, f, g, h, a, (j) + 7, W((j) + 7)); \
+    } while (0)
+
+// Processes one 64-byte block, updating the chaining value 'h'. Eight
+// rounds are unrolled per loop pass; on the Pico the kernel runs from SRAM.
+static void SHA256_KERNEL_ATTR(sha256_compress)(uint32_t state[8], const uint8_t *block) {
+    uint32_t w[16];
+    for (int j = 0; j < 16; j++) {
+        w[j] = load_be32(block + 4*j);
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+    SHA256_R8(SHA256_W, 0);
+    SHA256_R8(SHA256_W, 8);
+    for (int j = 16; j < 64; j += 8) {
+        SHA256_R8(SHA256_WX, j);
+    }
+
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+void sha256_init(sha256_ctx *ctx) {
+    static const uint32_t iv[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    memcpy(ctx->h, iv, sizeof(iv));
+    ctx->total_len = 0;
+    ctx->block_len = 0;
+}
+
+void sha256_update(sha256_ctx *ctx, const uint8_t *msg, size_t len) {
+    ctx->total_len += len;
+
+    // Top up a partially filled block first.
+    if (ctx->block_len > 0) {
+        size_t take = SHA256_BLOCK_SIZE - ctx->block_len;
+        if (take > len) take = len;
+        memcpy(ctx->block + ctx->block_len, msg, take);
+        ctx->block_len += take;
+        msg += take;
+        len -= take;
+        if (ctx->block_len < SHA256_BLOCK_SIZE) return;
+        sha256_compress(ctx->h, ctx->block);
+        ctx->block_len = 0;
+    }
+
+    // Whole blocks are hashed straight from the caller's buffer.
+    while (len >= SHA256_BLOCK_SIZE) {
+        sha256_compress(ctx->h, msg);
+        msg += SHA256_BLOCK_SIZE;
+        len -= SHA256_BLOCK_SIZE;
+    }
+
+    memcpy(ctx->block, msg, len);
+    ctx->block_len = len;
+}
+
+void sha256_final(sha256_ctx *ctx, uint8_t *digest) {
+    uint64_t bit_len = ctx->total_len * 8;
+
+    // Append the '1' bit, then zeros up to 56 bytes into the last block.
+    ctx->block[ctx->block_len++] = 0x80;
+    if (ctx->block_len > 56) {
+        memset(ctx->block + ctx->block_len, 0, SHA256_BLOCK_SIZE - ctx->block_len);
+        sha256_compress(ctx->h, ctx->block);
+        ctx->block_len = 0;
+    }
+    memset(ctx->block + ctx->block_len, 0, 56 - ctx->block_len);
+
+    // Append the message length in bits as a 64-bit big-endian integer.
+    for (int i = 0; i < 8; i++) {
+        ctx->block[63 - i] = (uint8_t)(bit_len >> (8 * i));
+    }
+    sha256_compress(ctx->h, ctx->block);
+
+    for (int i = 0; i < 8; i++) {
+        digest[4*i] = (uint8_t)(ctx->h[i] >> 24);
+        digest[4*i+1] = (uint8_t)(ctx->h[i] >> 16);
+        digest[4*i+2] = (uint8_t)(ctx->h[i] >> 8);
+        digest[4*i+3] = (uint8_t)ctx->h[i];
+    }
+}
+
+void sha256(const uint8_t *msg, size_t len, uint8_t *digest) {
+    sha256_ctx ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, msg, len);
+    sha256_final(&ctx, digest);
+}
+
+void hmac_sha256_setkey(hmac_sha256_key *hkey, const uint8_t *key, size_t key_len) {
+    uint8_t key_block[SHA256_BLOCK_SIZE];
+    uint8_t pad[SHA256_BLOCK_SIZE];
+
+    // If key is longer than the block size, hash it first.
+    if (key_len > SHA256_BLOCK_SIZE) {
+        sha256(key, key_len, key_block);
+        memset(key_block + SHA256_DIGEST_SIZE, 0, SHA256_BLOCK_SIZE - SHA256_DIGEST_SIZE);
+    } else {
+        memcpy(key_block, key, key_len);
+        memset(key_block + key_len, 0, SHA256_BLOCK_SIZE - key_len);
+    }
+
+    // Absorb the inner and outer padded keys.
+    for (size_t i = 0; i < SHA256_BLOCK_SIZE; i++) {
+        pad[i] = key_block[i] ^ 0x36;
+    }
+    sha256_init(&hkey->inner);
+    sha256_update(&hkey->inner, pad, SHA256_BLOCK_SIZE);
+
+    for (size_t i = 0; i < SHA256_BLOCK_SIZE; i++) {
+        pad[i] = key_block[i] ^ 0x5C;
+    }
+    sha256_init(&hkey->outer);
+    sha256_update(&hkey->outer, pad, SHA256_BLOCK_SIZE);
+
+    // Don't leave key material on the stack.
+    memset(key_block, 0, sizeof(key_block));
+    memset(pad, 0, sizeof(pad));
+}
+
+void hmac_sha256_mac(const hmac_sha256_key *hkey, const uint8_t *msg, size_t msg_len,
+                     uint8_t *digest) {
+    sha256_ctx ctx;
+    uint8_t inner_hash[SHA256_DIGEST_SIZE];
+
+    ctx = hkey->inner;
+    sha256_update(&ctx, msg, msg_len);
+    sha256_final(&ctx, inner_hash);
+
+    ctx = hkey->outer;
+    sha256_update(&ctx, inner_hash, SHA256_DIGEST_SIZE);
+    sha256_final(&ctx, digest);
+}
+
+void hmac_sha256(const uint8_t *key, size_t key_len,
+                 const uint8_t *msg, size_t msg_len,
+                 uint8_t *digest) {
+    hmac_sha256_key hkey;
+    hmac_sha256_setkey(&hkey, key, key_len);
+    hmac_sha256_mac(&hkey, msg, msg_len, digest);
+}
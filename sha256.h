@@ -0,0 +1,49 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_BLOCK_SIZE 64
+#define SHA256_DIGEST_SIZE 32
+
+// Streaming SHA-256 state. Holds one 64-byte block buffer and never uses the heap.
+typedef struct {
+    uint32_t h[8];                      // chaining value
+    uint64_t total_len;                 // bytes hashed so far
+    uint8_t block[SHA256_BLOCK_SIZE];   // pending partial block
+    size_t block_len;                   // bytes used in 'block'
+} sha256_ctx;
+
+// Resets 'ctx' to the SHA-256 initial state.
+void sha256_init(sha256_ctx *ctx);
+
+// Feeds 'len' bytes of 'msg' into the running hash.
+void sha256_update(sha256_ctx *ctx, const uint8_t *msg, size_t len);
+
+// Pads the message and writes the 32-byte hash to 'digest'.
+// 'ctx' must be re-initialised before it is used again.
+void sha256_final(sha256_ctx *ctx, uint8_t *digest);
+
+// Computes the SHA-256 hash of 'len' bytes of 'msg' into 'digest' (32 bytes).
+void sha256(const uint8_t *msg, size_t len, uint8_t *digest);
+
+// HMAC-SHA256 key with the ipad/opad blocks already absorbed.
+typedef struct {
+    sha256_ctx inner;   // state after SHA256(key ^ ipad)
+    sha256_ctx outer;   // state after SHA256(key ^ opad)
+} hmac_sha256_key;
+
+// Precomputes the inner and outer midstates for 'key'.
+void hmac_sha256_setkey(hmac_sha256_key *hkey, const uint8_t *key, size_t key_len);
+
+// Computes HMAC-SHA256 of 'msg' using precomputed midstates; 'hkey' is not modified.
+void hmac_sha256_mac(const hmac_sha256_key *hkey, const uint8_t *msg, size_t msg_len,
+                     uint8_t *digest);
+
+// Computes HMAC-SHA256 of a message with the given key into 'digest' (32 bytes).
+void hmac_sha256(const uint8_t *key, size_t key_len,
+                 const uint8_t *msg, size_t msg_len,
+                 uint8_t *digest);
+
+#endif // SHA256_H
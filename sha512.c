@@ -0,0 +1,223 @@
+#include "sha512.h"
+#include <string.h>
+
+#if defined(PICO_ON_DEVICE) && PICO_ON_DEVICE
+#include "pico.h"
+#define SHA512_KERNEL_ATTR(name) __not_in_flash_func(name)
+#else
+#define SHA512_KERNEL_ATTR(name) name
+#endif
+
+static const uint64_t K[80] = {
+    0x428a2f98d728ae22ull, 0x7137449123ef65cdull, 0xb5c0fbcfec4d3b2full, 0xe9b5dba58189dbbcull,
+    0x3956c25bf348b538ull, 0x59f111f1b605d019ull, 0x923f82a4af194f9bull, 0xab1c5ed5da6d8118ull,
+    0xd807aa98a3030242ull, 0x12835b0145706fbeull, 0x243185be4ee4b28cull, 0x550c7dc3d5ffb4e2ull,
+    0x72be5d74f27b896full, 0x80deb1fe3b1696b1ull, 0x9bdc06a725c71235ull, 0xc19bf174cf692694ull,
+    0xe49b69c19ef14ad2ull, 0xefbe4786384f25e3ull, 0x0fc19dc68b8cd5b5ull, 0x240ca1cc77ac9c65ull,
+    0x2de92c6f592b0275ull, 0x4a7484aa6ea6e483ull, 0x5cb0a9dcbd41fbd4ull, 0x76f988da831153b5ull,
+    0x983e5152ee66dfabull, 0xa831c66d2db43210ull, 0xb00327c898fb213full, 0xbf597fc7beef0ee4ull,
+    0xc6e00bf33da88fc2ull, 0xd5a79147930aa725ull, 0x06ca6351e003826full, 0x142929670a0e6e70ull,
+    0x27b70a8546d22ffcull, 0x2e1b21385c26c926ull, 0x4d2c6dfc5ac42aedull, 0x53380d139d95b3dfull,
+    0x650a73548baf63deull, 0x766a0abb3c77b2a8ull, 0x81c2c92e47edaee6ull, 0x92722c851482353bull,
+    0xa2bfe8a14cf10364ull, 0xa81a664bbc423001ull, 0xc24b8b70d0f89791ull, 0xc76c51a30654be30ull,
+    0xd192e819d6ef5218ull, 0xd69906245565a910ull, 0xf40e35855771202aull, 0x106aa07032bbd1b8ull,
+    0x19a4c116b8d2d0c8ull, 0x1e376c085141ab53ull, 0x2748774cdf8eeb99ull, 0x34b0bcb5e19b48a8ull,
+    0x391c0cb3c5c95a63ull, 0x4ed8aa4ae3418acbull, 0x5b9cca4f7763e373ull, 0x682e6ff3d6b2b8a3ull,
+    0x748f82ee5defb2fcull, 0x78a5636f43172f60ull, 0x84c87814a1f0ab72ull, 0x8cc702081a6439ecull,
+    0x90befffa23631e28ull, 0xa4506cebde82bde9ull, 0xbef9a3f7b2c67915ull, 0xc67178f2e372532bull,
+    0xca273eceea26619cull, 0xd186b8c721c0c207ull, 0xeada7dd6cde0eb1eull, 0xf57d4f7fee6ed178ull,
+    0x06f067aa72176fbaull, 0x0a637dc5a2c898a6ull, 0x113f9804bef90daeull, 0x1b710b35131c471bull,
+    0x28db77f523047d84ull, 0x32caab7b40c72493ull, 0x3c9ebe0a15c9bebcull, 0x431d67c49c100d4cull,
+    0x4cc5d4becb3e42b6ull, 0x597f299cfc657e2aull, 0x5fcb6fab3ad6faecull, 0x6c44198c4a475817ull,
+};
+
+static inline uint64_t rotr64(uint64_t value, unsigned int count) {
+    return (value >> count) | (value << (64 - count));
+}
+
+static inline uint64_t load_be64(const uint8_t *p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+static inline void store_be64(uint8_t *p, uint64_t v) {
+    for (int i = 7; i >= 0; i--) {
+        p[i] = (uint8_t)v;
+        v >>= 8;
+    }
+}
+
+#define SHA512_CH(e, f, g)  ((g) ^ ((e) & ((f) ^ (g))))
+#define SHA512_MAJ(a, b, c) (((a) & (b)) | ((c) & ((a) | (b))))
+#define SHA512_S0(a) (rotr64((a), 28) ^ rotr64((a), 34) ^ rotr64((a), 39))
+#define SHA512_S1(e) (rotr64((e), 14) ^ rotr64((e), 18) ^ rotr64((e), 41))
+#define SHA512_s0(w) (rotr64((w), 1) ^ rotr64((w), 8) ^ ((w) >> 7))
+#define SHA512_s1(w) (rotr64((w), 19) ^ rotr64((w), 61) ^ ((w) >> 6))
+
+// Message schedule kept in a 16-word ring, as in sha1.c.
+#define SHA512_W(j)  (w[(j) & 15])
+#define SHA512_WX(j) (SHA512_W(j) += SHA512_s1(SHA512_W((j) + 14)) + SHA512_W((j) + 9) + \
+                                     SHA512_s0(SHA512_W((j) + 1)))
+
+// One round; the caller rotates the variable names instead of moving values.
+#define SHA512_ROUND(a, b, c, d, e, f, g, h, j, x) \
+    do { \
+        uint64_t t1 = (h) + SHA512_S1(e) + SHA512_CH((e), (f), (g)) + K[j] + (x); \
+        (d) += t1; \
+        (h) = t1 + SHA512_S0(a) + SHA512_MAJ((a), (b), (c)); \
+    } while (0)
+
+// Eight rounds, after which the variables are back in their original roles.
+#define SHA512_R8(W, j) \
+    do { \
+        SHA512_ROUND(a, b, c, d, e, f, g, h, (j), W(j)); \
+        SHA512_ROUND(h, a, b, c, d, e, f, g, (j) + 1, W((j) + 1)); \
+        SHA512_ROUND(g, h, a, b, c, d, e, f, (j) + 2, W((j) + 2)); \
+        SHA512_ROUND(f, g, h, a, b, c, d, e, (j) + 3, W((j) + 3)); \
+        SHA512_ROUND(e, f, g, h, a, b, c, d, (j) + 4, W((j) + 4)); \
+        SHA512_ROUND(d, e, f, g, h, a, b, c, (j) + 5, W((j) + 5)); \
+        SHA512_ROUND(c, d, e, f, g, h, a, b, (j) + 6, W((j) + 6)); \
+        SHA512_ROUND(b, c, d, e, f, g, h, a, (j) + 7, W((j) + 7)); \
+    } while (0)
+
+// Processes one 128-byte block, updating the chaining value 'h'. The
+// Cortex-M0+ has no 64-bit instructions, so each 64-bit rotate and add is
+// several 32-bit ones: expect roughly twice SHA-256's cost per byte there.
+static void SHA512_KERNEL_ATTR(sha512_compress)(uint64_t state[8], const uint8_t *block) {
+    uint64_t w[16];
+    for (int j = 0; j < 16; j++) {
+        w[j] = load_be64(block + 8*j);
+    }
+
+    uint64_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint64_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+    SHA512_R8(SHA512_W, 0);
+    SHA512_R8(SHA512_W, 8);
+    for (int j = 16; j < 80; j += 8) {
+        SHA512_R8(SHA512_WX, j);
+    }
+
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+void sha512_init(sha512_ctx *ctx) {
+    static const uint64_t iv[8] = {
+        0x6a09e667f3bcc908ull, 0xbb67ae8584caa73bull, 0x3c6ef372fe94f82bull, 0xa54ff53a5f1d36f1ull,
+        0x510e527fade682d1ull, 0x9b05688c2b3e6c1full, 0x1f83d9abfb41bd6bull, 0x5be0cd19137e2179ull,
+    };
+    memcpy(ctx->h, iv, sizeof(iv));
+    ctx->total_len = 0;
+    ctx->block_len = 0;
+}
+
+void sha512_update(sha512_ctx *ctx, const uint8_t *msg, size_t len) {
+    ctx->total_len += len;
+
+    // Top up a partially filled block first.
+    if (ctx->block_len > 0) {
+        size_t take = SHA512_BLOCK_SIZE - ctx->block_len;
+        if (take > len) take = len;
+        memcpy(ctx->block + ctx->block_len, msg, take);
+        ctx->block_len += take;
+        msg += take;
+        len -= take;
+        if (ctx->block_len < SHA512_BLOCK_SIZE) return;
+        sha512_compress(ctx->h, ctx->block);
+        ctx->block_len = 0;
+    }
+
+    // Whole blocks are hashed straight from the caller's buffer.
+    while (len >= SHA512_BLOCK_SIZE) {
+        sha512_compress(ctx->h, msg);
+        msg += SHA512_BLOCK_SIZE;
+        len -= SHA512_BLOCK_SIZE;
+    }
+
+    memcpy(ctx->block, msg, len);
+    ctx->block_len = len;
+}
+
+void sha512_final(sha512_ctx *ctx, uint8_t *digest) {
+    // Append the '1' bit, then zeros up to 112 bytes into the last block.
+    ctx->block[ctx->block_len++] = 0x80;
+    if (ctx->block_len > 112) {
+        memset(ctx->block + ctx->block_len, 0, SHA512_BLOCK_SIZE - ctx->block_len);
+        sha512_compress(ctx->h, ctx->block);
+        ctx->block_len = 0;
+    }
+    memset(ctx->block + ctx->block_len, 0, 112 - ctx->block_len);
+
+    // Append the message length in bits as a 128-bit big-endian integer.
+    store_be64(ctx->block + 112, ctx->total_len >> 61);
+    store_be64(ctx->block + 120, ctx->total_len << 3);
+    sha512_compress(ctx->h, ctx->block);
+
+    for (int i = 0; i < 8; i++) {
+        store_be64(digest + 8*i, ctx->h[i]);
+    }
+}
+
+void sha512(const uint8_t *msg, size_t len, uint8_t *digest) {
+    sha512_ctx ctx;
+    sha512_init(&ctx);
+    sha512_update(&ctx, msg, len);
+    sha512_final(&ctx, digest);
+}
+
+void hmac_sha512_setkey(hmac_sha512_key *hkey, const uint8_t *key, size_t key_len) {
+    uint8_t key_block[SHA512_BLOCK_SIZE];
+    uint8_t pad[SHA512_BLOCK_SIZE];
+
+    // If key is longer than the block size, hash it first.
+    if (key_len > SHA512_BLOCK_SIZE) {
+        sha512(key, key_len, key_block);
+        memset(key_block + SHA512_DIGEST_SIZE, 0, SHA512_BLOCK_SIZE - SHA512_DIGEST_SIZE);
+    } else {
+        memcpy(key_block, key, key_len);
+        memset(key_block + key_len, 0, SHA512_BLOCK_SIZE - key_len);
+    }
+
+    // Absorb the inner and outer padded keys.
+    for (size_t i = 0; i < SHA512_BLOCK_SIZE; i++) {
+        pad[i] = key_block[i] ^ 0x36;
+    }
+    sha512_init(&hkey->inner);
+    sha512_update(&hkey->inner, pad, SHA512_BLOCK_SIZE);
+
+    for (size_t i = 0; i < SHA512_BLOCK_SIZE; i++) {
+        pad[i] = key_block[i] ^ 0x5C;
+    }
+    sha512_init(&hkey->outer);
+    sha512_update(&hkey->outer, pad, SHA512_BLOCK_SIZE);
+
+    // Don't leave key material on the stack.
+    memset(key_block, 0, sizeof(key_block));
+    memset(pad, 0, sizeof(pad));
+}
+
+void hmac_sha512_mac(const hmac_sha512_key *hkey, const uint8_t *msg, size_t msg_len,
+                     uint8_t *digest) {
+    sha512_ctx ctx;
+    uint8_t inner_hash[SHA512_DIGEST_SIZE];
+
+    ctx = hkey->inner;
+    sha512_update(&ctx, msg, msg_len);
+    sha512_final(&ctx, inner_hash);
+
+    ctx = hkey->outer;
+    sha512_update(&ctx, inner_hash, SHA512_DIGEST_SIZE);
+    sha512_final(&ctx, digest);
+}
+
+void hmac_sha512(const uint8_t *key, size_t key_len,
+                 const uint8_t *msg, size_t msg_len,
+                 uint8_t *digest) {
+    hmac_sha512_key hkey;
+    hmac_sha512_setkey(&hkey, key, key_len);
+    hmac_sha512_mac(&hkey, msg, msg_len, digest);
+}
@@ -0,0 +1,50 @@
+#ifndef SHA512_H
+#define SHA512_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA512_BLOCK_SIZE 128
+#define SHA512_DIGEST_SIZE 64
+
+// Streaming SHA-512 state. Holds one 128-byte block buffer and never uses the
+// heap. Messages are limited to 2^64 bytes rather than 2^128 bits.
+typedef struct {
+    uint64_t h[8];                      // chaining value
+    uint64_t total_len;                 // bytes hashed so far
+    uint8_t block[SHA512_BLOCK_SIZE];   // pending partial block
+    size_t block_len;                   // bytes used in 'block'
+} sha512_ctx;
+
+// Resets 'ctx' to the SHA-512 initial state.
+void sha512_init(sha512_ctx *ctx);
+
+// Feeds 'len' bytes of 'msg' into the running hash.
+void sha512_update(sha512_ctx *ctx, const uint8_t *msg, size_t len);
+
+// Pads the message and writes the 64-byte hash to 'digest'.
+// 'ctx' must be re-initialised before it is used again.
+void sha512_final(sha512_ctx *ctx, uint8_t *digest);
+
+// Computes the SHA-512 hash of 'len' bytes of 'msg' into 'digest' (64 bytes).
+void sha512(const uint8_t *msg, size_t len, uint8_t *digest);
+
+// HMAC-SHA512 key with the ipad/opad blocks already absorbed.
+typedef struct {
+    sha512_ctx inner;   // state after SHA512(key ^ ipad)
+    sha512_ctx outer;   // state after SHA512(key ^ opad)
+} hmac_sha512_key;
+
+// Precomputes the inner and outer midstates for 'key'.
+void hmac_sha512_setkey(hmac_sha512_key *hkey, const uint8_t *key, size_t key_len);
+
+// Computes HMAC-SHA512 of 'msg' using precomputed midstates; 'hkey' is not modified.
+void hmac_sha512_mac(const hmac_sha512_key *hkey, const uint8_t *msg, size_t msg_len,
+                     uint8_t *digest);
+
+// Computes HMAC-SHA512 of a message with the given key into 'digest' (64 bytes).
+void hmac_sha512(const uint8_t *key, size_t key_len,
+                 const uint8_t *msg, size_t msg_len,
+                 uint8_t *digest);
+
+#endif // SHA512_H
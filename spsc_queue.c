@@ -0,0 +1,59 @@
+#include "spsc_queue.h"
+#include <string.h>
+
+#if defined(PICO_ON_DEVICE) && PICO_ON_DEVICE
+#include "hardware/sync.h"
+#define spsc_barrier() __dmb()
+#else
+#define spsc_barrier() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#endif
+
+void spsc_queue_init(spsc_queue_t *q, void *storage, uint32_t elem_size, uint32_t capacity) {
+    q->head = 0;
+    q->tail = 0;
+    q->capacity = capacity;
+    q->elem_size = elem_size;
+    q->storage = (uint8_t *)storage;
+}
+
+bool spsc_queue_try_push(spsc_queue_t *q, const void *elem) {
+    uint32_t head = q->head;
+    if (head - q->tail >= q->capacity) {
+        return false;
+    }
+    memcpy(q->storage + (head & (q->capacity - 1)) * q->elem_size, elem, q->elem_size);
+    // Publish the element before the new head becomes visible.
+    spsc_barrier();
+    q->head = head + 1;
+    return true;
+}
+
+bool spsc_queue_try_peek(spsc_queue_t *q, void *elem) {
+    uint32_t tail = q->tail;
+    if (q->head == tail) {
+        return false;
+    }
+    // Don't read the element before we've seen the head that published it.
+    spsc_barrier();
+    memcpy(elem, q->storage + (tail & (q->capacity - 1)) * q->elem_size, q->elem_size);
+    return true;
+}
+
+bool spsc_queue_try_pop(spsc_queue_t *q, void *elem) {
+    uint32_t tail = q->tail;
+    if (q->head == tail) {
+        return false;
+    }
+    spsc_barrier();
+    if (elem) {
+        memcpy(elem, q->storage + (tail & (q->capacity - 1)) * q->elem_size, q->elem_size);
+    }
+    // Finish reading the slot before handing it back to the producer.
+    spsc_barrier();
+    q->tail = tail + 1;
+    return true;
+}
+
+uint32_t spsc_queue_level(const spsc_queue_t *q) {
+    return q->head - q->tail;
+}
@@ -0,0 +1,37 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Lock-free single-producer/single-consumer ring of fixed-size elements.
+// One core pushes, the other pops; neither ever blocks or takes a lock.
+// The producer only writes 'head' and the consumer only writes 'tail'.
+typedef struct {
+    volatile uint32_t head;   // total elements pushed
+    volatile uint32_t tail;   // total elements popped
+    uint32_t capacity;        // number of slots, a power of two
+    uint32_t elem_size;       // bytes per element
+    uint8_t *storage;         // capacity * elem_size bytes
+} spsc_queue_t;
+
+// Prepares 'q' to use 'storage' for 'capacity' elements of 'elem_size' bytes.
+// 'capacity' must be a power of two.
+void spsc_queue_init(spsc_queue_t *q, void *storage, uint32_t elem_size, uint32_t capacity);
+
+// Producer side: copies 'elem' into the queue. Returns false if it is full.
+bool spsc_queue_try_push(spsc_queue_t *q, const void *elem);
+
+// Consumer side: copies the oldest element into 'elem' without removing it.
+// Returns false if the queue is empty.
+bool spsc_queue_try_peek(spsc_queue_t *q, void *elem);
+
+// Consumer side: removes the oldest element, copying it into 'elem' if not NULL.
+// Returns false if the queue is empty.
+bool spsc_queue_try_pop(spsc_queue_t *q, void *elem);
+
+// Number of elements currently queued (exact only on the consumer side).
+uint32_t spsc_queue_level(const spsc_queue_t *q);
+
+#endif // SPSC_QUEUE_H
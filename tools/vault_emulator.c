@@ -0,0 +1,234 @@
+// Device emulator for the provisioning protocol, on a Linux pseudo-terminal.
+//
+// Runs the firmware's vault, account index and provisioning engine against
+// the RAM flash model, backed by an image file, and serves them on a pty so
+// vaultctl (or anything else) can talk to it as if it were the board's CDC
+// port:
+//
+//   vault_emulator [-i image] [-l link] [-r bytes_per_s] [-p pin]
+//
+// The image is loaded at start-up and written back whenever staged writes
+// reach flash. -l creates a symlink to the pty. -r throttles the link to
+// roughly the given rate; USB full-speed CDC sustains about 500000. -p is
+// the PIN the vault is unlocked with (digits, default 0673); a new image
+// takes it as its PIN.
+
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "account_index.h"
+#include "flash_hal.h"
+#include "flash_hal_host.h"
+#include "account.h"
+#include "provision.h"
+#include "vault.h"
+#include "vault_crypt.h"
+
+static int master_fd = -1;
+static const char *image_path = "vault.img";
+static const char *link_path = NULL;
+static double rate = 0;
+static const char *pin_digits = "0673";
+static volatile sig_atomic_t stop = 0;
+
+static uint32_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000u + ts.tv_nsec / 1000000);
+}
+
+// Sleeps long enough for 'len' bytes to cross a link running at 'rate'.
+static void throttle(size_t len) {
+    if (rate <= 0) return;
+    double s = (double)len / rate;
+    struct timespec ts = { (time_t)s, (long)((s - (time_t)s) * 1e9) };
+    nanosleep(&ts, NULL);
+}
+
+static void load_image(void) {
+    flash_hal_host_reset();
+    FILE *f = fopen(image_path, "rb");
+    if (f == NULL) {
+        printf("%s: new image\n", image_path);
+        return;
+    }
+    size_t n = fread(flash_hal_host_image(), 1, VAULT_FLASH_SIZE, f);
+    fclose(f);
+    printf("%s: loaded %zu bytes\n", image_path, n);
+}
+
+static void save_image(void) {
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", image_path);
+    FILE *f = fopen(tmp, "wb");
+    if (f == NULL || fwrite(flash_hal_host_image(), 1, VAULT_FLASH_SIZE, f) != VAULT_FLASH_SIZE) {
+        perror(tmp);
+        if (f) fclose(f);
+        return;
+    }
+    fclose(f);
+    if (rename(tmp, image_path) != 0) perror(image_path);
+}
+
+// Writes a reply. If nobody drains the pty for a second, the rest is
+// dropped, as the firmware does when no host has the port open.
+static void link_write(const uint8_t *data, size_t len) {
+    throttle(len);
+    while (len > 0) {
+        ssize_t n = write(master_fd, data, len);
+        if (n < 0) {
+            struct pollfd pfd = { .fd = master_fd, .events = POLLOUT };
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN && poll(&pfd, 1, 1000) > 0) continue;
+            return;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+}
+
+static void link_set_time(uint32_t unix_time) {
+    printf("time set to %lu\n", (unsigned long)unix_time);
+}
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+// Opens the pty pair. The slave side is held open too, so the master never
+// sees a hang-up between client sessions, and set to raw mode so no byte of
+// a frame is translated.
+static int open_pty(int *slave_fd) {
+    master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master_fd < 0 || grantpt(master_fd) != 0 || unlockpt(master_fd) != 0) {
+        perror("posix_openpt");
+        return -1;
+    }
+    fcntl(master_fd, F_SETFL, fcntl(master_fd, F_GETFL) | O_NONBLOCK);
+    const char *name = ptsname(master_fd);
+    *slave_fd = open(name, O_RDWR | O_NOCTTY);
+    if (*slave_fd < 0) {
+        perror(name);
+        return -1;
+    }
+    struct termios tio;
+    tcgetattr(*slave_fd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(*slave_fd, TCSANOW, &tio);
+
+    printf("device: %s\n", name);
+    if (link_path) {
+        unlink(link_path);
+        if (symlink(name, link_path) != 0) {
+            perror(link_path);
+        } else {
+            printf("device: %s\n", link_path);
+        }
+    }
+    return 0;
+}
+
+static void print_stats(void) {
+    vault_stats st;
+    flash_hal_host_counters c = flash_hal_host_get_counters();
+    vault_get_stats(&st);
+    printf("flushed: %u accounts, %lu/%lu sectors free, %lu page programs, %lu erases\n",
+           (unsigned)account_index_count(), (unsigned long)st.free_sectors,
+           (unsigned long)st.sectors, (unsigned long)c.page_programs,
+           (unsigned long)c.sector_erases);
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "i:l:r:p:")) != -1) {
+        switch (opt) {
+            case 'i': image_path = optarg; break;
+            case 'l': link_path = optarg; break;
+            case 'r': rate = atof(optarg); break;
+            case 'p': pin_digits = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-i image] [-l link] [-r bytes_per_s] [-p pin]\n",
+                        argv[0]);
+                return 2;
+        }
+    }
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    load_image();
+    if (vault_mount() != 0) {
+        fprintf(stderr, "%s: not a vault image\n", image_path);
+        return 1;
+    }
+    account_index_build();
+    printf("%u accounts\n", (unsigned)account_index_count());
+
+    // The board's keypad enters digits as their values.
+    uint8_t pin[32];
+    size_t pin_len = 0;
+    for (const char *d = pin_digits; *d && pin_len < sizeof(pin); d++) {
+        pin[pin_len++] = (uint8_t)(*d - '0');
+    }
+    if (vault_crypt_unlock(pin, pin_len) != 0) {
+        printf("wrong PIN: vault stays locked\n");
+    } else {
+        int n = account_encrypt_all();
+        if (n > 0) printf("%d accounts encrypted\n", n);
+        save_image();
+    }
+
+    int slave_fd;
+    if (open_pty(&slave_fd) != 0) return 1;
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    provision_t engine;
+    provision_io io = { .write = link_write, .set_time = link_set_time };
+    provision_init(&engine, &io);
+
+    uint8_t buf[4096];
+    flash_hal_host_counters saved = flash_hal_host_get_counters();
+    while (!stop) {
+        struct pollfd pfd = { .fd = master_fd, .events = POLLIN };
+        int ready = poll(&pfd, 1, PROVISION_IDLE_FLUSH_MS / 4);
+        if (ready > 0 && (pfd.revents & POLLIN)) {
+            ssize_t n = read(master_fd, buf, sizeof(buf));
+            if (n > 0) {
+                throttle((size_t)n);
+                provision_input(&engine, buf, (size_t)n, now_ms());
+            }
+        }
+
+        // Save once everything written has reached flash (COMMIT or idle).
+        provision_poll(&engine, now_ms());
+        flash_hal_host_counters c = flash_hal_host_get_counters();
+        if (!engine.dirty && (c.page_programs != saved.page_programs ||
+                              c.sector_erases != saved.sector_erases)) {
+            saved = c;
+            save_image();
+            print_stats();
+        }
+    }
+
+    if (engine.dirty) {
+        vault_batch_end();
+        save_image();
+    }
+    if (link_path) unlink(link_path);
+    close(slave_fd);
+    close(master_fd);
+    return 0;
+}
@@ -0,0 +1,851 @@
+// Host-side provisioning tool for the vault, over the CDC protocol in
+// provision.h.
+//
+//   vaultctl [-d device] [-w window] push <accounts.csv|accounts.json> [--prune] [--dry-run]
+//   vaultctl [-d device] diff <accounts.csv|accounts.json> [--prune]
+//   vaultctl [-d device] list
+//   vaultctl [-d device] export
+//   vaultctl [-d device] time [unix_time]
+//
+// push reads the device's account list (ids, names and record CRCs), works
+// out which accounts are new or changed, and sends only those, pipelined up
+// to the device's window, followed by one COMMIT. --prune also deletes
+// accounts that are not in the file. diff prints the plan without sending.
+// export prints every account as CSV in the input format below, so that it
+// can be pushed back unchanged; hotp_counter is the initial counter, not the
+// moving one.
+//
+// Input columns / keys: id (optional; account n is selected by button mask
+// n + 1), name (required, unique), username, password, totp_secret,
+// totp_digits, totp_period, totp_algorithm (SHA1, SHA256 or SHA512, as in
+// otpauth:// URIs; SHA1 if empty), hotp_counter (the first HOTP counter; the
+// account is TOTP if empty). Accounts without an id keep the one they
+// have on the device, or get the lowest free one. CSV needs a header row;
+// JSON is an array of objects, or an object with an "accounts" array.
+// TOTP secrets are decoded here and sent as raw seeds.
+//
+// The device defaults to /dev/ttyACM0; vault_emulator provides one without a
+// board.
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+extern "C" {
+#include "account.h"
+#include "base32.h"
+#include "crc32.h"
+#include "provision.h"
+#include "totp.h"
+}
+
+namespace {
+
+using Bytes = std::vector<uint8_t>;
+
+uint16_t get_le16(const uint8_t *p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t get_le32(const uint8_t *p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+void put_le16(Bytes &out, uint16_t v) {
+    out.push_back(static_cast<uint8_t>(v));
+    out.push_back(static_cast<uint8_t>(v >> 8));
+}
+
+//--------------------------------------------------------------------+
+// Input files
+//--------------------------------------------------------------------+
+
+struct Entry {
+    int id = -1;                 // -1: keep the device's id or allocate one
+    std::string name, username, password, totp_secret;
+    int totp_digits = 0;
+    int totp_period = 30;
+    int totp_hash = TOTP_SHA1;
+    long long hotp_counter = -1;  // -1: TOTP
+};
+
+int parse_totp_hash(std::string value) {
+    for (char &c : value) c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+    if (value.empty() || value == "SHA1") return TOTP_SHA1;
+    if (value == "SHA256") return TOTP_SHA256;
+    if (value == "SHA512") return TOTP_SHA512;
+    throw std::runtime_error("unknown totp_algorithm '" + value + "'");
+}
+
+const char *totp_hash_name(int hash) {
+    switch (hash) {
+        case TOTP_SHA256: return "SHA256";
+        case TOTP_SHA512: return "SHA512";
+        default: return "SHA1";
+    }
+}
+
+// The whole of 'value' as an integer; std::stoll alone accepts "12abc" and
+// throws exceptions whose what() is just "stoll".
+long long parse_number(const std::string &key, const std::string &value) {
+    size_t end = 0;
+    long long n = 0;
+    try {
+        n = std::stoll(value, &end);
+    } catch (const std::logic_error &) {
+        end = 0;
+    }
+    if (end == 0 || end != value.size()) {
+        throw std::runtime_error(key + " is not a number: '" + value + "'");
+    }
+    return n;
+}
+
+int parse_int(const std::string &key, const std::string &value) {
+    long long n = parse_number(key, value);
+    if (n < INT_MIN || n > INT_MAX) throw std::runtime_error(key + " is out of range: " + value);
+    return static_cast<int>(n);
+}
+
+void set_field(Entry &e, const std::string &key, const std::string &value) {
+    if (key == "id") {
+        e.id = value.empty() ? -1 : parse_int(key, value);
+    } else if (key == "name") {
+        e.name = value;
+    } else if (key == "username") {
+        e.username = value;
+    } else if (key == "password") {
+        e.password = value;
+    } else if (key == "totp_secret") {
+        e.totp_secret = value;
+    } else if (key == "totp_digits") {
+        e.totp_digits = value.empty() ? 0 : parse_int(key, value);
+        if (e.totp_digits < 0 || e.totp_digits > TOTP_MAX_DIGITS) {
+            throw std::runtime_error("totp_digits must be 1-" + std::to_string(TOTP_MAX_DIGITS));
+        }
+    } else if (key == "totp_period") {
+        e.totp_period = value.empty() ? 30 : parse_int(key, value);
+        if (e.totp_period < 1 || e.totp_period > UINT16_MAX) {
+            throw std::runtime_error("totp_period must be 1-" + std::to_string(UINT16_MAX));
+        }
+    } else if (key == "totp_algorithm") {
+        e.totp_hash = parse_totp_hash(value);
+    } else if (key == "hotp_counter") {
+        e.hotp_counter = value.empty() ? -1 : parse_number(key, value);
+        if (e.hotp_counter < -1) throw std::runtime_error("hotp_counter must not be negative");
+    } else {
+        throw std::runtime_error("unknown field '" + key + "'");
+    }
+}
+
+// RFC 4180: comma-separated, fields optionally double-quoted with "" for a
+// quote; quoted fields may span lines.
+std::vector<std::vector<std::string>> parse_csv(const std::string &text) {
+    std::vector<std::vector<std::string>> rows(1);
+    std::string field;
+    bool quoted = false, was_quoted = false;
+
+    for (size_t i = 0; i < text.size(); i++) {
+        char c = text[i];
+        if (quoted) {
+            if (c == '"' && i + 1 < text.size() && text[i + 1] == '"') {
+                field += '"';
+                i++;
+            } else if (c == '"') {
+                quoted = false;
+            } else {
+                field += c;
+            }
+        } else if (c == '"') {
+            quoted = was_quoted = true;
+        } else if (c == ',') {
+            rows.back().push_back(field);
+            field.clear();
+        } else if (c == '\n' || c == '\r') {
+            if (c == '\r' && i + 1 < text.size() && text[i + 1] == '\n') i++;
+            if (!field.empty() || was_quoted || !rows.back().empty()) {
+                rows.back().push_back(field);
+                rows.emplace_back();
+            }
+            field.clear();
+            was_quoted = false;
+        } else {
+            field += c;
+        }
+    }
+    if (!field.empty() || was_quoted || !rows.back().empty()) {
+        rows.back().push_back(field);
+    } else {
+        rows.pop_back();
+    }
+    return rows;
+}
+
+std::vector<Entry> load_csv(const std::string &text) {
+    auto rows = parse_csv(text);
+    if (rows.empty()) return {};
+    const auto &header = rows[0];
+    std::vector<Entry> entries;
+    for (size_t r = 1; r < rows.size(); r++) {
+        if (rows[r].size() != header.size()) {
+            throw std::runtime_error("line " + std::to_string(r + 1) + ": expected " +
+                                     std::to_string(header.size()) + " fields");
+        }
+        Entry e;
+        try {
+            for (size_t c = 0; c < header.size(); c++) set_field(e, header[c], rows[r][c]);
+        } catch (const std::runtime_error &err) {
+            throw std::runtime_error("line " + std::to_string(r + 1) + ": " + err.what());
+        }
+        entries.push_back(e);
+    }
+    return entries;
+}
+
+// Just enough JSON for a list of flat objects.
+class JsonReader {
+public:
+    explicit JsonReader(const std::string &text) : s_(text) {}
+
+    std::vector<Entry> entries() {
+        std::vector<Entry> out;
+        skip();
+        if (peek() == '{') {
+            // { "accounts": [ ... ] }
+            bool found = false;
+            object([&](const std::string &key) {
+                if (key == "accounts") {
+                    array([&] { out.push_back(entry()); });
+                    found = true;
+                } else {
+                    scalar();
+                }
+            });
+            if (!found) fail("no \"accounts\" array");
+        } else {
+            array([&] { out.push_back(entry()); });
+        }
+        skip();
+        if (i_ != s_.size()) fail("trailing data");
+        return out;
+    }
+
+private:
+    const std::string &s_;
+    size_t i_ = 0;
+
+    [[noreturn]] void fail(const std::string &what) {
+        throw std::runtime_error("JSON offset " + std::to_string(i_) + ": " + what);
+    }
+    void skip() {
+        while (i_ < s_.size() && isspace(static_cast<unsigned char>(s_[i_]))) i_++;
+    }
+    char peek() {
+        skip();
+        return i_ < s_.size() ? s_[i_] : '\0';
+    }
+    void expect(char c) {
+        if (peek() != c) fail(std::string("expected '") + c + "'");
+        i_++;
+    }
+
+    template <typename F> void array(F each) {
+        expect('[');
+        if (peek() == ']') { i_++; return; }
+        do { each(); } while (peek() == ',' && ++i_);
+        expect(']');
+    }
+
+    template <typename F> void object(F each) {
+        expect('{');
+        if (peek() == '}') { i_++; return; }
+        do {
+            std::string key = string();
+            expect(':');
+            each(key);
+        } while (peek() == ',' && ++i_);
+        expect('}');
+    }
+
+    Entry entry() {
+        Entry e;
+        object([&](const std::string &key) { set_field(e, key, scalar()); });
+        return e;
+    }
+
+    // A string, number, true/false or null, as text.
+    std::string scalar() {
+        if (peek() == '"') return string();
+        size_t start = i_;
+        while (i_ < s_.size() && (isalnum(static_cast<unsigned char>(s_[i_])) ||
+                                  s_[i_] == '-' || s_[i_] == '+' || s_[i_] == '.')) {
+            i_++;
+        }
+        std::string word = s_.substr(start, i_ - start);
+        if (word.empty()) fail("expected a value");
+        return word == "null" ? std::string() : word;
+    }
+
+    std::string string() {
+        expect('"');
+        std::string out;
+        while (i_ < s_.size() && s_[i_] != '"') {
+            char c = s_[i_++];
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (i_ >= s_.size()) break;
+            c = s_[i_++];
+            switch (c) {
+                case 'n': out += '\n'; break;
+                case 't': out += '\t'; break;
+                case 'r': out += '\r'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'u': {
+                    unsigned cp = 0;
+                    for (int k = 0; k < 4; k++, i_++) {
+                        if (i_ >= s_.size() || !isxdigit(static_cast<unsigned char>(s_[i_]))) {
+                            fail("bad \\u escape");
+                        }
+                        int h = tolower(static_cast<unsigned char>(s_[i_]));
+                        cp = cp * 16 + static_cast<unsigned>(isdigit(h) ? h - '0' : h - 'a' + 10);
+                    }
+                    // UTF-8; surrogate pairs are not needed for account data.
+                    if (cp < 0x80) {
+                        out += static_cast<char>(cp);
+                    } else if (cp < 0x800) {
+                        out += static_cast<char>(0xC0 | (cp >> 6));
+                        out += static_cast<char>(0x80 | (cp & 0x3F));
+                    } else {
+                        out += static_cast<char>(0xE0 | (cp >> 12));
+                        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                        out += static_cast<char>(0x80 | (cp & 0x3F));
+                    }
+                    break;
+                }
+                default: out += c; break;   // \" \\ \/
+            }
+        }
+        expect('"');
+        return out;
+    }
+};
+
+std::vector<Entry> load_entries(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("cannot open " + path);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    std::string text = ss.str();
+
+    bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+    std::vector<Entry> entries = json ? JsonReader(text).entries() : load_csv(text);
+
+    std::set<std::string> names;
+    std::set<int> ids;
+    for (const Entry &e : entries) {
+        if (e.name.empty()) throw std::runtime_error("account without a name");
+        if (!names.insert(e.name).second) throw std::runtime_error("duplicate name " + e.name);
+        if (e.id >= ACCOUNT_MAX) throw std::runtime_error("id out of range for " + e.name);
+        if (e.id >= 0 && !ids.insert(e.id).second) {
+            throw std::runtime_error("duplicate id " + std::to_string(e.id));
+        }
+    }
+    return entries;
+}
+
+// The record exactly as the firmware would store it.
+Bytes encode(const Entry &e) {
+    account acc = {};
+    acc.name = e.name.data();
+    acc.name_len = e.name.size();
+    acc.username = e.username.data();
+    acc.username_len = e.username.size();
+    acc.password = e.password.data();
+    acc.password_len = e.password.size();
+    Bytes seed(ACCOUNT_SEED_MAX);
+    if (!e.totp_secret.empty()) {
+        int n = base32_decode_len(e.totp_secret.data(), e.totp_secret.size(), seed.data(),
+                                  seed.size());
+        if (n <= 0) throw std::runtime_error("totp_secret of " + e.name + " is not Base32");
+        acc.totp_seed = seed.data();
+        acc.totp_seed_len = static_cast<size_t>(n);
+    }
+    acc.totp_digits = static_cast<uint8_t>(e.totp_digits);
+    acc.totp_period = static_cast<uint16_t>(e.totp_period);
+    acc.totp_hash = static_cast<uint8_t>(e.totp_hash);
+    if (e.hotp_counter >= 0) {
+        // The HOTP fields ride with the TOTP ones, which need a digit count.
+        if (acc.totp_digits == 0) acc.totp_digits = 6;
+        acc.hotp = true;
+        acc.hotp_counter = static_cast<uint64_t>(e.hotp_counter);
+    }
+
+    Bytes out(PROVISION_MAX_PAYLOAD - 2);
+    int len = account_encode(&acc, out.data(), out.size());
+    if (len < 0) throw std::runtime_error("account " + e.name + " is too large");
+    out.resize(static_cast<size_t>(len));
+    return out;
+}
+
+//--------------------------------------------------------------------+
+// Link
+//--------------------------------------------------------------------+
+
+struct Reply {
+    uint8_t type = 0;
+    uint8_t seq = 0;
+    Bytes payload;
+};
+
+class Link {
+public:
+    explicit Link(const std::string &path) {
+        fd_ = open(path.c_str(), O_RDWR | O_NOCTTY);
+        if (fd_ < 0) throw std::runtime_error("cannot open " + path + ": " + strerror(errno));
+        termios tio;
+        if (tcgetattr(fd_, &tio) == 0) {
+            cfmakeraw(&tio);
+            tcsetattr(fd_, TCSANOW, &tio);
+        }
+        tcflush(fd_, TCIOFLUSH);
+    }
+    ~Link() { close(fd_); }
+    Link(const Link &) = delete;
+    Link &operator=(const Link &) = delete;
+
+    void send(const Bytes &frame) {
+        size_t off = 0;
+        while (off < frame.size()) {
+            ssize_t n = write(fd_, frame.data() + off, frame.size() - off);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error(std::string("write: ") + strerror(errno));
+            }
+            off += static_cast<size_t>(n);
+        }
+        bytes_out += frame.size();
+    }
+
+    // Waits up to 'timeout_ms' for the next well-formed frame.
+    bool receive(Reply &r, int timeout_ms) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        while (!take(r)) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    deadline - std::chrono::steady_clock::now()).count();
+            if (left <= 0) return false;
+            pollfd pfd = { fd_, POLLIN, 0 };
+            if (poll(&pfd, 1, static_cast<int>(left)) <= 0) continue;
+            uint8_t buf[4096];
+            ssize_t n = read(fd_, buf, sizeof(buf));
+            if (n > 0) {
+                rx_.insert(rx_.end(), buf, buf + n);
+                bytes_in += static_cast<size_t>(n);
+            }
+        }
+        return true;
+    }
+
+    size_t bytes_out = 0, bytes_in = 0;
+
+private:
+    int fd_;
+    Bytes rx_;
+
+    bool take(Reply &r) {
+        size_t pos = 0;
+        bool found = false;
+        while (pos + PROVISION_FRAME_OVERHEAD <= rx_.size()) {
+            const uint8_t *f = rx_.data() + pos;
+            size_t len = get_le16(f + 4);
+            if (f[0] != PROVISION_SYNC0 || f[1] != PROVISION_SYNC1 || len > PROVISION_MAX_PAYLOAD) {
+                pos++;
+                continue;
+            }
+            if (pos + len + PROVISION_FRAME_OVERHEAD > rx_.size()) break;
+            if (get_le32(f + 6 + len) != crc32_update(0, f + 2, 4 + len)) {
+                pos++;
+                continue;
+            }
+            r.type = f[2];
+            r.seq = f[3];
+            r.payload.assign(f + 6, f + 6 + len);
+            pos += len + PROVISION_FRAME_OVERHEAD;
+            found = true;
+            break;
+        }
+        rx_.erase(rx_.begin(), rx_.begin() + static_cast<std::ptrdiff_t>(pos));
+        return found;
+    }
+};
+
+Bytes make_frame(uint8_t type, uint8_t seq, const Bytes &payload) {
+    Bytes frame(payload.size() + PROVISION_FRAME_OVERHEAD);
+    size_t n = provision_frame(frame.data(), type, seq, payload.data(), payload.size());
+    frame.resize(n);
+    return frame;
+}
+
+struct Request {
+    uint8_t type;
+    Bytes payload;
+};
+
+class Session {
+public:
+    explicit Session(Link &link, unsigned max_window) : link_(link) {
+        seq_ = static_cast<uint8_t>(std::time(nullptr));
+        Reply r = call(PROVISION_HELLO, {});
+        if (r.type != PROVISION_DATA || r.payload.size() < 8 || r.payload[0] != PROVISION_VERSION) {
+            throw std::runtime_error("device speaks an unknown protocol version");
+        }
+        window_ = std::min<unsigned>(max_window, r.payload[1]);
+        accounts = get_le16(&r.payload[4]);
+        capacity = get_le16(&r.payload[6]);
+    }
+
+    // One request, resent until answered.
+    Reply call(uint8_t type, const Bytes &payload) {
+        uint8_t seq = seq_++;
+        Bytes frame = make_frame(type, seq, payload);
+        for (int attempt = 0; attempt < kRetries; attempt++) {
+            link_.send(frame);
+            frames++;
+            Reply r;
+            while (link_.receive(r, kTimeoutMs)) {
+                if (r.seq == seq && r.type != PROVISION_NAK) return r;
+                if (r.type == PROVISION_NAK) break;
+            }
+        }
+        throw std::runtime_error("device not responding");
+    }
+
+    // Sends 'reqs' with up to 'window' in flight, going back to the first
+    // frame the device NAKs or that times out. Returns each request's status.
+    std::vector<uint8_t> pipeline(const std::vector<Request> &reqs) {
+        std::vector<Bytes> frames_out;
+        uint8_t first = seq_;
+        for (const Request &q : reqs) frames_out.push_back(make_frame(q.type, seq_++, q.payload));
+
+        std::vector<uint8_t> status(reqs.size(), PROVISION_OK);
+        size_t base = 0, next = 0;
+        int timeouts = 0;
+        while (base < reqs.size()) {
+            while (next < reqs.size() && next - base < window_) {
+                link_.send(frames_out[next++]);
+                frames++;
+            }
+            Reply r;
+            if (!link_.receive(r, kTimeoutMs)) {
+                if (++timeouts == kRetries) throw std::runtime_error("device not responding");
+                next = base;
+                continue;
+            }
+            // Sequence numbers are 8 bits; the window keeps them unambiguous.
+            size_t idx = base + static_cast<uint8_t>(r.seq - static_cast<uint8_t>(first + base));
+            if (r.type == PROVISION_ACK && idx < next) {
+                // ACKs arrive in order, so one also covers everything before it.
+                status[idx] = r.payload.empty() ? static_cast<uint8_t>(PROVISION_ERR_ARG)
+                                                : r.payload[0];
+                base = idx + 1;
+                timeouts = 0;
+            } else if (r.type == PROVISION_NAK && idx <= next) {
+                next = idx;
+                retransmits++;
+            }
+        }
+        return status;
+    }
+
+    unsigned window() const { return window_; }
+
+    unsigned accounts = 0, capacity = 0;
+    size_t frames = 0, retransmits = 0;
+
+private:
+    static constexpr int kRetries = 8;
+    static constexpr int kTimeoutMs = 500;
+
+    Link &link_;
+    uint8_t seq_;
+    unsigned window_ = 1;
+};
+
+struct DeviceAccount {
+    uint16_t id;
+    uint32_t crc;
+    std::string name;
+};
+
+std::vector<DeviceAccount> list_device(Session &s) {
+    std::vector<DeviceAccount> out;
+    for (;;) {
+        Bytes req;
+        put_le16(req, static_cast<uint16_t>(out.size()));
+        Reply r = s.call(PROVISION_LIST, req);
+        if (r.type == PROVISION_ACK && !r.payload.empty() && r.payload[0] == PROVISION_ERR_LOCKED) {
+            throw std::runtime_error("device is locked: enter the PIN on the device first");
+        }
+        if (r.type != PROVISION_DATA || r.payload.size() < 4) throw std::runtime_error("LIST failed");
+        size_t total = get_le16(&r.payload[0]);
+        size_t off = 4;
+        while (off + 7 <= r.payload.size()) {
+            DeviceAccount a;
+            a.id = get_le16(&r.payload[off]);
+            a.crc = get_le32(&r.payload[off + 2]);
+            size_t len = r.payload[off + 6];
+            a.name.assign(reinterpret_cast<const char *>(&r.payload[off + 7]), len);
+            out.push_back(a);
+            off += 7 + len;
+        }
+        if (out.size() >= total || off == 4) return out;
+    }
+}
+
+//--------------------------------------------------------------------+
+// Commands
+//--------------------------------------------------------------------+
+
+int cmd_list(Session &s) {
+    for (const DeviceAccount &a : list_device(s)) {
+        std::printf("%5u  %08x  %s\n", a.id, a.crc, a.name.c_str());
+    }
+    std::printf("%u of %u accounts\n", s.accounts, s.capacity);
+    return 0;
+}
+
+// Quotes a CSV field when it needs it (RFC 4180).
+std::string csv_field(const std::string &value) {
+    if (value.find_first_of(",\"\r\n") == std::string::npos) return value;
+    std::string out = "\"";
+    for (char c : value) {
+        if (c == '"') out += '"';
+        out += c;
+    }
+    return out + "\"";
+}
+
+int cmd_export(Session &s) {
+    std::printf("id,name,username,password,totp_secret,totp_digits,totp_period,totp_algorithm,"
+                "hotp_counter\n");
+    for (const DeviceAccount &a : list_device(s)) {
+        Bytes req;
+        put_le16(req, a.id);
+        Reply r = s.call(PROVISION_GET, req);
+        account acc;
+        if (r.type != PROVISION_DATA ||
+            account_decode(r.payload.data(), r.payload.size(), &acc) != 0) {
+            throw std::runtime_error("GET failed for " + a.name);
+        }
+
+        std::string secret(acc.totp_secret, acc.totp_secret_len);
+        if (acc.totp_seed_len != 0) {
+            std::vector<char> text(BASE32_ENCODED_SIZE(acc.totp_seed_len));
+            base32_encode(acc.totp_seed, acc.totp_seed_len, text.data(), text.size());
+            secret = text.data();
+        }
+        std::string digits, period, algorithm, counter;
+        if (acc.totp_digits != 0) {
+            digits = std::to_string(acc.totp_digits);
+            period = std::to_string(acc.totp_period);
+            algorithm = totp_hash_name(acc.totp_hash);
+            if (acc.hotp) counter = std::to_string(acc.hotp_counter);
+        }
+        const std::string fields[] = {
+            std::to_string(a.id), std::string(acc.name, acc.name_len),
+            std::string(acc.username, acc.username_len), std::string(acc.password, acc.password_len),
+            secret, digits, period, algorithm, counter,
+        };
+        std::string line;
+        for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+            if (i) line += ',';
+            line += csv_field(fields[i]);
+        }
+        std::printf("%s\n", line.c_str());
+    }
+    return 0;
+}
+
+int cmd_time(Session &s, uint32_t unix_time) {
+    Bytes req = { static_cast<uint8_t>(unix_time), static_cast<uint8_t>(unix_time >> 8),
+                  static_cast<uint8_t>(unix_time >> 16), static_cast<uint8_t>(unix_time >> 24) };
+    Reply r = s.call(PROVISION_SET_TIME, req);
+    bool ok = r.type == PROVISION_ACK && !r.payload.empty() && r.payload[0] == PROVISION_OK;
+    std::printf("time %s: %lu\n", ok ? "set" : "rejected", static_cast<unsigned long>(unix_time));
+    return ok ? 0 : 1;
+}
+
+int cmd_push(Session &s, Link &link, const std::string &path, bool prune, bool dry_run) {
+    std::vector<Entry> entries = load_entries(path);
+    std::vector<DeviceAccount> device = list_device(s);
+
+    std::map<std::string, const DeviceAccount *> by_name;
+    std::map<uint16_t, const DeviceAccount *> by_id;
+    for (const DeviceAccount &a : device) {
+        by_name[a.name] = &a;
+        by_id[a.id] = &a;
+    }
+
+    // Resolve ids: pinned, else the device's, else the lowest free one.
+    std::set<int> taken;
+    for (Entry &e : entries) {
+        auto it = by_name.find(e.name);
+        if (e.id < 0 && it != by_name.end()) e.id = it->second->id;
+        if (e.id >= 0 && !taken.insert(e.id).second) {
+            throw std::runtime_error("id " + std::to_string(e.id) + " used twice");
+        }
+    }
+    int free_id = 0;
+    for (Entry &e : entries) {
+        if (e.id >= 0) continue;
+        while (taken.count(free_id) || by_id.count(static_cast<uint16_t>(free_id))) free_id++;
+        if (free_id >= ACCOUNT_MAX) throw std::runtime_error("device is full");
+        e.id = free_id;
+        taken.insert(free_id);
+    }
+
+    std::vector<Request> reqs;
+    std::vector<std::string> what;
+    size_t added = 0, changed = 0, unchanged = 0, removed = 0, kept = 0;
+
+    // Deletes first, so that they make room for the writes.
+    if (prune) {
+        for (const DeviceAccount &a : device) {
+            if (taken.count(a.id)) continue;
+            Bytes req;
+            put_le16(req, a.id);
+            reqs.push_back({ PROVISION_DELETE, req });
+            what.push_back("- " + std::to_string(a.id) + " " + a.name);
+            removed++;
+        }
+    } else {
+        for (const DeviceAccount &a : device) kept += !taken.count(a.id);
+    }
+
+    for (const Entry &e : entries) {
+        Bytes record = encode(e);
+        auto it = by_id.find(static_cast<uint16_t>(e.id));
+        if (it != by_id.end() && it->second->crc == crc32_update(0, record.data(), record.size())) {
+            unchanged++;
+            continue;
+        }
+        Bytes req;
+        put_le16(req, static_cast<uint16_t>(e.id));
+        req.insert(req.end(), record.begin(), record.end());
+        reqs.push_back({ PROVISION_PUT, req });
+        bool is_new = it == by_id.end();
+        what.push_back((is_new ? "+ " : "~ ") + std::to_string(e.id) + " " + e.name);
+        (is_new ? added : changed)++;
+    }
+
+    for (const std::string &w : what) std::printf("%s\n", w.c_str());
+    std::printf("%zu added, %zu changed, %zu removed, %zu unchanged", added, changed, removed, unchanged);
+    if (kept) std::printf(", %zu not in file (kept; --prune deletes)", kept);
+    std::printf("\n");
+    if (dry_run || reqs.empty()) return 0;
+
+    reqs.push_back({ PROVISION_COMMIT, {} });
+    size_t out0 = link.bytes_out, in0 = link.bytes_in;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<uint8_t> status = s.pipeline(reqs);
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int failed = 0;
+    for (size_t i = 0; i < status.size(); i++) {
+        if (status[i] == PROVISION_OK) continue;
+        std::fprintf(stderr, "failed (status %u): %s\n", status[i],
+                     i < what.size() ? what[i].c_str() : "commit");
+        failed++;
+    }
+    size_t bytes = (link.bytes_out - out0) + (link.bytes_in - in0);
+    std::printf("%zu requests in %.3f s, window %u, %zu retransmits, %.1f KB/s\n",
+                reqs.size(), secs, s.window(), s.retransmits, bytes / secs / 1000.0);
+    return failed ? 1 : 0;
+}
+
+void usage() {
+    std::fprintf(stderr,
+                 "usage: vaultctl [-d device] [-w window] push <file.csv|file.json> [--prune] [--dry-run]\n"
+                 "       vaultctl [-d device] diff <file.csv|file.json> [--prune]\n"
+                 "       vaultctl [-d device] list\n"
+                 "       vaultctl [-d device] export\n"
+                 "       vaultctl [-d device] time [unix_time]\n");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::string device = "/dev/ttyACM0";
+    unsigned window = PROVISION_WINDOW;
+    std::vector<std::string> args;
+    bool prune = false, dry_run = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        if (a == "-d" && i + 1 < argc) {
+            device = argv[++i];
+        } else if (a == "-w" && i + 1 < argc) {
+            window = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+        } else if (a == "--prune") {
+            prune = true;
+        } else if (a == "--dry-run") {
+            dry_run = true;
+        } else {
+            args.push_back(a);
+        }
+    }
+    if (args.empty()) {
+        usage();
+        return 2;
+    }
+
+    try {
+        const std::string &cmd = args[0];
+        if ((cmd == "push" || cmd == "diff") && args.size() == 2) {
+            Link link(device);
+            Session s(link, window);
+            return cmd_push(s, link, args[1], prune, dry_run || cmd == "diff");
+        } else if (cmd == "list" && args.size() == 1) {
+            Link link(device);
+            Session s(link, window);
+            return cmd_list(s);
+        } else if (cmd == "export" && args.size() == 1) {
+            Link link(device);
+            Session s(link, window);
+            return cmd_export(s);
+        } else if (cmd == "time" && args.size() <= 2) {
+            uint32_t t = args.size() == 2 ? static_cast<uint32_t>(std::stoul(args[1]))
+                                          : static_cast<uint32_t>(std::time(nullptr));
+            Link link(device);
+            Session s(link, window);
+            return cmd_time(s, t);
+        }
+        usage();
+        return 2;
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "vaultctl: %s\n", e.what());
+        return 1;
+    }
+}
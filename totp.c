@@ -1,6 +1,7 @@
 #include "totp.h"
 #include "base32.h"
 #include "sha1.h"
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -9,43 +10,138 @@
 #define CFG_TUD_HID 1
 
 
-int totp(uint64_t current_time, const char *base32key, int step_secs, int digits,
-         char *otp, size_t otp_size, int *time_remaining) {
-    uint8_t key_bytes[64];  // Buffer for decoded secret key.
+int totp_key_init(totp_key *key, const char *base32key, totp_hash hash) {
+    uint8_t key_bytes[SHA512_BLOCK_SIZE];  // Buffer for decoded secret key.
     int key_len = base32_decode(base32key, key_bytes, sizeof(key_bytes));
     if (key_len <= 0) {
         return -1;
     }
 
-    // Calculate time counter (steps since epoch).
-    uint64_t counter = current_time / step_secs;
+    int ret = totp_key_set(key, key_bytes, (size_t)key_len, hash);
+    memset(key_bytes, 0, sizeof(key_bytes));
+    return ret;
+}
+
+int totp_key_set(totp_key *key, const uint8_t *secret, size_t len, totp_hash hash) {
+    if (len == 0) {
+        return -1;
+    }
+
+    key->hash = hash;
+    switch (hash) {
+        case TOTP_SHA1:
+            hmac_sha1_setkey(&key->hmac.sha1, secret, len);
+            return 0;
+        case TOTP_SHA256:
+            hmac_sha256_setkey(&key->hmac.sha256, secret, len);
+            return 0;
+        case TOTP_SHA512:
+            hmac_sha512_setkey(&key->hmac.sha512, secret, len);
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+// HMAC of the 8-byte counter with the key's hash; returns the digest size.
+static size_t totp_hmac(const totp_key *key, const uint8_t counter_bytes[8],
+                        uint8_t digest[SHA512_DIGEST_SIZE]) {
+    switch (key->hash) {
+        case TOTP_SHA256:
+            hmac_sha256_mac(&key->hmac.sha256, counter_bytes, 8, digest);
+            return SHA256_DIGEST_SIZE;
+        case TOTP_SHA512:
+            hmac_sha512_mac(&key->hmac.sha512, counter_bytes, 8, digest);
+            return SHA512_DIGEST_SIZE;
+        default:
+            hmac_sha1_mac(&key->hmac.sha1, counter_bytes, 8, digest);
+            return SHA1_DIGEST_SIZE;
+    }
+}
+
+// Computes the HOTP value for one counter and formats it into 'otp'.
+static void totp_code(const totp_key *key, uint64_t counter, uint32_t divisor, int digits,
+                      char *otp, size_t otp_size) {
     uint8_t counter_bytes[8];
     for (int i = 0; i < 8; i++) {
         counter_bytes[7 - i] = (uint8_t)(counter >> (8 * i));
     }
 
-    // Compute HMAC-SHA1 of the time counter using the secret key.
-    uint8_t hmac_result[20];
-    hmac_sha1(key_bytes, key_len, counter_bytes, sizeof(counter_bytes), hmac_result);
+    // HMAC of the time counter using the cached key midstates.
+    uint8_t hmac_result[SHA512_DIGEST_SIZE];
+    size_t hmac_len = totp_hmac(key, counter_bytes, hmac_result);
 
     // Dynamic truncation to extract a 31-bit code.
-    int offset = hmac_result[19] & 0x0F;
+    int offset = hmac_result[hmac_len - 1] & 0x0F;
     uint32_t code = ((hmac_result[offset] & 0x7F) << 24) |
                     ((hmac_result[offset+1] & 0xFF) << 16) |
                     ((hmac_result[offset+2] & 0xFF) << 8) |
                     (hmac_result[offset+3] & 0xFF);
 
-    // Compute OTP value modulo 10^digits.
+    // Format OTP as a zero-padded string.
+    snprintf(otp, otp_size, "%0*u", digits, (unsigned)(code % divisor));
+}
+
+// Returns 10^digits.
+static uint32_t totp_divisor(int digits) {
     uint32_t divisor = 1;
     for (int i = 0; i < digits; i++) {
         divisor *= 10;
     }
-    uint32_t otp_value = code % divisor;
+    return divisor;
+}
 
-    // Format OTP as a zero-padded string.
-    snprintf(otp, otp_size, "%0*u", digits, otp_value);
+static bool totp_digits_valid(int digits) {
+    return digits > 0 && digits <= TOTP_MAX_DIGITS;
+}
+
+int totp_with_key(const totp_key *key, uint64_t current_time, int step_secs, int digits,
+                  char *otp, size_t otp_size, int *time_remaining) {
+    if (step_secs <= 0 || !totp_digits_valid(digits)) {
+        return -1;
+    }
+
+    // Calculate time counter (steps since epoch).
+    uint64_t counter = current_time / step_secs;
+    totp_code(key, counter, totp_divisor(digits), digits, otp, otp_size);
 
     // Calculate seconds until OTP expires.
     *time_remaining = step_secs - (current_time % step_secs);
     return 0;
 }
+
+int hotp_with_key(const totp_key *key, uint64_t counter, int digits, char *otp, size_t otp_size) {
+    if (!totp_digits_valid(digits)) {
+        return -1;
+    }
+    totp_code(key, counter, totp_divisor(digits), digits, otp, otp_size);
+    return 0;
+}
+
+int totp_window(const totp_key *key, uint64_t current_time, int step_secs, int digits,
+                int first_offset, size_t count, char *codes, size_t code_size) {
+    if (step_secs <= 0 || code_size == 0 || !totp_digits_valid(digits)) {
+        return -1;
+    }
+
+    uint64_t counter = current_time / step_secs;
+    if (first_offset < 0 && (uint64_t)(-(int64_t)first_offset) > counter) {
+        return -1;
+    }
+    counter += (int64_t)first_offset;
+
+    uint32_t divisor = totp_divisor(digits);
+    for (size_t i = 0; i < count; i++) {
+        totp_code(key, counter + i, divisor, digits, codes + i * code_size, code_size);
+    }
+    return (int)count;
+}
+
+int totp(uint64_t current_time, const char *base32key, totp_hash hash, int step_secs,
+         int digits, char *otp, size_t otp_size, int *time_remaining) {
+    totp_key key;
+    if (totp_key_init(&key, base32key, hash) != 0) {
+        return -1;
+    }
+    return totp_with_key(&key, current_time, step_secs, digits, otp, otp_size, time_remaining);
+}
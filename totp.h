@@ -3,18 +3,78 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include "sha1.h"
+#include "sha256.h"
+#include "sha512.h"
+
+// HMAC hash a secret was issued for (RFC 6238 allows SHA-1, SHA-256 and
+// SHA-512; SHA-1 is what almost every service uses).
+typedef enum {
+    TOTP_SHA1 = 0,
+    TOTP_SHA256 = 1,
+    TOTP_SHA512 = 2,
+} totp_hash;
+
+// Decoded TOTP secret with its HMAC midstates precomputed.
+// Build once per secret with totp_key_init(); each code then costs two
+// compressions of the chosen hash.
+typedef struct {
+    totp_hash hash;
+    union {
+        hmac_sha1_key sha1;
+        hmac_sha256_key sha256;
+        hmac_sha512_key sha512;
+    } hmac;
+} totp_key;
 
 // Generates a Time-based One-Time Password (TOTP).
 // Parameters:
 //   current_time   - current Unix time in seconds.
 //   base32key      - Base32-encoded secret key.
+//   hash           - HMAC hash the secret was issued for.
 //   step_secs      - time step in seconds (e.g., 30).
 //   digits         - number of digits for the OTP (e.g., 6).
 //   otp            - output buffer for the OTP string.
 //   otp_size       - size of the output buffer.
 //   time_remaining - pointer to store seconds until the OTP expires.
 // Returns 0 on success, or -1 on error.
-int totp(uint64_t current_time, const char *base32key, int step_secs, int digits,
-         char *otp, size_t otp_size, int *time_remaining);
+int totp(uint64_t current_time, const char *base32key, totp_hash hash, int step_secs,
+         int digits, char *otp, size_t otp_size, int *time_remaining);
+
+// Decodes 'base32key' and precomputes its HMAC midstates for 'hash' into 'key'.
+// Returns 0 on success, or -1 if the secret is not valid Base32 or the hash
+// is unknown.
+int totp_key_init(totp_key *key, const char *base32key, totp_hash hash);
+
+// Same as totp_key_init(), for a secret that is already decoded (as
+// accounts store it). Returns 0 on success, or -1 if 'secret' is empty or
+// the hash is unknown.
+int totp_key_set(totp_key *key, const uint8_t *secret, size_t len, totp_hash hash);
+
+// Same as totp(), but using a key prepared by totp_key_init().
+int totp_with_key(const totp_key *key, uint64_t current_time, int step_secs, int digits,
+                  char *otp, size_t otp_size, int *time_remaining);
+
+// Generates the HOTP (RFC 4226) code for 'counter' with a prepared key; TOTP
+// is the same computation with the time step as the counter.
+// Returns 0 on success, or -1 on error.
+int hotp_with_key(const totp_key *key, uint64_t counter, int digits, char *otp, size_t otp_size);
+
+// Most digits a code can have: 10^9 is the largest power of ten that fits
+// the 31-bit truncated HMAC value and a uint32_t divisor. Functions taking
+// 'digits' fail for anything outside 1..TOTP_MAX_DIGITS.
+#define TOTP_MAX_DIGITS 9
+
+// Size of one code slot in the buffers filled by totp_window().
+#define TOTP_CODE_SIZE 10
+
+// Generates codes for 'count' consecutive time steps in one call, starting
+// 'first_offset' steps from the step containing 'current_time'. For example
+// first_offset = -1, count = 3 yields the codes for t-1, t and t+1.
+//   codes     - output buffer holding 'count' zero-terminated codes,
+//               each 'code_size' bytes apart (TOTP_CODE_SIZE is enough).
+// Returns the number of codes written, or -1 on error.
+int totp_window(const totp_key *key, uint64_t current_time, int step_secs, int digits,
+                int first_offset, size_t count, char *codes, size_t code_size);
 
 #endif // TOTP_H
@@ -0,0 +1,226 @@
+#include "totp_worker.h"
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+// Longest wait totp_worker_poll() asks for when no boundary is closer.
+#define TOTP_WORKER_IDLE_MS 1000
+
+//--------------------------------------------------------------------+
+// Sequence locks
+//--------------------------------------------------------------------+
+// Single writer, lock-free readers: the writer makes the counter odd while it
+// updates the data; a reader retries if the counter was odd or changed while
+// it was copying. __dmb() is also a compiler barrier.
+
+static inline void seq_write_begin(volatile uint32_t *seq) {
+    *seq = *seq + 1;
+    __dmb();
+}
+
+static inline void seq_write_end(volatile uint32_t *seq) {
+    __dmb();
+    *seq = *seq + 1;
+}
+
+static inline uint32_t seq_read_begin(const volatile uint32_t *seq) {
+    uint32_t s;
+    while ((s = *seq) & 1) {
+        tight_loop_contents();
+    }
+    __dmb();
+    return s;
+}
+
+static inline bool seq_read_retry(const volatile uint32_t *seq, uint32_t s) {
+    __dmb();
+    return *seq != s;
+}
+
+//--------------------------------------------------------------------+
+// Shared state
+//--------------------------------------------------------------------+
+
+// Written by the setter's core, read by core 1.
+typedef struct {
+    uint32_t version;   // bumped on every change so stale codes can be spotted
+    bool valid;
+    int step_secs;
+    int digits;
+    totp_key key;
+} secret_data;
+
+// Written by core 1, read by anyone.
+typedef struct {
+    uint32_t version;   // secret_data.version the codes were computed from
+    bool valid;
+    int step_secs;
+    uint64_t step;      // time step of codes[0]
+    char codes[2][TOTP_CODE_SIZE];  // current and next step
+} code_data;
+
+typedef struct {
+    uint32_t unix_time;
+    uint32_t start_ms;
+} clock_data;
+
+static struct {
+    volatile uint32_t seq;
+    secret_data data;
+} secrets[TOTP_WORKER_MAX_SECRETS];
+
+static struct {
+    volatile uint32_t seq;
+    code_data data;
+} slots[TOTP_WORKER_MAX_SECRETS];
+
+static struct {
+    volatile uint32_t seq;
+    clock_data data;
+} wall_clock;
+
+static uint32_t now_ms(void) {
+    return to_ms_since_boot(get_absolute_time());
+}
+
+static clock_data read_clock(void) {
+    clock_data clk;
+    uint32_t s;
+    do {
+        s = seq_read_begin(&wall_clock.seq);
+        clk = wall_clock.data;
+    } while (seq_read_retry(&wall_clock.seq, s));
+    return clk;
+}
+
+uint64_t totp_worker_now(void) {
+    clock_data clk = read_clock();
+    return clk.unix_time + (uint32_t)(now_ms() - clk.start_ms) / 1000;
+}
+
+//--------------------------------------------------------------------+
+// Core 1
+//--------------------------------------------------------------------+
+
+// What core 1 last published for each slot.
+static uint32_t computed_version[TOTP_WORKER_MAX_SECRETS];
+static uint64_t computed_step[TOTP_WORKER_MAX_SECRETS];
+static bool computed[TOTP_WORKER_MAX_SECRETS];
+
+uint32_t totp_worker_poll(void) {
+    secret_data secret;
+    clock_data clk = read_clock();
+
+    // Same clock as totp_worker_now(), kept in ms to find the next boundary.
+    uint64_t unix_ms = (uint64_t)clk.unix_time * 1000 + (uint32_t)(now_ms() - clk.start_ms);
+    uint64_t now = unix_ms / 1000;
+    uint32_t wait_ms = TOTP_WORKER_IDLE_MS;
+
+    for (int i = 0; i < TOTP_WORKER_MAX_SECRETS; i++) {
+        uint32_t s;
+        do {
+            s = seq_read_begin(&secrets[i].seq);
+            secret = secrets[i].data;
+        } while (seq_read_retry(&secrets[i].seq, s));
+
+        if (!secret.valid) {
+            computed[i] = false;
+            continue;
+        }
+
+        uint64_t step = now / secret.step_secs;
+        uint64_t step_ms = (uint64_t)secret.step_secs * 1000;
+        uint32_t until_boundary = (uint32_t)(step_ms - unix_ms % step_ms);
+        if (until_boundary < wait_ms) {
+            wait_ms = until_boundary;
+        }
+
+        if (computed[i] && computed_version[i] == secret.version && computed_step[i] == step) {
+            continue;
+        }
+
+        code_data codes;
+        codes.version = secret.version;
+        codes.valid = true;
+        codes.step_secs = secret.step_secs;
+        codes.step = step;
+        totp_window(&secret.key, now, secret.step_secs, secret.digits,
+                    0, 2, &codes.codes[0][0], TOTP_CODE_SIZE);
+
+        seq_write_begin(&slots[i].seq);
+        slots[i].data = codes;
+        seq_write_end(&slots[i].seq);
+
+        computed[i] = true;
+        computed_version[i] = secret.version;
+        computed_step[i] = step;
+    }
+    memset(&secret.key, 0, sizeof(secret.key));
+    return wait_ms;
+}
+
+//--------------------------------------------------------------------+
+// Setters and readers
+//--------------------------------------------------------------------+
+
+void totp_worker_set_time(uint32_t unix_time, uint32_t start_ms) {
+    seq_write_begin(&wall_clock.seq);
+    wall_clock.data.unix_time = unix_time;
+    wall_clock.data.start_ms = start_ms;
+    seq_write_end(&wall_clock.seq);
+    __sev();
+}
+
+void totp_worker_set_secret(int index, const totp_key *key, int step_secs, int digits) {
+    if (index < 0 || index >= TOTP_WORKER_MAX_SECRETS) return;
+
+    seq_write_begin(&secrets[index].seq);
+    secret_data *data = &secrets[index].data;
+    data->version++;
+    data->valid = (key != NULL && step_secs > 0);
+    if (data->valid) {
+        data->key = *key;
+        data->step_secs = step_secs;
+        data->digits = digits;
+    } else {
+        memset(&data->key, 0, sizeof(data->key));
+    }
+    seq_write_end(&secrets[index].seq);
+    __sev();
+}
+
+bool totp_worker_get(int index, uint64_t current_time, char *otp, size_t otp_size,
+                     int *time_remaining) {
+    if (index < 0 || index >= TOTP_WORKER_MAX_SECRETS || otp_size == 0) return false;
+
+    code_data codes;
+    uint32_t s;
+    do {
+        s = seq_read_begin(&slots[index].seq);
+        codes = slots[index].data;
+    } while (seq_read_retry(&slots[index].seq, s));
+
+    // A single aligned word, so the version can be read without the seqlock:
+    // a secret replaced after this point simply wasn't visible yet.
+    uint32_t version = *(const volatile uint32_t *)&secrets[index].data.version;
+    if (!codes.valid || codes.version != version) return false;
+
+    // Right after a boundary core 1 may not have refreshed yet; the code it
+    // prepared as "next" is then the current one.
+    uint64_t step = current_time / codes.step_secs;
+    const char *code;
+    if (step == codes.step) {
+        code = codes.codes[0];
+    } else if (step == codes.step + 1) {
+        code = codes.codes[1];
+    } else {
+        return false;
+    }
+
+    strncpy(otp, code, otp_size - 1);
+    otp[otp_size - 1] = '\0';
+    *time_remaining = codes.step_secs - (current_time % codes.step_secs);
+    return true;
+}
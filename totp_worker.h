@@ -0,0 +1,40 @@
+#ifndef TOTP_WORKER_H
+#define TOTP_WORKER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "totp.h"
+
+// Core 1 keeps the current and next TOTP codes for every configured secret
+// precomputed, refreshing them at each time-step boundary. Readers only copy
+// a ready code out of a lock-free (sequence-counted) slot. The setters may be
+// called from either core, but only ever from one of them.
+
+// Maximum number of secrets the worker keeps codes for: the worker's own
+// secret and up to 15 TOTP accounts. Each costs about 0.5 KB of RAM.
+#define TOTP_WORKER_MAX_SECRETS 16
+
+// Core 1: recomputes any codes that are due and returns how many ms may pass
+// before it needs to be called again. The setters wake core 1 with __sev().
+uint32_t totp_worker_poll(void);
+
+// Current unix time according to the last totp_worker_set_time().
+uint64_t totp_worker_now(void);
+
+// Sets the wall clock: 'unix_time' seconds was the time at 'start_ms' on the
+// board millisecond clock.
+void totp_worker_set_time(uint32_t unix_time, uint32_t start_ms);
+
+// Installs (or replaces) the prepared key for secret 'index'. Pass NULL to
+// remove it. The worker recomputes that secret's codes straight away.
+void totp_worker_set_secret(int index, const totp_key *key, int step_secs, int digits);
+
+// Copies the code for secret 'index' at 'current_time' into 'otp'.
+// Returns false if no precomputed code covers that time step yet, in which
+// case the caller should compute it synchronously.
+bool totp_worker_get(int index, uint64_t current_time, char *otp, size_t otp_size,
+                     int *time_remaining);
+
+#endif // TOTP_WORKER_H
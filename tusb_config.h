@@ -101,8 +101,8 @@
 #define CFG_TUD_HID_EP_BUFSIZE    16
 
 // Set CDC FIFO buffer sizes
-#define CFG_TUD_CDC_RX_BUFSIZE  (64)
-#define CFG_TUD_CDC_TX_BUFSIZE  (64)
+#define CFG_TUD_CDC_RX_BUFSIZE  (512)
+#define CFG_TUD_CDC_TX_BUFSIZE  (512)
 #define CFG_TUD_CDC_EP_BUFSIZE  (64)
 
 #ifndef CFG_TUD_ENDPOINT0_SIZE
@@ -0,0 +1,77 @@
+#include "uart_rx.h"
+
+#include <string.h>
+
+#include "hardware/dma.h"
+#include "hardware/sync.h"
+
+#define UART_RX_RING_MASK (UART_RX_RING_SIZE - 1)
+
+// The DMA ring wraps the write address on a UART_RX_RING_SIZE boundary.
+static uint8_t ring[UART_RX_RING_SIZE] __attribute__((aligned(UART_RX_RING_SIZE)));
+
+static int chan = -1;
+static uint32_t armed_start;   // stream position the current transfer began at
+static uint32_t armed_count;   // bytes the current transfer was armed for
+static uint32_t tail;          // stream position of the next byte to read
+
+// Stream position one past the last byte the DMA has written.
+static uint32_t rx_head(void) {
+  uint32_t remaining = dma_channel_hw_addr(chan)->transfer_count;
+  __dmb();
+  return armed_start + (armed_count - remaining);
+}
+
+// Re-arms the idle channel for all of the free space in the ring.
+static void rx_arm(void) {
+  uint32_t start = armed_start + armed_count;
+  uint32_t space = UART_RX_RING_SIZE - (start - tail);
+  if (space == 0) return;
+
+  armed_start = start;
+  armed_count = space;
+  dma_channel_set_write_addr(chan, &ring[start & UART_RX_RING_MASK], false);
+  dma_channel_set_trans_count(chan, space, true);
+}
+
+void uart_rx_start(uart_inst_t *uart) {
+  chan = dma_claim_unused_channel(true);
+
+  dma_channel_config c = dma_channel_get_default_config(chan);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+  channel_config_set_read_increment(&c, false);
+  channel_config_set_write_increment(&c, true);
+  channel_config_set_ring(&c, true, UART_RX_RING_BITS);
+  channel_config_set_dreq(&c, uart_get_dreq(uart, false));
+  dma_channel_configure(chan, &c, ring, &uart_get_hw(uart)->dr, 0, false);
+
+  armed_start = 0;
+  armed_count = 0;
+  tail = 0;
+  rx_arm();
+}
+
+size_t uart_rx_available(void) {
+  if (chan < 0) return 0;
+  return rx_head() - tail;
+}
+
+size_t uart_rx_read(uint8_t *dst, size_t max) {
+  if (chan < 0) return 0;
+
+  size_t n = rx_head() - tail;
+  if (n > max) n = max;
+
+  // At most two pieces: up to the end of the ring, then from its start.
+  size_t off = tail & UART_RX_RING_MASK;
+  size_t first = UART_RX_RING_SIZE - off;
+  if (first > n) first = n;
+  memcpy(dst, ring + off, first);
+  memcpy(dst + first, ring, n - first);
+  tail += (uint32_t)n;
+
+  if (!dma_channel_is_busy(chan)) {
+    rx_arm();
+  }
+  return n;
+}
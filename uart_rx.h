@@ -0,0 +1,34 @@
+#ifndef UART_RX_H
+#define UART_RX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hardware/uart.h"
+
+// DMA-fed receive ring for the provisioning UART. A DMA channel paced by the
+// UART RX DREQ copies bytes into a ring buffer without CPU involvement; the
+// consumer drains it with uart_rx_read(), which never blocks.
+//
+// The channel is only ever armed for the free part of the ring, so unread
+// bytes are never overwritten. When the ring is full the DMA stops, the UART
+// FIFO fills and, with hardware flow control enabled on the UART, RTS tells
+// the sender to pause until the consumer catches up.
+
+// Ring size; must be a power of two up to 32 KB (the DMA ring wraps on it).
+#ifndef UART_RX_RING_BITS
+#define UART_RX_RING_BITS 11
+#endif
+#define UART_RX_RING_SIZE (1u << UART_RX_RING_BITS)
+
+// Claims a DMA channel and starts receiving from 'uart', which must already
+// be initialised. Call once, from the core that will read.
+void uart_rx_start(uart_inst_t *uart);
+
+// Copies up to 'max' received bytes into 'dst' and returns how many.
+size_t uart_rx_read(uint8_t *dst, size_t max);
+
+// Number of received bytes waiting in the ring.
+size_t uart_rx_available(void);
+
+#endif // UART_RX_H
@@ -0,0 +1,629 @@
+#include "vault.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "crc32.h"
+
+#define VAULT_SECTOR_MAGIC 0x544C5656u  // "VVLT"
+#define VAULT_RECORD_MAGIC 0x5652u
+#define VAULT_SEQ_NONE     0xFFFFFFFFu
+
+#define VAULT_REC_PUT    0x01
+#define VAULT_REC_DELETE 0x02
+
+// Start of every sector. A formatted sector has 'seq' left erased until it is
+// opened for writing; the erase count survives because it is rewritten after
+// each erase.
+typedef struct {
+    uint32_t magic;
+    uint32_t erase_count;
+    uint32_t seq;           // order in which sectors were opened
+    uint32_t reserved;
+} sector_header;
+
+// Start of every record, followed by 'len' value bytes padded to 4 bytes.
+// Records are appended back to back after the sector header; an all-0xFF
+// header marks the end of the log in that sector.
+typedef struct {
+    uint16_t magic;
+    uint8_t type;           // VAULT_REC_PUT or VAULT_REC_DELETE
+    uint8_t flags;
+    uint16_t key;
+    uint16_t len;
+    uint32_t seq;           // newest record for a key wins
+    uint32_t crc;           // CRC-32 of the fields above and the value
+} record_header;
+
+#define SECTOR_HEADER_SIZE ((uint32_t)sizeof(sector_header))
+#define RECORD_HEADER_SIZE ((uint32_t)sizeof(record_header))
+
+enum {
+    SECTOR_FREE,            // formatted, not yet opened
+    SECTOR_ACTIVE,          // receiving appends
+    SECTOR_CLOSED,          // full or torn, waiting to be collected
+    SECTOR_BLANK,           // mount only: erased but not formatted
+    SECTOR_LEGACY,          // mount only: neither formatted nor erased
+};
+
+// Present while sectors of the old layout are being imported, so an import
+// cut short by power loss resumes on the next mount.
+#define IMPORT_KEY (VAULT_LEGACY_KEYS - 2)
+
+static struct {
+    uint32_t erase_count;
+    uint32_t seq;
+    uint16_t used;          // append offset within the sector
+    uint16_t live;          // bytes of records that are still current
+    uint8_t state;
+} sectors[VAULT_SECTOR_COUNT];
+
+// Offset of the newest record for each key, 0 if none. Everything else about
+// the record is read back from its header in flash.
+static uint32_t keys[VAULT_MAX_KEYS];
+
+static int active = -1;
+static uint32_t free_count;
+static uint32_t next_seq;
+static uint32_t next_sector_seq;
+static uint32_t gc_runs;
+static uint32_t migrated;
+
+static uint8_t page_buf[VAULT_PAGE_SIZE];
+
+#define PAGES_PER_SECTOR (VAULT_SECTOR_SIZE / VAULT_PAGE_SIZE)
+
+// Write-back staging for batches: the pages of one sector are assembled in
+// RAM and each is programmed once when the batch is flushed, instead of once
+// for every record that touches it.
+static struct {
+    bool enabled;
+    int sector;             // sector being staged, -1 if none
+    uint16_t dirty;         // bit n: page n of the sector is staged
+    uint8_t buf[VAULT_SECTOR_SIZE];
+} stage = { .sector = -1 };
+
+static bool collect_sector(int victim);
+
+//--------------------------------------------------------------------+
+// Flash access
+//--------------------------------------------------------------------+
+
+static uint32_t record_size(uint32_t len) {
+    return (RECORD_HEADER_SIZE + len + 3) & ~3u;
+}
+
+static void stage_flush(void) {
+    for (uint32_t p = 0; p < PAGES_PER_SECTOR; p++) {
+        if (stage.dirty & (1u << p)) {
+            flash_hal_program_page((uint32_t)stage.sector * VAULT_SECTOR_SIZE + p * VAULT_PAGE_SIZE,
+                                   stage.buf + p * VAULT_PAGE_SIZE);
+        }
+    }
+    stage.dirty = 0;
+    stage.sector = -1;
+}
+
+// Returns the staging copy of 'page', starting from its current flash
+// contents. Only one sector is staged at a time.
+static uint8_t *stage_page(uint32_t page) {
+    int s = (int)(page / VAULT_SECTOR_SIZE);
+    if (stage.sector != s) {
+        stage_flush();
+        stage.sector = s;
+    }
+    uint32_t p = (page % VAULT_SECTOR_SIZE) / VAULT_PAGE_SIZE;
+    uint8_t *dst = stage.buf + p * VAULT_PAGE_SIZE;
+    if (!(stage.dirty & (1u << p))) {
+        memcpy(dst, flash_hal_base() + page, VAULT_PAGE_SIZE);
+        stage.dirty |= (uint16_t)(1u << p);
+    }
+    return dst;
+}
+
+// Current contents at 'offset': staged bytes take precedence over flash.
+// A record's pages are staged together, so the pointer covers all of it.
+static const uint8_t *vault_ptr(uint32_t offset) {
+    if (stage.sector >= 0 && offset / VAULT_SECTOR_SIZE == (uint32_t)stage.sector &&
+        (stage.dirty & (1u << ((offset % VAULT_SECTOR_SIZE) / VAULT_PAGE_SIZE)))) {
+        return stage.buf + offset % VAULT_SECTOR_SIZE;
+    }
+    return flash_hal_base() + offset;
+}
+
+static void read_header(uint32_t offset, record_header *hdr) {
+    memcpy(hdr, vault_ptr(offset), sizeof(*hdr));
+}
+
+static uint32_t record_crc(const record_header *hdr, const uint8_t *value) {
+    uint32_t crc = crc32_update(0, hdr, offsetof(record_header, crc));
+    return crc32_update(crc, value, hdr->len);
+}
+
+// Programs 'a' followed by 'b' at 'offset', one page at a time. The rest of
+// each page is left at 0xFF, so earlier records sharing it are untouched.
+static void program_bytes(uint32_t offset, const void *a, size_t a_len,
+                          const void *b, size_t b_len) {
+    const uint8_t *pa = (const uint8_t *)a;
+    const uint8_t *pb = (const uint8_t *)b;
+    size_t total = a_len + b_len;
+    size_t pos = 0;
+
+    while (pos < total) {
+        uint32_t page = (uint32_t)(offset + pos) & ~(uint32_t)(VAULT_PAGE_SIZE - 1);
+        size_t in_page = offset + pos - page;
+        size_t n = VAULT_PAGE_SIZE - in_page;
+        if (n > total - pos) n = total - pos;
+
+        uint8_t *dst = page_buf;
+        if (stage.enabled) {
+            dst = stage_page(page);
+        } else {
+            memset(page_buf, 0xFF, sizeof(page_buf));
+        }
+        for (size_t i = 0; i < n; i++) {
+            size_t s = pos + i;
+            dst[in_page + i] = (s < a_len) ? pa[s] : pb[s - a_len];
+        }
+        if (!stage.enabled) {
+            flash_hal_program_page(page, page_buf);
+        }
+        pos += n;
+    }
+}
+
+static void format_sector(int s, uint32_t erase_count) {
+    sector_header hdr = {
+        .magic = VAULT_SECTOR_MAGIC,
+        .erase_count = erase_count,
+        .seq = VAULT_SEQ_NONE,
+        .reserved = 0xFFFFFFFFu,
+    };
+    program_bytes((uint32_t)s * VAULT_SECTOR_SIZE, &hdr, sizeof(hdr), NULL, 0);
+    sectors[s].erase_count = erase_count;
+    sectors[s].seq = VAULT_SEQ_NONE;
+    sectors[s].used = SECTOR_HEADER_SIZE;
+    sectors[s].live = 0;
+    sectors[s].state = SECTOR_FREE;
+    free_count++;
+}
+
+static void erase_sector(int s) {
+    // Records copied out of this sector may only be staged so far.
+    stage_flush();
+    flash_hal_erase_sector((uint32_t)s * VAULT_SECTOR_SIZE);
+    format_sector(s, sectors[s].erase_count + 1);
+}
+
+static bool sector_blank(int s) {
+    const uint8_t *p = flash_hal_base() + (uint32_t)s * VAULT_SECTOR_SIZE;
+    for (uint32_t i = 0; i < VAULT_SECTOR_SIZE; i++) {
+        if (p[i] != 0xFF) return false;
+    }
+    return true;
+}
+
+//--------------------------------------------------------------------+
+// Index
+//--------------------------------------------------------------------+
+
+// Makes the record at 'offset' the current one for its key.
+static void index_update(const record_header *hdr, uint32_t offset) {
+    uint16_t key = hdr->key;
+    if (keys[key]) {
+        record_header old;
+        read_header(keys[key], &old);
+        sectors[keys[key] / VAULT_SECTOR_SIZE].live -= record_size(old.len);
+    }
+    keys[key] = offset;
+    sectors[offset / VAULT_SECTOR_SIZE].live += record_size(hdr->len);
+}
+
+//--------------------------------------------------------------------+
+// Sector allocation and garbage collection
+//--------------------------------------------------------------------+
+
+// Opens the free sector with the lowest erase count for appending.
+static void open_sector(void) {
+    int best = -1;
+    for (int s = 0; s < VAULT_SECTOR_COUNT; s++) {
+        if (sectors[s].state == SECTOR_FREE &&
+            (best < 0 || sectors[s].erase_count < sectors[best].erase_count)) {
+            best = s;
+        }
+    }
+
+    uint32_t seq = next_sector_seq++;
+    program_bytes((uint32_t)best * VAULT_SECTOR_SIZE + offsetof(sector_header, seq),
+                  &seq, sizeof(seq), NULL, 0);
+    sectors[best].seq = seq;
+    sectors[best].state = SECTOR_ACTIVE;
+    free_count--;
+    active = best;
+}
+
+static void close_active(void) {
+    if (active >= 0) {
+        sectors[active].state = SECTOR_CLOSED;
+        active = -1;
+    }
+}
+
+static bool active_fits(uint32_t size) {
+    return active >= 0 && sectors[active].used + size <= VAULT_SECTOR_SIZE;
+}
+
+// Compacts the closed sector with the least live data. Returns false if no
+// sector holds anything to reclaim, i.e. the vault is full.
+static bool collect_garbage(void) {
+    int victim = -1;
+    for (int s = 0; s < VAULT_SECTOR_COUNT; s++) {
+        if (sectors[s].state == SECTOR_CLOSED &&
+            (victim < 0 || sectors[s].live < sectors[victim].live)) {
+            victim = s;
+        }
+    }
+    if (victim < 0 || sectors[victim].live + SECTOR_HEADER_SIZE >= VAULT_SECTOR_SIZE) {
+        return false;
+    }
+    return collect_sector(victim);
+}
+
+// Static wear leveling: data that never changes pins its sector at a low
+// erase count. Once the spread is too large, move the coldest closed sector's
+// data so the sector rejoins the free pool.
+static void level_wear(void) {
+    uint32_t max_erase = 0;
+    int cold = -1;
+    for (int s = 0; s < VAULT_SECTOR_COUNT; s++) {
+        if (sectors[s].erase_count > max_erase) {
+            max_erase = sectors[s].erase_count;
+        }
+        if (sectors[s].state == SECTOR_CLOSED &&
+            (cold < 0 || sectors[s].erase_count < sectors[cold].erase_count)) {
+            cold = s;
+        }
+    }
+    if (cold >= 0 && sectors[cold].erase_count + VAULT_WEAR_SPREAD < max_erase) {
+        collect_sector(cold);
+    }
+}
+
+// Makes sure the active sector can take 'size' more bytes. Normal writes
+// leave VAULT_GC_RESERVE sectors free; garbage collection may use them.
+static bool reserve_space(uint32_t size, bool gc) {
+    if (active_fits(size)) return true;
+
+    if (!gc) {
+        while (free_count <= VAULT_GC_RESERVE) {
+            if (!collect_garbage()) return false;
+        }
+        // Collection may have left the active sector with room.
+        if (active_fits(size)) return true;
+        level_wear();
+        if (active_fits(size)) return true;
+    }
+
+    if (free_count == 0) return false;
+    close_active();
+    open_sector();
+    return true;
+}
+
+static bool append_record(const record_header *hdr, const uint8_t *value, bool gc) {
+    uint32_t size = record_size(hdr->len);
+    if (!reserve_space(size, gc)) return false;
+
+    uint32_t offset = (uint32_t)active * VAULT_SECTOR_SIZE + sectors[active].used;
+    program_bytes(offset, hdr, sizeof(*hdr), value, hdr->len);
+    sectors[active].used += size;
+    index_update(hdr, offset);
+    return true;
+}
+
+// Copies the current records out of 'victim' and erases it.
+static bool collect_sector(int victim) {
+    uint32_t base = (uint32_t)victim * VAULT_SECTOR_SIZE;
+    uint32_t off = SECTOR_HEADER_SIZE;
+
+    // Only records the index points at are copied, and those were all
+    // validated, so the walk can stop at anything unexpected.
+    while (sectors[victim].live > 0 && off + RECORD_HEADER_SIZE <= VAULT_SECTOR_SIZE) {
+        record_header hdr;
+        read_header(base + off, &hdr);
+        if (hdr.magic != VAULT_RECORD_MAGIC || off + record_size(hdr.len) > VAULT_SECTOR_SIZE) {
+            break;
+        }
+        if (hdr.key < VAULT_MAX_KEYS && keys[hdr.key] == base + off) {
+            if (!append_record(&hdr, vault_ptr(base + off + RECORD_HEADER_SIZE), true)) {
+                return false;
+            }
+        }
+        off += record_size(hdr.len);
+    }
+
+    erase_sector(victim);
+    gc_runs++;
+    return true;
+}
+
+static int write_record(uint16_t key, uint8_t type, const void *value, size_t len) {
+    record_header hdr = {
+        .magic = VAULT_RECORD_MAGIC,
+        .type = type,
+        .flags = 0xFF,
+        .key = key,
+        .len = (uint16_t)len,
+        .seq = next_seq++,
+        .crc = 0,
+    };
+    hdr.crc = record_crc(&hdr, (const uint8_t *)value);
+    return append_record(&hdr, (const uint8_t *)value, false) ? 0 : -1;
+}
+
+//--------------------------------------------------------------------+
+// Mount
+//--------------------------------------------------------------------+
+
+// Indexes the records in sector 's'. A record that fails its checks was torn
+// by a power loss, so the sector is closed there and never appended to again.
+static void scan_sector(int s) {
+    const uint8_t *flash = flash_hal_base();
+    uint32_t base = (uint32_t)s * VAULT_SECTOR_SIZE;
+    uint32_t off = SECTOR_HEADER_SIZE;
+
+    while (off + RECORD_HEADER_SIZE <= VAULT_SECTOR_SIZE) {
+        record_header hdr;
+        memcpy(&hdr, flash + base + off, sizeof(hdr));
+
+        static const uint8_t erased[sizeof(record_header)] = {
+            0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+            0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        };
+        if (memcmp(&hdr, erased, sizeof(hdr)) == 0) break;
+
+        uint32_t size = record_size(hdr.len);
+        if (hdr.magic != VAULT_RECORD_MAGIC || hdr.key >= VAULT_MAX_KEYS ||
+            (hdr.type != VAULT_REC_PUT && hdr.type != VAULT_REC_DELETE) ||
+            hdr.len > VAULT_MAX_VALUE || off + size > VAULT_SECTOR_SIZE ||
+            hdr.crc != record_crc(&hdr, flash + base + off + RECORD_HEADER_SIZE)) {
+            off = VAULT_SECTOR_SIZE;
+            break;
+        }
+
+        record_header newest;
+        if (keys[hdr.key]) {
+            read_header(keys[hdr.key], &newest);
+        }
+        if (!keys[hdr.key] || hdr.seq > newest.seq) {
+            index_update(&hdr, base + off);
+        }
+        if (hdr.seq >= next_seq) {
+            next_seq = hdr.seq + 1;
+        }
+        off += size;
+    }
+    sectors[s].used = (uint16_t)off;
+}
+
+// The old layout kept one NUL-terminated string per sector, at sector
+// 2*(user-1)+usePass; it becomes the value of that key. It only ever programmed the first byte, so the string
+// also ends at the first erased byte.
+static void import_legacy(int s) {
+    const uint8_t *p = flash_hal_base() + (uint32_t)s * VAULT_SECTOR_SIZE;
+    size_t len = 0;
+    while (len < VAULT_MAX_VALUE && p[len] != 0x00 && p[len] != 0xFF) {
+        len++;
+    }
+
+    // A newer value means the import already happened before a power loss.
+    if (s < IMPORT_KEY && len > 0 && !keys[s]) {
+        if (write_record((uint16_t)s, VAULT_REC_PUT, p, len) == 0) {
+            migrated++;
+        }
+    }
+}
+
+int vault_mount(void) {
+    const uint8_t *flash = flash_hal_base();
+    uint32_t max_erase = 0;
+    int newest = -1;
+    bool written = false;
+
+    // Like a reboot: anything still staged is lost.
+    stage.enabled = false;
+    stage.sector = -1;
+    stage.dirty = 0;
+    memset(sectors, 0, sizeof(sectors));
+    memset(keys, 0, sizeof(keys));
+    active = -1;
+    free_count = 0;
+    next_seq = 0;
+    next_sector_seq = 0;
+    gc_runs = 0;
+    migrated = 0;
+
+    for (int s = 0; s < VAULT_SECTOR_COUNT; s++) {
+        sector_header hdr;
+        memcpy(&hdr, flash + (uint32_t)s * VAULT_SECTOR_SIZE, sizeof(hdr));
+
+        if (hdr.magic == VAULT_SECTOR_MAGIC) {
+            sectors[s].erase_count = hdr.erase_count;
+            sectors[s].seq = hdr.seq;
+            if (hdr.erase_count > max_erase) {
+                max_erase = hdr.erase_count;
+            }
+            if (hdr.seq == VAULT_SEQ_NONE) {
+                sectors[s].state = SECTOR_FREE;
+                sectors[s].used = SECTOR_HEADER_SIZE;
+                free_count++;
+            } else {
+                sectors[s].state = SECTOR_CLOSED;
+                written = true;
+                scan_sector(s);
+                if (hdr.seq >= next_sector_seq) {
+                    next_sector_seq = hdr.seq + 1;
+                }
+                if (newest < 0 || hdr.seq > sectors[newest].seq) {
+                    newest = s;
+                }
+            }
+        } else if (hdr.magic == 0xFFFFFFFFu && hdr.erase_count == 0xFFFFFFFFu) {
+            sectors[s].state = SECTOR_BLANK;
+        } else {
+            sectors[s].state = SECTOR_LEGACY;
+        }
+    }
+
+    // Appends resume in the newest sector; its torn tail, if any, has already
+    // pushed 'used' to the end.
+    if (newest >= 0) {
+        sectors[newest].state = SECTOR_ACTIVE;
+        active = newest;
+    }
+
+    // Sectors of the old layout only exist before the vault has stored
+    // anything, or while their import is unfinished. Anything else that is
+    // neither formatted nor erased is a sector whose erase was cut short
+    // (during garbage collection, say): its bytes are garbage, not values.
+    record_header marker;
+    bool importing = false;
+    if (keys[IMPORT_KEY]) {
+        read_header(keys[IMPORT_KEY], &marker);
+        importing = (marker.type == VAULT_REC_PUT);
+    }
+    bool import = !written || importing;
+    bool legacy = false;
+    for (int s = 0; s < VAULT_SECTOR_COUNT; s++) {
+        if (sectors[s].state != SECTOR_LEGACY) continue;
+        if (import) {
+            legacy = true;
+        } else {
+            sectors[s].state = SECTOR_BLANK;
+        }
+    }
+
+    // An erase whose header never got written loses its count; assume the
+    // worst seen so wear leveling doesn't favour the sector.
+    for (int s = 0; s < VAULT_SECTOR_COUNT; s++) {
+        if (sectors[s].state != SECTOR_BLANK) continue;
+        sectors[s].erase_count = max_erase;
+        if (sector_blank(s)) {
+            format_sector(s, max_erase);
+        } else {
+            erase_sector(s);
+        }
+    }
+
+    // Import old-layout values into formatted sectors, then reclaim theirs.
+    // The marker is the first record the vault ever writes.
+    if (legacy) {
+        static const uint8_t pending = 1;
+        if (!importing) write_record(IMPORT_KEY, VAULT_REC_PUT, &pending, sizeof(pending));
+        for (int s = 0; s < VAULT_SECTOR_COUNT; s++) {
+            if (sectors[s].state != SECTOR_LEGACY) continue;
+            import_legacy(s);
+            sectors[s].erase_count = max_erase;
+            erase_sector(s);
+        }
+    }
+    if (legacy || importing) {
+        write_record(IMPORT_KEY, VAULT_REC_DELETE, NULL, 0);
+    }
+
+    return (free_count > 0 || active >= 0) ? 0 : -1;
+}
+
+//--------------------------------------------------------------------+
+// API
+//--------------------------------------------------------------------+
+
+int vault_put(uint16_t key, const void *data, size_t len) {
+    if (key >= VAULT_MAX_KEYS || len > VAULT_MAX_VALUE || (len > 0 && data == NULL)) {
+        return -1;
+    }
+    return write_record(key, VAULT_REC_PUT, data, len);
+}
+
+int vault_delete(uint16_t key) {
+    if (key >= VAULT_MAX_KEYS) return -1;
+    if (!keys[key]) return 0;
+    record_header hdr;
+    read_header(keys[key], &hdr);
+    if (hdr.type == VAULT_REC_DELETE) return 0;
+    // The tombstone stays live so older copies in other sectors stay dead.
+    return write_record(key, VAULT_REC_DELETE, NULL, 0);
+}
+
+const uint8_t *vault_get(uint16_t key, size_t *len) {
+    if (key >= VAULT_MAX_KEYS || !keys[key]) return NULL;
+    record_header hdr;
+    read_header(keys[key], &hdr);
+    if (hdr.type != VAULT_REC_PUT) return NULL;
+    *len = hdr.len;
+    return vault_ptr(keys[key] + RECORD_HEADER_SIZE);
+}
+
+void vault_get_stats(vault_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->sectors = VAULT_SECTOR_COUNT;
+    stats->free_sectors = free_count;
+    stats->erase_min = 0xFFFFFFFFu;
+    stats->gc_runs = gc_runs;
+    stats->migrated = migrated;
+
+    for (int s = 0; s < VAULT_SECTOR_COUNT; s++) {
+        if (sectors[s].state != SECTOR_FREE) {
+            stats->used_bytes += sectors[s].used - SECTOR_HEADER_SIZE;
+        }
+        if (sectors[s].erase_count < stats->erase_min) stats->erase_min = sectors[s].erase_count;
+        if (sectors[s].erase_count > stats->erase_max) stats->erase_max = sectors[s].erase_count;
+    }
+    for (int k = 0; k < VAULT_MAX_KEYS; k++) {
+        record_header hdr;
+        if (!keys[k]) continue;
+        read_header(keys[k], &hdr);
+        if (hdr.type == VAULT_REC_PUT) {
+            stats->keys++;
+            stats->live_bytes += record_size(hdr.len);
+        }
+    }
+}
+
+uint32_t vault_sector_erase_count(uint32_t sector) {
+    return sector < VAULT_SECTOR_COUNT ? sectors[sector].erase_count : 0;
+}
+
+int vault_compact(void) {
+    bool dirty[VAULT_SECTOR_COUNT];
+    int erased = 0;
+
+    // Sectors opened while compacting only receive current records, so only
+    // the ones holding superseded data now are collected.
+    stage_flush();
+    close_active();
+    for (int s = 0; s < VAULT_SECTOR_COUNT; s++) {
+        dirty[s] = sectors[s].state == SECTOR_CLOSED &&
+                   sectors[s].live + SECTOR_HEADER_SIZE < sectors[s].used;
+    }
+    for (int s = 0; s < VAULT_SECTOR_COUNT; s++) {
+        if (!dirty[s]) continue;
+        if (!collect_sector(s)) return -1;
+        erased++;
+    }
+    return erased;
+}
+
+void vault_batch_begin(void) {
+    stage.enabled = true;
+}
+
+void vault_flush(void) {
+    stage_flush();
+}
+
+void vault_batch_end(void) {
+    stage_flush();
+    stage.enabled = false;
+}
@@ -0,0 +1,88 @@
+#ifndef VAULT_H
+#define VAULT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "flash_hal.h"
+
+// Log-structured record store for the stored passwords and secrets.
+//
+// Every update appends a record (header + value) to the active sector with
+// page programs; nothing is erased in place. The newest record for a key wins,
+// so the old copy simply becomes garbage. When free sectors run low, the
+// closed sector with the least live data is compacted: its live records are
+// copied forward and the sector is erased. New sectors are taken from the
+// free pool by lowest erase count, and a sector holding cold data is recycled
+// once the erase spread grows too large, so wear is spread over the region.
+//
+// Only one core may use the vault (the worker on core 1).
+
+// Number of keys. The in-RAM index costs 4 bytes per key.
+#define VAULT_MAX_KEYS 4096
+
+// Keys below this hold strings imported from the old one-sector-per-slot
+// layout: key n is the old slot 2*(user-1)+usePass. The old layout used
+// slots 0-125; the vault itself marks an unfinished import with key 126.
+#define VAULT_LEGACY_KEYS 128
+
+// Largest value a single record can hold.
+#define VAULT_MAX_VALUE (VAULT_SECTOR_SIZE - 32)
+
+// Free sectors kept back so garbage collection can always make progress.
+#define VAULT_GC_RESERVE 2
+
+// Erase-count spread after which cold sectors are recycled.
+#define VAULT_WEAR_SPREAD 32
+
+typedef struct {
+    uint32_t sectors;        // sectors in the region
+    uint32_t free_sectors;   // erased and ready to be opened
+    uint32_t keys;           // keys with a value
+    uint32_t live_bytes;     // bytes of the newest record of each key
+    uint32_t used_bytes;     // bytes appended to sectors not yet collected
+    uint32_t erase_min;      // lowest per-sector erase count
+    uint32_t erase_max;      // highest per-sector erase count
+    uint32_t gc_runs;        // sectors compacted since mount
+    uint32_t migrated;       // values imported from the old layout at mount
+} vault_stats;
+
+// Scans the region and rebuilds the in-RAM index. Blank sectors are
+// formatted, and values left by the old one-sector-per-slot layout are
+// imported. Must be called before anything else. Returns 0 on success, or -1
+// if the region is unusable.
+int vault_mount(void);
+
+// Stores 'len' bytes under 'key', replacing any previous value.
+// Returns 0 on success, or -1 on a bad argument or a full vault.
+int vault_put(uint16_t key, const void *data, size_t len);
+
+// Removes the value stored under 'key'. Returns 0 on success (including when
+// there was nothing to remove), or -1 on a bad argument or a full vault.
+int vault_delete(uint16_t key);
+
+// Returns a pointer to the value stored under 'key' in memory-mapped flash
+// (or in the batch staging buffer) and sets '*len', or returns NULL if there
+// is none. The pointer is valid until the next vault write or flush.
+const uint8_t *vault_get(uint16_t key, size_t *len);
+
+void vault_get_stats(vault_stats *stats);
+
+// Batched writes for bulk updates. Between vault_batch_begin() and
+// vault_batch_end(), appended records are staged in RAM a sector at a time
+// and every page is programmed once, when the batch moves on to another
+// sector, before any erase, or on vault_flush(). Staged records read back
+// normally but are lost on power failure until flushed.
+void vault_batch_begin(void);
+void vault_flush(void);
+void vault_batch_end(void);
+
+// Collects every sector that still holds superseded or deleted records, so
+// that no old copy of any value is left in flash. Costs up to one erase per
+// sector in use. Returns the number of sectors erased, or -1 on error.
+int vault_compact(void);
+
+// Number of times sector 'sector' of the region has been erased.
+uint32_t vault_sector_erase_count(uint32_t sector);
+
+#endif // VAULT_H
@@ -0,0 +1,126 @@
+#include "vault_crypt.h"
+
+#include <string.h>
+
+#include "entropy.h"
+#include "sha1.h"
+
+#define PARAMS_SIZE (1 + 4 + VAULT_CRYPT_SALT_SIZE + VAULT_CRYPT_CHECK_SIZE)
+#define PARAMS_ITERATIONS 1
+#define PARAMS_SALT (PARAMS_ITERATIONS + 4)
+#define PARAMS_CHECK (PARAMS_SALT + VAULT_CRYPT_SALT_SIZE)
+
+static uint8_t key[CHACHA20_KEY_SIZE];
+static bool unlocked = false;
+static uint32_t new_iterations = VAULT_CRYPT_DEFAULT_ITERATIONS;
+
+static uint32_t get_le32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put_le32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static const uint8_t *get_params(void) {
+    size_t len;
+    const uint8_t *params = vault_get(VAULT_CRYPT_PARAMS_KEY, &len);
+    return params != NULL && len == PARAMS_SIZE && params[0] == VAULT_CRYPT_VERSION ? params : NULL;
+}
+
+static void derive_key(const uint8_t *pin, size_t pin_len, const uint8_t *salt,
+                       uint32_t iterations, uint8_t out[CHACHA20_KEY_SIZE]) {
+    pbkdf2_hmac_sha1(pin, pin_len, salt, VAULT_CRYPT_SALT_SIZE, iterations, out,
+                     CHACHA20_KEY_SIZE);
+}
+
+static void check_value(const uint8_t k[CHACHA20_KEY_SIZE], uint8_t out[VAULT_CRYPT_CHECK_SIZE]) {
+    static const char label[] = "vault key check";
+    uint8_t digest[SHA1_DIGEST_SIZE];
+    hmac_sha1(k, CHACHA20_KEY_SIZE, (const uint8_t *)label, sizeof(label) - 1, digest);
+    memcpy(out, digest, VAULT_CRYPT_CHECK_SIZE);
+}
+
+// Compares without an early exit, so timing says nothing about the PIN.
+static bool equal_ct(const uint8_t *a, const uint8_t *b, size_t len) {
+    uint8_t diff = 0;
+    for (size_t i = 0; i < len; i++) {
+        diff |= a[i] ^ b[i];
+    }
+    return diff == 0;
+}
+
+bool vault_crypt_configured(void) {
+    size_t len;
+    return vault_get(VAULT_CRYPT_PARAMS_KEY, &len) != NULL;
+}
+
+uint32_t vault_crypt_calibrate(pbkdf2_clock_fn now_us) {
+    uint32_t rate = pbkdf2_rate(now_us, VAULT_CRYPT_TARGET_MS / 4);
+    new_iterations = pbkdf2_iterations_for(rate, VAULT_CRYPT_TARGET_MS, CHACHA20_KEY_SIZE);
+    return rate;
+}
+
+uint32_t vault_crypt_iterations(void) {
+    const uint8_t *params = get_params();
+    return params ? get_le32(params + PARAMS_ITERATIONS) : new_iterations;
+}
+
+int vault_crypt_unlock(const uint8_t *pin, size_t pin_len) {
+    uint8_t candidate[CHACHA20_KEY_SIZE];
+    uint8_t check[VAULT_CRYPT_CHECK_SIZE];
+    const uint8_t *params = get_params();
+    int ret = 0;
+
+    if (params != NULL) {
+        derive_key(pin, pin_len, params + PARAMS_SALT, get_le32(params + PARAMS_ITERATIONS),
+                   candidate);
+        check_value(candidate, check);
+        if (!equal_ct(check, params + PARAMS_CHECK, VAULT_CRYPT_CHECK_SIZE)) {
+            ret = -1;
+        }
+    } else if (vault_crypt_configured()) {
+        // Parameters this firmware can't read: never replace them, or the
+        // accounts encrypted under them would be lost.
+        return -1;
+    } else {
+        uint8_t fresh[PARAMS_SIZE];
+        fresh[0] = VAULT_CRYPT_VERSION;
+        put_le32(fresh + PARAMS_ITERATIONS, new_iterations);
+        entropy_fill(fresh + PARAMS_SALT, VAULT_CRYPT_SALT_SIZE);
+        derive_key(pin, pin_len, fresh + PARAMS_SALT, new_iterations, candidate);
+        check_value(candidate, fresh + PARAMS_CHECK);
+        ret = vault_put(VAULT_CRYPT_PARAMS_KEY, fresh, sizeof(fresh));
+    }
+
+    if (ret == 0) {
+        memcpy(key, candidate, sizeof(key));
+        unlocked = true;
+    }
+    memset(candidate, 0, sizeof(candidate));
+    return ret;
+}
+
+void vault_crypt_lock(void) {
+    memset(key, 0, sizeof(key));
+    unlocked = false;
+}
+
+bool vault_crypt_unlocked(void) {
+    return unlocked;
+}
+
+void vault_crypt_new_nonce(uint8_t nonce[CHACHA20_NONCE_SIZE]) {
+    entropy_fill(nonce, CHACHA20_NONCE_SIZE);
+}
+
+void vault_crypt_xor(const uint8_t nonce[CHACHA20_NONCE_SIZE], uint32_t offset,
+                     const uint8_t *in, uint8_t *out, size_t len) {
+    chacha20_ctx ctx;
+    chacha20_init(&ctx, key, nonce);
+    chacha20_xor(&ctx, offset, in, out, len);
+    memset(&ctx, 0, sizeof(ctx));
+}
@@ -0,0 +1,68 @@
+#ifndef VAULT_CRYPT_H
+#define VAULT_CRYPT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chacha20.h"
+#include "pbkdf2.h"
+#include "vault.h"
+
+// Encryption at rest. Account secrets are encrypted with ChaCha20 under a
+// key derived from the unlock PIN and a random per-device salt with
+// PBKDF2-HMAC-SHA1; the key only exists in RAM while the vault is unlocked.
+// The PIN is entered on the buttons at every boot and never stored, so a
+// dump of the flash alone does not give the key: what it holds (below) only
+// lets an attacker test PIN guesses offline, each costing the full PBKDF2
+// iteration count. The PIN length is what bounds that search.
+//
+// The iteration count, the salt and a value that tells whether a PIN is
+// right are kept under VAULT_CRYPT_PARAMS_KEY, one of the keys below
+// ACCOUNT_KEY_BASE that the old layout never used:
+//
+//   version(1) iterations(4, LE) salt(16) check(16)
+
+#define VAULT_CRYPT_PARAMS_KEY (VAULT_LEGACY_KEYS - 1)
+#define VAULT_CRYPT_VERSION 2
+#define VAULT_CRYPT_SALT_SIZE 16
+#define VAULT_CRYPT_CHECK_SIZE 16
+
+// Unlock latency vault_crypt_calibrate() aims for.
+#define VAULT_CRYPT_TARGET_MS 300
+
+// Iteration count for new vaults when vault_crypt_calibrate() was not run.
+#define VAULT_CRYPT_DEFAULT_ITERATIONS 10000
+
+// True once the vault has key parameters, i.e. a PIN.
+bool vault_crypt_configured(void);
+
+// Times PBKDF2 on this CPU and sets the iteration count for the parameters
+// the next first unlock creates, so it takes about VAULT_CRYPT_TARGET_MS.
+// Takes about a quarter of that. Returns the measured iterations per second.
+uint32_t vault_crypt_calibrate(pbkdf2_clock_fn now_us);
+
+// Iteration count of the stored parameters, or the one new parameters will
+// get if there are none yet.
+uint32_t vault_crypt_iterations(void);
+
+// Derives the key for 'pin' and unlocks the vault. The first unlock of a
+// vault without parameters creates them, making 'pin' its PIN.
+// Returns 0 on success, or -1 if the PIN is wrong, the parameters are of an
+// unknown version, or they could not be stored.
+int vault_crypt_unlock(const uint8_t *pin, size_t pin_len);
+
+// Wipes the key.
+void vault_crypt_lock(void);
+
+bool vault_crypt_unlocked(void);
+
+// Fills 'nonce' with a fresh random record nonce.
+void vault_crypt_new_nonce(uint8_t nonce[CHACHA20_NONCE_SIZE]);
+
+// XORs 'len' bytes with the keystream for 'nonce' from byte 'offset' on.
+// Must only be called while unlocked.
+void vault_crypt_xor(const uint8_t nonce[CHACHA20_NONCE_SIZE], uint32_t offset,
+                     const uint8_t *in, uint8_t *out, size_t len);
+
+#endif // VAULT_CRYPT_H
@@ -0,0 +1,611 @@
+#include "worker.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "hardware/sync.h"
+#include "hardware/uart.h"
+
+#include "account.h"
+#include "account_index.h"
+#include "counter_log.h"
+#include "crc32.h"
+#include "flash_hal.h"
+#include "provision.h"
+#include "spsc_queue.h"
+#include "totp.h"
+#include "totp_worker.h"
+#include "uart_rx.h"
+#include "vault.h"
+#include "vault_crypt.h"
+
+#define UART_ID uart0
+
+#define WORKER_QUEUE_LEN 8
+#define CDC_RX_QUEUE_LEN 16
+// Enough for the largest reply frame plus a window of ACKs.
+#define CDC_TX_QUEUE_LEN 32
+
+// A provisioning session with no terminating ';' is abandoned after this.
+#define PROGRAMMER_TIMEOUT_MS 60000
+// How often an open session drains the DMA ring. The 2 KB ring takes about
+// 22 ms to fill at 921600 baud; a full ring only pauses the sender anyway.
+#define PROGRAMMER_POLL_MS 10
+// A host that keeps the port open but stops reading gets its replies
+// dropped after this, rather than stalling core 1.
+#define CDC_TX_TIMEOUT_MS 500
+
+static worker_cmd cmd_storage[WORKER_QUEUE_LEN];
+static worker_evt evt_storage[WORKER_QUEUE_LEN];
+static spsc_queue_t cmd_queue;   // core 0 -> core 1
+static spsc_queue_t evt_queue;   // core 1 -> core 0
+
+static worker_cdc_chunk cdc_rx_storage[CDC_RX_QUEUE_LEN];
+static worker_cdc_chunk cdc_tx_storage[CDC_TX_QUEUE_LEN];
+static spsc_queue_t cdc_rx_queue;   // core 0 -> core 1
+static spsc_queue_t cdc_tx_queue;   // core 1 -> core 0
+
+// Only touched by core 1.
+static char myData1[4096];
+
+// --- TOTP Variables ---
+// Maximum secret length for TOTP configuration
+#define SECRET_MAX 32
+// Global Base32 secret for TOTP generation (default value)
+char base32_secret[SECRET_MAX] = "JBSWY3DPEHPK3PXP";
+volatile bool new_secret_programmed = false;
+
+//--------------------------------------------------------------------+
+// TOTP
+//--------------------------------------------------------------------+
+
+// Decodes base32_secret and hands its HMAC midstates to the TOTP worker,
+// which keeps the codes precomputed.
+static void totp_refresh_key(void) {
+  totp_key key;
+  new_secret_programmed = false;
+  bool valid = (totp_key_init(&key, base32_secret, TOTP_SHA1) == 0);
+  totp_worker_set_secret(0, valid ? &key : NULL, 30, 6);
+  memset(&key, 0, sizeof(key));
+}
+
+// Prints the current TOTP code.
+static void totp_task(void) {
+  uint64_t current_time = totp_worker_now();
+
+  // Make sure the precomputed slot covers the current step.
+  totp_worker_poll();
+
+  char otp[TOTP_CODE_SIZE] = {0};
+  int time_remaining = 0;
+  if (totp_worker_get(0, current_time, otp, sizeof(otp), &time_remaining)) {
+      printf("TOTP: %s, valid for %d seconds\n", otp, time_remaining);
+  } else {
+      printf("Error generating TOTP\n");
+  }
+}
+
+//--------------------------------------------------------------------+
+// DATA STORAGE
+//--------------------------------------------------------------------+
+// Each button mask selects an account; usePass picks its password field.
+static uint16_t account_id(uint32_t userChosen) {
+  return (uint16_t)(userChosen - 1);
+}
+
+static void storeString(uint32_t userChosen, bool usePass) {
+  account acc;
+  char name[12];
+  if (account_load(account_id(userChosen), &acc) != 0) {
+    memset(&acc, 0, sizeof(acc));
+    acc.name = name;
+    acc.name_len = (size_t)snprintf(name, sizeof(name), "user%lu", (unsigned long)userChosen);
+  }
+  if (usePass) {
+    acc.password = myData1;
+    acc.password_len = strlen(myData1);
+  } else {
+    acc.username = myData1;
+    acc.username_len = strlen(myData1);
+  }
+  if (account_store(account_id(userChosen), &acc) != 0) {
+    printf("Vault full or locked, string not stored\n");
+  }
+}
+
+// Set once the vault has mounted; until then no PIN can be checked.
+static bool vault_mounted = false;
+
+static void vault_start(void) {
+  vault_stats st;
+  if (flash_hal_check_layout() != 0) {
+    printf("Firmware overlaps the vault flash region, vault not mounted\n");
+    return;
+  }
+  if (vault_mount() != 0) {
+    printf("Vault mount failed\n");
+    return;
+  }
+  vault_mounted = true;
+  int converted = account_migrate_legacy();
+  account_index_build();
+  if (counter_log_mount() != 0) {
+    printf("HOTP counter log mount failed\n");
+  }
+  vault_get_stats(&st);
+  printf("Vault: %u accounts indexed, %d converted, %lu keys, %lu/%lu sectors free, erase count %lu-%lu, %lu migrated\n",
+         (unsigned)account_index_count(), converted, (unsigned long)st.keys, (unsigned long)st.free_sectors, (unsigned long)st.sectors,
+         (unsigned long)st.erase_min, (unsigned long)st.erase_max, (unsigned long)st.migrated);
+}
+
+static uint64_t clock_us(void) {
+  return time_us_64();
+}
+
+static void totp_register_accounts(void);
+
+// Returns false if the PIN is wrong (or the vault can't take a first one).
+static bool vault_unlock(const uint8_t *pin, size_t pin_len) {
+  // First boot: size the key derivation for this board before the PIN is set.
+  if (!vault_crypt_configured()) {
+    uint32_t rate = vault_crypt_calibrate(clock_us);
+    printf("Vault: PBKDF2 %lu iterations/s, using %lu\n", (unsigned long)rate,
+           (unsigned long)vault_crypt_iterations());
+  }
+  if (vault_crypt_unlock(pin, pin_len) != 0) {
+    printf("Vault: wrong PIN\n");
+    return false;
+  }
+  int encrypted = account_encrypt_all();
+  if (encrypted != 0) {
+    printf("Vault: %d accounts encrypted\n", encrypted);
+  }
+  // Accounts stored before TOTP seeds existed hold Base32 text.
+  int seeds = account_migrate_seeds();
+  if (seeds != 0) {
+    printf("Vault: %d TOTP secrets decoded\n", seeds);
+  }
+  totp_register_accounts();
+  return true;
+}
+
+//--------------------------------------------------------------------+
+// TYPING
+//--------------------------------------------------------------------+
+// Set while core 0 may be typing a TEXT that points into flash or into
+// reveal.text; the vault must not change until it posts RELEASE.
+static bool text_lent = false;
+
+// An encrypted field is decrypted into 'text' one keystream block at a time
+// while core 0 types what is ready, so the first key goes out after one
+// block instead of after the whole field.
+static struct {
+  account acc;
+  const char *field;
+  size_t len;
+  volatile size_t ready;
+  char text[VAULT_MAX_VALUE];
+} reveal;
+
+// Decrypts up to the next keystream block boundary. Returns true while
+// there is more to do.
+static bool reveal_step(void) {
+  size_t pos = reveal.ready;
+  if (pos >= reveal.len) return false;
+
+  size_t offset = (size_t)((const uint8_t *)reveal.field - reveal.acc.record) + pos;
+  size_t n = CHACHA20_BLOCK_SIZE - offset % CHACHA20_BLOCK_SIZE;
+  if (n > reveal.len - pos) n = reveal.len - pos;
+  account_read(&reveal.acc, reveal.field, pos, n, reveal.text + pos);
+  __dmb(); // the text must be visible to core 0 before the count covering it
+  reveal.ready = pos + n;
+  __sev(); // core 0 may be asleep waiting for these bytes
+  return reveal.ready < reveal.len;
+}
+
+static void reveal_wipe(void) {
+  memset(reveal.text, 0, reveal.len);
+  reveal.len = 0;
+  reveal.ready = 0;
+}
+
+// Plaintext fields are typed straight from flash. Encrypted ones are typed
+// from reveal.text as reveal_step() fills it.
+static void type_secret(const worker_cmd *cmd, worker_evt *evt) {
+  account *acc = &reveal.acc;
+  if (account_load(account_id(cmd->user), acc) != 0) return;
+  const char *field = cmd->use_pass ? acc->password : acc->username;
+  size_t len = cmd->use_pass ? acc->password_len : acc->username_len;
+  if (len == 0) return;
+
+  if (acc->nonce == NULL) {
+    evt->text = field;
+  } else {
+    if (!vault_crypt_unlocked()) return;
+    reveal.field = field;
+    reveal.len = len;
+    reveal.ready = 0;
+    reveal_step();
+    evt->text = reveal.text;
+    evt->ready = &reveal.ready;
+  }
+  evt->type = WORKER_EVT_TEXT;
+  evt->len = len;
+  text_lent = true;
+}
+
+// Kept off core 1's small stack; wiped after each use.
+static totp_key otp_key;
+
+// Prepares otp_key from the account's seed, which passes through
+// reveal.text and is wiped straight away. Returns 0 on success.
+static int otp_key_load(const account *acc) {
+  if (acc->totp_seed_len == 0 || acc->totp_seed_len > sizeof(reveal.text)) return -1;
+  if (acc->nonce != NULL && !vault_crypt_unlocked()) return -1;
+  account_read(acc, (const char *)acc->totp_seed, 0, acc->totp_seed_len, reveal.text);
+  int ok = totp_key_set(&otp_key, (const uint8_t *)reveal.text, acc->totp_seed_len,
+                        (totp_hash)acc->totp_hash);
+  memset(reveal.text, 0, acc->totp_seed_len);
+  return ok;
+}
+
+static int otp_digits(const account *acc) {
+  return acc->totp_digits ? acc->totp_digits : 6;
+}
+
+static int otp_period(const account *acc) {
+  return acc->totp_period ? acc->totp_period : 30;
+}
+
+// TOTP accounts whose codes the TOTP worker keeps precomputed, in its slots
+// from 1 on (slot 0 is base32_secret). A slot only serves the exact record
+// it was filled from, identified by its CRC, so a re-provisioned account is
+// refilled rather than typed with stale codes.
+#define TOTP_ACCOUNT_SLOTS (TOTP_WORKER_MAX_SECRETS - 1)
+
+static struct {
+  bool used;
+  uint16_t id;
+  uint32_t crc;
+} totp_slots[TOTP_ACCOUNT_SLOTS];
+static int totp_slot_victim;   // next slot to reuse once all are taken
+
+static int totp_slot_find(uint16_t id, uint32_t crc) {
+  for (int i = 0; i < TOTP_ACCOUNT_SLOTS; i++) {
+    if (totp_slots[i].used && totp_slots[i].id == id && totp_slots[i].crc == crc) return i;
+  }
+  return -1;
+}
+
+// Hands otp_key to the TOTP worker for account 'id', replacing any older
+// slot of that account, else a free one, else the oldest filled.
+static void totp_slot_fill(uint16_t id, const account *acc, uint32_t crc) {
+  int slot = -1;
+  for (int i = 0; i < TOTP_ACCOUNT_SLOTS && slot < 0; i++) {
+    if (totp_slots[i].used && totp_slots[i].id == id) slot = i;
+  }
+  for (int i = 0; i < TOTP_ACCOUNT_SLOTS && slot < 0; i++) {
+    if (!totp_slots[i].used) slot = i;
+  }
+  if (slot < 0) {
+    slot = totp_slot_victim;
+    totp_slot_victim = (totp_slot_victim + 1) % TOTP_ACCOUNT_SLOTS;
+  }
+  totp_worker_set_secret(slot + 1, &otp_key, otp_period(acc), otp_digits(acc));
+  totp_slots[slot].used = true;
+  totp_slots[slot].id = id;
+  totp_slots[slot].crc = crc;
+}
+
+// After unlock: has the TOTP worker precompute codes for every TOTP account,
+// as far as there are slots. Accounts beyond that are computed on demand and
+// take over a slot when typed.
+static void totp_register_accounts(void) {
+  int filled = 0;
+  for (uint16_t id = 0; id < ACCOUNT_MAX && filled < TOTP_ACCOUNT_SLOTS; id++) {
+    account acc;
+    if (account_load(id, &acc) != 0 || acc.hotp || otp_key_load(&acc) != 0) continue;
+    totp_slot_fill(id, &acc, crc32_update(0, acc.record, acc.record_len));
+    filled++;
+  }
+  memset(&otp_key, 0, sizeof(otp_key));
+}
+
+// Types the account's one-time code: HOTP if it is counter-based, else
+// TOTP. A TOTP code is copied from the TOTP worker's precomputed slot when
+// it has one. For HOTP the next counter is written to the counter log before
+// the code exists, so a power cut can skip a code but never repeat one.
+static void type_otp(const worker_cmd *cmd, worker_evt *evt) {
+  account *acc = &reveal.acc;
+  uint16_t id = account_id(cmd->user);
+  if (account_load(id, acc) != 0) return;
+
+  int ok = -1;
+  int remaining;
+  uint64_t now = totp_worker_now();
+  uint32_t crc = crc32_update(0, acc->record, acc->record_len);
+  int slot = acc->hotp ? -1 : totp_slot_find(id, crc);
+  if (slot >= 0 && totp_worker_get(slot + 1, now, reveal.text, TOTP_CODE_SIZE, &remaining)) {
+    ok = 0;
+  } else if (otp_key_load(acc) == 0) {
+    if (acc->hotp) {
+      uint64_t counter;
+      ok = counter_log_next(id, acc->hotp_counter, &counter);
+      if (ok == 0) ok = hotp_with_key(&otp_key, counter, otp_digits(acc), reveal.text, TOTP_CODE_SIZE);
+    } else {
+      ok = totp_with_key(&otp_key, now, otp_period(acc), otp_digits(acc), reveal.text,
+                         TOTP_CODE_SIZE, &remaining);
+      if (ok == 0) totp_slot_fill(id, acc, crc);
+    }
+    memset(&otp_key, 0, sizeof(otp_key));
+  }
+  if (ok != 0) return;
+
+  reveal.len = strlen(reveal.text);
+  reveal.ready = reveal.len;
+  evt->type = WORKER_EVT_TEXT;
+  evt->text = reveal.text;
+  evt->len = reveal.len;
+  text_lent = true;
+}
+
+//--------------------------------------------------------------------+
+// PROVISIONING
+//--------------------------------------------------------------------+
+// A PROGRAM or SET_TIME command opens a session that collects one
+// ';'-terminated string from the UART ring as bytes arrive; the command is
+// answered once the string is complete (or the session times out), and the
+// worker keeps running in the meantime.
+static struct {
+  bool active;
+  worker_cmd cmd;
+  size_t len;             // bytes collected in myData1
+  uint32_t start_ms;
+} session;
+
+static void programmer_start(const worker_cmd *cmd) {
+  // Anything received outside a session is stale.
+  uint8_t discard[64];
+  while (uart_rx_read(discard, sizeof(discard)) > 0) {
+  }
+
+  session.active = true;
+  session.cmd = *cmd;
+  session.len = 0;
+  session.start_ms = to_ms_since_boot(get_absolute_time());
+}
+
+static void programmer_finish(bool complete) {
+  worker_evt evt = { .type = WORKER_EVT_DONE, .text = NULL, .len = 0 };
+
+  if (complete) {
+    myData1[session.len] = '\0';
+    if (session.cmd.type == WORKER_CMD_SET_TIME) {
+      totp_worker_set_time(atoi(myData1), to_ms_since_boot(get_absolute_time()));
+    } else {
+      storeString(session.cmd.user, session.cmd.use_pass);
+    }
+  }
+  session.active = false;
+  spsc_queue_try_push(&evt_queue, &evt);
+  __sev();
+}
+
+// Feeds newly received bytes to the open session, without blocking.
+static void programmer_poll(void) {
+  uint8_t chunk[64];
+  size_t n;
+
+  while (session.active && (n = uart_rx_read(chunk, sizeof(chunk))) > 0) {
+    for (size_t i = 0; i < n; i++) {
+      // A full buffer ends the string, as the old 4 KB read loop did.
+      if (chunk[i] == ';' || session.len == sizeof(myData1) - 1) {
+        programmer_finish(true);
+        break;
+      }
+      myData1[session.len++] = (char)chunk[i];
+    }
+  }
+
+  if (session.active &&
+      to_ms_since_boot(get_absolute_time()) - session.start_ms > PROGRAMMER_TIMEOUT_MS) {
+    printf("Provisioning timed out\n");
+    programmer_finish(false);
+  }
+}
+
+//--------------------------------------------------------------------+
+// CDC PROVISIONING
+//--------------------------------------------------------------------+
+static provision_t provisioner;
+
+// Set once a reply timed out; later replies are dropped without waiting
+// until the host reads again.
+static bool cdc_tx_stalled;
+
+static void cdc_write(const uint8_t *data, size_t len) {
+  worker_cdc_chunk chunk;
+  uint32_t start = to_ms_since_boot(get_absolute_time());
+  while (len > 0) {
+    chunk.len = (uint8_t)(len < WORKER_CDC_CHUNK_MAX ? len : WORKER_CDC_CHUNK_MAX);
+    memcpy(chunk.data, data, chunk.len);
+    // Core 0 drains this queue every loop, even while typing, so a full
+    // queue means the host is not reading. The host sees a truncated frame
+    // and retries it.
+    while (!spsc_queue_try_push(&cdc_tx_queue, &chunk)) {
+      if (cdc_tx_stalled ||
+          to_ms_since_boot(get_absolute_time()) - start > CDC_TX_TIMEOUT_MS) {
+        cdc_tx_stalled = true;
+        return;
+      }
+      tight_loop_contents();
+    }
+    cdc_tx_stalled = false;
+    __sev();
+    data += chunk.len;
+    len -= chunk.len;
+  }
+}
+
+static void cdc_set_time(uint32_t unix_time) {
+  totp_worker_set_time(unix_time, to_ms_since_boot(get_absolute_time()));
+}
+
+static void cdc_start(void) {
+  provision_io io = { .write = cdc_write, .set_time = cdc_set_time };
+  provision_init(&provisioner, &io);
+}
+
+static void cdc_poll(void) {
+  uint32_t now = to_ms_since_boot(get_absolute_time());
+  worker_cdc_chunk chunk;
+
+  // Leaves the data queued (and the host held off) while text is lent.
+  if (text_lent) return;
+  while (spsc_queue_try_pop(&cdc_rx_queue, &chunk)) {
+    provision_input(&provisioner, chunk.data, chunk.len, now);
+    __sev(); // room for the bytes core 0 is holding back
+  }
+  provision_poll(&provisioner, now);
+}
+
+//--------------------------------------------------------------------+
+// CORE 1
+//--------------------------------------------------------------------+
+static void worker_handle(const worker_cmd *cmd) {
+  worker_evt evt = { .type = WORKER_EVT_DONE, .text = NULL, .len = 0 };
+
+  switch (cmd->type) {
+    case WORKER_CMD_TYPE_SECRET:
+      // Nothing writes the vault until core 0 posts RELEASE, and it sends
+      // no other command before then.
+      type_secret(cmd, &evt);
+      break;
+    case WORKER_CMD_TYPE_OTP:
+      type_otp(cmd, &evt);
+      break;
+    case WORKER_CMD_RELEASE:
+      reveal_wipe();
+      text_lent = false;
+      break;
+    case WORKER_CMD_UNLOCK:
+      if (!vault_mounted) {
+        evt.type = WORKER_EVT_NO_VAULT;
+      } else if (!vault_unlock(cmd->pin, cmd->pin_len)) {
+        evt.type = WORKER_EVT_REJECTED;
+      }
+      break;
+    case WORKER_CMD_PROGRAM:
+    case WORKER_CMD_SET_TIME:
+      // Answered by programmer_finish().
+      programmer_start(cmd);
+      return;
+    case WORKER_CMD_TOTP:
+      totp_task();
+      break;
+  }
+
+  // Core 0 only has one command in flight, so the queue can't be full.
+  spsc_queue_try_push(&evt_queue, &evt);
+  __sev(); // wake core 0 if it is waiting in __wfe()
+}
+
+#ifdef POWER_TRACE
+// Time core 1 has spent in __wfe(); core 0 reads it, so it is read until
+// two reads agree rather than risk a torn 64-bit value.
+static volatile uint64_t asleep_us = 0;
+
+uint64_t worker_asleep_us(void) {
+  uint64_t t;
+  do {
+    t = asleep_us;
+  } while (t != asleep_us);
+  return t;
+}
+#endif
+
+static void worker_main(void) {
+  uart_rx_start(UART_ID);
+  vault_start();
+  totp_refresh_key();
+  cdc_start();
+
+  while (1) {
+    worker_cmd cmd;
+    while (spsc_queue_try_pop(&cmd_queue, &cmd)) {
+      worker_handle(&cmd);
+    }
+
+    // One block per pass keeps commands and CDC data flowing meanwhile.
+    if (reveal_step()) continue;
+
+    if (new_secret_programmed) {
+      totp_refresh_key();
+    }
+    uint32_t wait_ms = totp_worker_poll();
+    cdc_poll();
+
+    // Sleep until the next TOTP boundary or until core 0 posts a command or
+    // CDC data. Staged provisioning writes are flushed after an idle gap,
+    // and an open session's DMA ring only has to be drained before it fills.
+    if (provisioner.dirty && wait_ms > PROVISION_IDLE_FLUSH_MS) {
+      wait_ms = PROVISION_IDLE_FLUSH_MS;
+    }
+    if (session.active) {
+      programmer_poll();
+      if (wait_ms > PROGRAMMER_POLL_MS) wait_ms = PROGRAMMER_POLL_MS;
+    }
+    if (spsc_queue_level(&cmd_queue) == 0 &&
+        (text_lent || spsc_queue_level(&cdc_rx_queue) == 0)) {
+#ifdef POWER_TRACE
+      uint64_t start = time_us_64();
+      best_effort_wfe_or_timeout(make_timeout_time_ms(wait_ms));
+      asleep_us += time_us_64() - start;
+#else
+      best_effort_wfe_or_timeout(make_timeout_time_ms(wait_ms));
+#endif
+    }
+  }
+}
+
+//--------------------------------------------------------------------+
+// CORE 0 API
+//--------------------------------------------------------------------+
+void worker_start(void) {
+  spsc_queue_init(&cmd_queue, cmd_storage, sizeof(worker_cmd), WORKER_QUEUE_LEN);
+  spsc_queue_init(&evt_queue, evt_storage, sizeof(worker_evt), WORKER_QUEUE_LEN);
+  spsc_queue_init(&cdc_rx_queue, cdc_rx_storage, sizeof(worker_cdc_chunk), CDC_RX_QUEUE_LEN);
+  spsc_queue_init(&cdc_tx_queue, cdc_tx_storage, sizeof(worker_cdc_chunk), CDC_TX_QUEUE_LEN);
+  multicore_launch_core1(worker_main);
+}
+
+bool worker_post(const worker_cmd *cmd) {
+  if (!spsc_queue_try_push(&cmd_queue, cmd)) return false;
+  __sev(); // wake core 1 if it is waiting in __wfe()
+  return true;
+}
+
+bool worker_poll_event(worker_evt *evt) {
+  return spsc_queue_try_pop(&evt_queue, evt);
+}
+
+bool worker_cdc_push(const worker_cdc_chunk *chunk) {
+  if (!spsc_queue_try_push(&cdc_rx_queue, chunk)) return false;
+  __sev();
+  return true;
+}
+
+bool worker_cdc_can_push(void) {
+  return spsc_queue_level(&cdc_rx_queue) < CDC_RX_QUEUE_LEN;
+}
+
+bool worker_cdc_peek(worker_cdc_chunk *chunk) {
+  return spsc_queue_try_peek(&cdc_tx_queue, chunk);
+}
+
+void worker_cdc_pop(void) {
+  spsc_queue_try_pop(&cdc_tx_queue, NULL);
+}
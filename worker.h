@@ -0,0 +1,87 @@
+#ifndef WORKER_H
+#define WORKER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Core 1 runs storage, provisioning and crypto so that core 0 only has to
+// service TinyUSB and HID. Core 0 posts commands and receives events through
+// two single-producer/single-consumer queues; every command is answered by
+// exactly one event.
+
+typedef enum {
+  WORKER_CMD_TYPE_SECRET,   // read the stored username/password for typing
+  WORKER_CMD_PROGRAM,       // read a ';'-terminated string from UART and store it
+  WORKER_CMD_SET_TIME,      // read the unix time from UART
+  WORKER_CMD_TOTP,          // print the current TOTP code
+  WORKER_CMD_RELEASE,       // core 0 has finished typing the last TEXT
+  WORKER_CMD_UNLOCK,        // derive the vault key from 'pin'; answered by
+                            // DONE, REJECTED if the PIN is wrong, or
+                            // NO_VAULT
+  WORKER_CMD_TYPE_OTP,      // the account's HOTP or TOTP code, for typing
+} worker_cmd_type;
+
+typedef struct {
+  uint8_t type;        // worker_cmd_type
+  uint8_t user;        // userChosen button mask
+  bool use_pass;       // password rather than username
+  uint8_t pin_len;
+  const uint8_t *pin;  // UNLOCK: must stay valid until the DONE event
+} worker_cmd;
+
+typedef enum {
+  WORKER_EVT_DONE,     // command finished, nothing to type
+  WORKER_EVT_TEXT,     // 'text' should be typed; valid until RELEASE is
+                       // posted. May point into flash, or into a buffer that
+                       // core 1 is still decrypting into: then only the first
+                       // '*ready' bytes are valid (not NUL-terminated)
+  WORKER_EVT_REJECTED, // UNLOCK: the key derived from the PIN failed the
+                       // vault's check value
+  WORKER_EVT_NO_VAULT, // UNLOCK: the vault did not mount at start-up, so
+                       // the PIN was not checked
+} worker_evt_type;
+
+typedef struct {
+  uint8_t type;        // worker_evt_type
+  const char *text;
+  size_t len;
+  const volatile size_t *ready;  // NULL if all of 'text' is valid
+} worker_evt;
+
+// Bytes of the provisioning CDC stream, passed between the cores in
+// USB-packet-sized pieces.
+#define WORKER_CDC_CHUNK_MAX 63
+
+typedef struct {
+  uint8_t len;
+  uint8_t data[WORKER_CDC_CHUNK_MAX];
+} worker_cdc_chunk;
+
+// Launches core 1. Call once from core 0 during start-up.
+void worker_start(void);
+
+// Core 0: queues a command for core 1. Returns false if the queue is full.
+bool worker_post(const worker_cmd *cmd);
+
+// Core 0: fetches the next event from core 1, if any.
+bool worker_poll_event(worker_evt *evt);
+
+// Core 0: hands bytes received on the CDC interface to core 1. Returns false
+// if the queue is full; the bytes should then stay in the TinyUSB FIFO, which
+// holds the host off.
+bool worker_cdc_push(const worker_cdc_chunk *chunk);
+
+// Core 0: whether worker_cdc_push() has room for another chunk.
+bool worker_cdc_can_push(void);
+
+#ifdef POWER_TRACE
+// Core 0: time core 1 has spent asleep since boot, in microseconds.
+uint64_t worker_asleep_us(void);
+#endif
+
+// Core 0: fetches the next piece of reply bytes to send on the CDC interface.
+bool worker_cdc_peek(worker_cdc_chunk *chunk);
+void worker_cdc_pop(void);
+
+#endif // WORKER_H